@@ -5,13 +5,31 @@
   @copyright Uniwersytet Warszawski
   @date 2021
 */
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
 #include "calc.h"
 #include "input-output.h"
 #include "data_structures.h"
 /** To jest makrodefinicja reprezentująca znak spacji. */
 #define SPACE ' '
 
+/** To jest makrodefinicja reprezentująca opcję włączającą internowanie
+ * wielomianów na stosie. */
+#define INTERN_OPTION "--intern"
+
+/** To jest makrodefinicja reprezentująca opcję włączającą wypisywanie zmian
+ * liczników pamięci po każdej linii. */
+#define TRACE_MEMORY_OPTION "--trace-memory"
+
+/** To jest makrodefinicja reprezentująca opcję ustawiającą limit pamięci
+ * w bajtach. */
+#define MAX_MEMORY_OPTION "--max-memory"
+
+/** To jest makrodefinicja reprezentująca opcję wczytującą komendy z pliku
+ * skryptu zamiast ze standardowego wejścia. */
+#define SCRIPT_OPTION "--script"
+
 /**
  * Wypisuje na standardowe wyjście błędów błąd złej komendy.
  * @param[in] lineNumber : numer linii @f$lineNumber@f$
@@ -36,6 +54,22 @@ void wrongValueAtError(size_t lineNumber) {
     fprintf(stderr, "ERROR %ld AT WRONG VALUE\n", lineNumber);
 }
 
+/**
+ * Wypisuje na standardowe wyjście błędów błąd argumentu funkcji Poly_at_many.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void wrongValueAtManyError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld AT MANY WRONG VALUE\n", lineNumber);
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów błąd argumentu funkcji Poly_eval.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void wrongEvalError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld EVAL WRONG VALUE\n", lineNumber);
+}
+
 /**
  * Wypisuje na standardowe wyjście błędów błąd stosu.
  * @param[in] lineNumber : numer linii @f$lineNumber@f$
@@ -60,6 +94,137 @@ void wrongComposeError(size_t lineNumber) {
     fprintf(stderr, "ERROR %ld COMPOSE WRONG PARAMETER\n", lineNumber);
 }
 
+/**
+ * Wypisuje na standardowe wyjście błędów błąd argumentu funkcji Poly_pow.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void wrongPowError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld POW WRONG VALUE\n", lineNumber);
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów błąd argumentu polecenia SCALE.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void wrongScaleError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld SCALE WRONG VALUE\n", lineNumber);
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów błąd argumentu polecenia SHIFT.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void wrongShiftError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld SHIFT WRONG VALUE\n", lineNumber);
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów błąd argumentu polecenia
+ * NTT_THRESHOLD.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void wrongNttThresholdError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld NTT THRESHOLD WRONG VALUE\n", lineNumber);
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów błąd argumentu polecenia THREADS.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void wrongThreadsError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld THREADS WRONG VALUE\n", lineNumber);
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów błąd przekroczenia limitu pamięci.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void outOfMemoryError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld OUT OF MEMORY\n", lineNumber);
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów błąd przekroczenia zakresu
+ * wykładników.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void expOverflowError(size_t lineNumber) {
+    fprintf(stderr, "ERROR %ld EXPONENT OVERFLOW\n", lineNumber);
+}
+
+/**
+ * Pobiera na własność argumenty operacji ze szczytu stosu, zaczynając od
+ * wierzchołka. Jeśli pamięć jest ograniczona, argumenty zostają na stosie,
+ * a pobierane są ich kopie, by po przekroczeniu limitu stos pozostał
+ * niezmieniony.
+ * @param[in] s : stos @f$s@f$ o co najmniej @p count elementach
+ * @param[in] count : liczba argumentów @f$count@f$
+ * @param[out] operands : argumenty; pierwszy pochodzi z wierzchołka stosu
+ * @return liczba argumentów pozostawionych na stosie
+ */
+size_t takeOperands(PolyStack *s, size_t count, Poly operands[]) {
+    bool limited = MemoryGetLimit() != 0;
+
+    for (size_t i = 0; i < count; i++) {
+        operands[i] = limited ? PolyClone(PolyStackPeekAt(s, i)) :
+                PolyStackPop(s);
+    }
+
+    return limited ? count : 0;
+}
+
+/**
+ * Kończy operację wykonaną w miejscu na wielomianie ze szczytu stosu.
+ * Jeśli stos internuje wielomiany, internuje zmieniony wielomian tak, jak
+ * zrobiłoby to włożenie go na stos.
+ * @param[in] s : niepusty stos @f$s@f$
+ */
+void commitTop(PolyStack *s) {
+    if ((*s).intern) {
+        Poly *top = PolyStackTop(s);
+        *top = PolyIntern(top);
+    }
+}
+
+/**
+ * Kończy operację, której argumenty zostały na stosie lub zostały pobrane
+ * funkcją takeOperands. Jeśli w trakcie operacji przekroczono limit pamięci
+ * lub zakres wykładników, usuwa wyniki i pokazuje błąd, nie zmieniając stosu.
+ * Operacje, które pobierają argumenty bez limitu pamięci, muszą sprawdzić
+ * zakres wykładników wcześniej. W przeciwnym razie
+ * zdejmuje i usuwa pozostawione na stosie argumenty, a potem wkłada wyniki.
+ * @param[in] s : stos @f$s@f$
+ * @param[in] left : liczba argumentów pozostawionych na stosie @f$left@f$
+ * @param[in] count : liczba wyników @f$count@f$
+ * @param[in] results : wyniki wkładane na stos w kolejności tablicy
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void commitResults(PolyStack *s, size_t left, size_t count, Poly results[],
+                   size_t lineNumber) {
+    if (MemoryLimitExceeded() || PolyExpOverflowed()) {
+        for (size_t i = 0; i < count; i++) {
+            PolyDestroy(&results[i]);
+        }
+
+        if (MemoryLimitExceeded()) {
+            outOfMemoryError(lineNumber);
+        } else {
+            expOverflowError(lineNumber);
+        }
+
+        return;
+    }
+
+    for (size_t i = 0; i < left; i++) {
+        Poly operand = PolyStackPop(s);
+        PolyDestroy(&operand);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        PolyStackPush(s, results[i]);
+    }
+}
+
 /**
  * Wstawia na stos wielomian równy zero.
  * @param[in] s : stos @f$s@f$
@@ -95,15 +260,104 @@ void at(PolyStack *s, Line l, size_t lineNumber) {
                 if (PolyStackIsEmpty(*s)) {
                     stackError(lineNumber);
                 } else {
-                    Poly lastPoly = PolyStackPop(s);
-                    PolyStackPush(s, PolyAt(&lastPoly, coeff));
-                    PolyDestroy(&lastPoly);
+                    const PackedPoly *packed = PolyStackPeekPacked(s, 0);
+                    Poly result = packed != NULL ?
+                            PackedPolyAt(packed, coeff) :
+                            PolyAt(PolyStackPeek(s), coeff);
+                    commitResults(s, 1, 1, &result, lineNumber);
                 }
             }
         }
     }
 }
 
+/**
+ * Wczytuje listę liczb, z których każda jest poprzedzona pojedynczą spacją,
+ * od pozycji @p index do końca linii.
+ * @param[in] l : linia @f$l@f$
+ * @param[in] index : pozycja początku listy @f$index@f$
+ * @param[out] values : wczytane liczby; tablica leży w arenie
+ * @param[out] count : liczba wczytanych liczb
+ * @return czy lista jest poprawna
+ */
+bool readValues(Line l, size_t index, poly_coeff_t **values, size_t *count) {
+    bool correct = true;
+    *count = 0;
+
+    for (size_t i = index; i < l.lineLength; i++) {
+        if (l.string[i] == SPACE) {
+            (*count)++;
+        }
+    }
+
+    *values = ArenaAlloc(*count * sizeof(poly_coeff_t));
+    *count = 0;
+
+    while (correct && index < l.lineLength) {
+        if (l.string[index] != SPACE) {
+            correct = false;
+        } else {
+            index++;
+            bool isEmpty = false;
+            bool nonDecimalChars = false;
+            (*values)[*count] = ReadValueCoeff(l, &index, &isEmpty,
+                                               &nonDecimalChars);
+            (*count)++;
+            correct = !isEmpty && !nonDecimalChars;
+        }
+    }
+
+    return correct;
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą AT_MANY.
+ * Zdejmuje wielomian z wierzchołka stosu i wstawia na stos kolejno jego
+ * wartości w podanych punktach, tak że wartość w ostatnim punkcie jest na
+ * wierzchołku stosu.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] s : stos @f$s@f$
+ * @param[in] l : linia @f$l@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void atMany(PolyStack *s, Line l, size_t lineNumber) {
+    poly_coeff_t *xs;
+    size_t count;
+
+    if (!readValues(l, 7, &xs, &count) || count == 0) {
+        wrongValueAtManyError(lineNumber);
+    } else if (PolyStackIsEmpty(*s)) {
+        stackError(lineNumber);
+    } else {
+        Poly *values = ArenaAlloc(count * sizeof(Poly));
+        PolyAtMany(PolyStackPeek(s), count, xs, values);
+        commitResults(s, 1, count, values, lineNumber);
+    }
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą EVAL.
+ * Wypisuje wartość wielomianu z wierzchołka stosu po podstawieniu podanych
+ * liczb pod kolejne zmienne i zera pod pozostałe. Korzysta z planu
+ * wartościowania przechowywanego na stosie razem z wielomianem.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] s : stos @f$s@f$
+ * @param[in] l : linia @f$l@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void eval(PolyStack *s, Line l, size_t lineNumber) {
+    poly_coeff_t *xs;
+    size_t count;
+
+    if (!readValues(l, 4, &xs, &count)) {
+        wrongEvalError(lineNumber);
+    } else if (PolyStackIsEmpty(*s)) {
+        stackError(lineNumber);
+    } else {
+        printf("%ld\n", PolyEvalPlanRun(PolyStackTopPlan(s), count, xs));
+    }
+}
+
 /**
  * Przeprowadza operacje kalkulatora związane z komendą DEG_BY.
  * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
@@ -131,9 +385,144 @@ void degBy(PolyStack *s, Line l, size_t lineNumber) {
                 if (PolyStackIsEmpty(*s)) {
                     stackError(lineNumber);
                 } else {
-                    Poly lastPoly = PolyStackPop(s);
-                    PolyStackPush(s, lastPoly);
-                    printf("%d\n", PolyDegBy(&lastPoly, depth));
+                    const PackedPoly *packed = PolyStackPeekPacked(s, 0);
+                    printf("%d\n", packed != NULL ?
+                                   PackedPolyDegBy(packed, depth) :
+                                   PolyDegBy(PolyStackPeek(s), depth));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą POW.
+ * Zastępuje wielomian z wierzchołka stosu jego potęgą.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] s : stos @f$s@f$
+ * @param[in] l : linia @f$l@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void power(PolyStack *s, Line l, size_t lineNumber) {
+    if (l.lineLength == 3 || l.lineLength == 4) {
+        wrongPowError(lineNumber);
+    } else {
+        size_t index = 3;
+
+        if (l.string[index] != SPACE) {
+            wrongPowError(lineNumber);
+        } else {
+            index++;
+            bool isEmpty = false;
+            bool nonDecimalChars = false;
+            size_t exp = ReadValueSizeT(l, &index, &isEmpty,
+                                        &nonDecimalChars);
+            if (isEmpty || nonDecimalChars || index != l.lineLength ||
+                exp > INT_MAX) {
+                wrongPowError(lineNumber);
+            } else {
+                if (PolyStackIsEmpty(*s)) {
+                    stackError(lineNumber);
+                } else if (!PolyPowFits(PolyStackPeek(s), (poly_exp_t) exp)) {
+                    wrongPowError(lineNumber);
+                } else {
+                    Poly result;
+
+                    if (PolyPowWithinLimit(PolyStackPeek(s), (poly_exp_t) exp,
+                                           &result)) {
+                        commitResults(s, 1, 1, &result, lineNumber);
+                    } else {
+                        PolyDestroy(&result);
+                        outOfMemoryError(lineNumber);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą SCALE.
+ * Mnoży w miejscu wielomian z wierzchołka stosu przez współczynnik.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] s : stos @f$s@f$
+ * @param[in] l : linia @f$l@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void scale(PolyStack *s, Line l, size_t lineNumber) {
+    if (l.lineLength == 5 || l.lineLength == 6) {
+        wrongScaleError(lineNumber);
+    } else {
+        size_t index = 5;
+
+        if (l.string[index] != SPACE) {
+            wrongScaleError(lineNumber);
+        } else {
+            index++;
+            bool isEmpty = false;
+            bool nonDecimalChars = false;
+            poly_coeff_t coeff = ReadValueCoeff(l, &index, &isEmpty,
+                                                &nonDecimalChars);
+            if (isEmpty || nonDecimalChars || index != l.lineLength) {
+                wrongScaleError(lineNumber);
+            } else {
+                if (PolyStackIsEmpty(*s)) {
+                    stackError(lineNumber);
+                } else if (MemoryGetLimit() != 0 &&
+                           !MemoryReserve(PolyUnshareBytes(PolyStackPeek(s)))) {
+                    // mnożenia przez liczbę parzystą nie da się cofnąć
+                    outOfMemoryError(lineNumber);
+                } else {
+                    PolyScaleInPlace(PolyStackTop(s), coeff);
+                    commitTop(s);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą SHIFT.
+ * Mnoży w miejscu wielomian z wierzchołka stosu przez potęgę zmiennej
+ * @f$x_0@f$.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] s : stos @f$s@f$
+ * @param[in] l : linia @f$l@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void shift(PolyStack *s, Line l, size_t lineNumber) {
+    if (l.lineLength == 5 || l.lineLength == 6) {
+        wrongShiftError(lineNumber);
+    } else {
+        size_t index = 5;
+
+        if (l.string[index] != SPACE) {
+            wrongShiftError(lineNumber);
+        } else {
+            index++;
+            bool isEmpty = false;
+            bool nonDecimalChars = false;
+            size_t exp = ReadValueSizeT(l, &index, &isEmpty,
+                                        &nonDecimalChars);
+            if (isEmpty || nonDecimalChars || index != l.lineLength ||
+                exp > INT_MAX) {
+                wrongShiftError(lineNumber);
+            } else {
+                if (PolyStackIsEmpty(*s)) {
+                    stackError(lineNumber);
+                } else if (PolyDegBy(PolyStackPeek(s), 0) >
+                           INT_MAX - (poly_exp_t) exp) {
+                    wrongShiftError(lineNumber);
+                } else {
+                    Poly *top = PolyStackTop(s);
+                    PolyShiftInPlace(top, (poly_exp_t) exp);
+
+                    if (MemoryLimitExceeded()) {
+                        PolyUnshiftInPlace(top, (poly_exp_t) exp);
+                        outOfMemoryError(lineNumber);
+                    }
+
+                    commitTop(s);
                 }
             }
         }
@@ -164,47 +553,86 @@ void compose(PolyStack *s, Line l, size_t lineNumber) {
             if (isEmpty || nonDecimalChars || index != l.lineLength) {
                 wrongComposeError(lineNumber);
             } else {
-                if (PolyStackIsEmpty(*s)) {
+                if (PolyStackIsEmpty(*s) || (*s).index - 1 < parameter) {
                     stackError(lineNumber);
                 } else {
-                    Poly p = PolyStackPop(s);
-                    Poly *polyArr = secureMalloc(STARTING_ARRAY_SIZE *
-                            sizeof(Poly));
-                    size_t resultSize = 0;
-                    bool underflow = false;
-                    size_t allocatedSize = STARTING_ARRAY_SIZE;
-
-                    while (!underflow && resultSize < parameter) {
-                        if (PolyStackIsEmpty(*s)) {
-                            underflow = true;
-                            stackError(lineNumber);
-                        } else {
-                            WritePolyToArray(PolyStackPop(s), &polyArr,
-                                             &resultSize, &allocatedSize);
-                        }
-                    }
+                    // wielomiany zostają na stosie do końca złożenia
+                    Poly *polyArr = ArenaAlloc(parameter * sizeof(Poly));
 
-                    if (!underflow) {
-                        PolyStackPush(s, PolyCompose(&p, resultSize, polyArr));
-                        PolyDestroy(&p);
-                        for (size_t i = 0; i < resultSize; i++) {
-                            PolyDestroy(&(polyArr[i]));
-                        }
-                    } else {
-                        for (size_t i = resultSize; i > 0; i--) {
-                            PolyStackPush(s, polyArr[i - 1]);
-                        }
-
-                        PolyStackPush(s, p);
+                    for (size_t i = 0; i < parameter; i++) {
+                        polyArr[i] = *PolyStackPeekAt(s, i + 1);
                     }
 
-                    free(polyArr);
+                    Poly result = PolyCompose(PolyStackPeek(s), parameter,
+                                              polyArr);
+                    commitResults(s, parameter + 1, 1, &result, lineNumber);
                 }
             }
         }
     }
 }
 
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą NTT_THRESHOLD.
+ * Ustawia próg, od którego gęste wielomiany są mnożone za pomocą NTT.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] l : linia @f$l@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void nttThreshold(Line l, size_t lineNumber) {
+    if (l.lineLength == 13 || l.lineLength == 14) {
+        wrongNttThresholdError(lineNumber);
+    } else {
+        size_t index = 13;
+
+        if (l.string[index] != SPACE) {
+            wrongNttThresholdError(lineNumber);
+        } else {
+            index++;
+            bool isEmpty = false;
+            bool nonDecimalChars = false;
+            size_t threshold = ReadValueSizeT(l, &index, &isEmpty,
+                                              &nonDecimalChars);
+            if (isEmpty || nonDecimalChars || index != l.lineLength) {
+                wrongNttThresholdError(lineNumber);
+            } else {
+                PolySetNttThreshold(threshold);
+            }
+        }
+    }
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą THREADS.
+ * Ustawia liczbę wątków, między które rozdzielane jest mnożenie.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] l : linia @f$l@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void threads(Line l, size_t lineNumber) {
+    if (l.lineLength == 7 || l.lineLength == 8) {
+        wrongThreadsError(lineNumber);
+    } else {
+        size_t index = 7;
+
+        if (l.string[index] != SPACE) {
+            wrongThreadsError(lineNumber);
+        } else {
+            index++;
+            bool isEmpty = false;
+            bool nonDecimalChars = false;
+            size_t count = ReadValueSizeT(l, &index, &isEmpty,
+                                          &nonDecimalChars);
+            if (isEmpty || nonDecimalChars || index != l.lineLength ||
+                count == 0) {
+                wrongThreadsError(lineNumber);
+            } else {
+                PolySetThreads(count);
+            }
+        }
+    }
+}
+
 /**
  * Przeprowadza jednoargumentową operację kalkulatora.
  * W przypadku problemów z wykonaniem tej operacji pokazuje odpowiednie błędy.
@@ -217,32 +645,48 @@ void onePolyOperation(PolyStack *s, size_t lineNumber, enum
     if (PolyStackIsEmpty(*s)) {
         stackError(lineNumber);
     } else {
-        Poly p = PolyStackPop(s);
-        PolyStackPush(s, p);
+        const Poly *p = PolyStackPeek(s);
+        const PackedPoly *packed = PolyStackPeekPacked(s, 0);
+        Poly popped;
         switch (op) {
             case is_coeff:
-                printf("%d\n", PolyIsCoeff(&p));
+                printf("%d\n", PolyIsCoeff(p));
                 break;
             case is_zero:
-                printf("%d\n", PolyIsZero(&p));
+                printf("%d\n", PolyIsZero(p));
                 break;
             case clone:
-                PolyStackPush(s, PolyClone(&p));
+                PolyStackPush(s, PolyClone(p));
                 break;
             case neg:
-                PolyStackPop(s);
-                PolyStackPush(s, PolyNeg(&p));
-                PolyDestroy(&p);
+                PolyNegInPlace(PolyStackTop(s));
+
+                if (MemoryLimitExceeded()) {
+                    PolyNegInPlace(PolyStackTop(s));
+                    outOfMemoryError(lineNumber);
+                }
+
+                commitTop(s);
                 break;
             case deg:
-                printf("%d\n", PolyDeg(&p));
+                printf("%d\n", packed != NULL ? PackedPolyDeg(packed) :
+                                PolyDeg(p));
                 break;
             case print:
-                PolyPrint(&p);
+                if (packed != NULL) {
+                    PackedPolyPrint(packed);
+                } else {
+                    PolyPrint(p);
+                }
+                break;
+            case pack:
+                if (!PolyStackPackTop(s)) {
+                    outOfMemoryError(lineNumber);
+                }
                 break;
             case pop:
-                PolyStackPop(s);
-                PolyDestroy(&p);
+                popped = PolyStackPop(s);
+                PolyDestroy(&popped);
                 break;
             default:;
                 break;
@@ -259,37 +703,82 @@ void onePolyOperation(PolyStack *s, size_t lineNumber, enum
  */
 void twoPolyOperation(PolyStack *s, size_t lineNumber, enum
 TwoArgumentOperation op) {
-    if (PolyStackIsEmpty(*s)) {
+    if ((*s).index < 2) {
         stackError(lineNumber);
+    } else if (op == mul && !PolyMulFits(PolyStackPeekAt(s, 1),
+                                         PolyStackPeekAt(s, 0))) {
+        expOverflowError(lineNumber);
     } else {
-        Poly p1 = PolyStackPop(s);
-        if (PolyStackIsEmpty(*s)) {
-            stackError(lineNumber);
-            PolyStackPush(s, p1);
+        Poly operands[2];
+        size_t left = takeOperands(s, 2, operands);
+        Poly result = PolyZero();
+        switch (op) {
+            case add: result = PolyAddOwn(&operands[1], &operands[0]);
+            break;
+            case mul: result = PolyMulOwn(&operands[1], &operands[0]);
+            break;
+            case sub: result = PolySubOwn(&operands[1], &operands[0]);
+            break;
+            default:;
+            break;
+        }
+        commitResults(s, left, 1, &result, lineNumber);
+    }
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą MEMSTAT. Wypisuje
+ * globalne liczniki pamięci, a następnie pamięć zajmowaną przez kolejne
+ * elementy stosu, zaczynając od wierzchołka.
+ * @param[in] s : stos @f$s@f$
+ */
+void memStat(const PolyStack *s) {
+    MemoryStats stats = MemoryStatsGet();
+    printf("live %zu peak %zu allocations %zu monos %zu\n", stats.liveBytes,
+           stats.peakBytes, stats.allocations, stats.monos);
+
+    for (size_t depth = 0; depth < (*s).index; depth++) {
+        MemoryStats entry = PolyStackEntryMemory(s, depth);
+        printf("%zu: bytes %zu arrays %zu monos %zu\n", depth,
+               entry.liveBytes, entry.allocations, entry.monos);
+    }
+}
+
+/**
+ * Wypisuje na standardowe wyjście błędów zmiany liczników pamięci
+ * spowodowane przez jedną linię wejścia.
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ * @param[in] before : liczniki pamięci sprzed linii @f$before@f$
+ */
+void traceMemory(size_t lineNumber, MemoryStats before) {
+    MemoryStats after = MemoryStatsGet();
+    fprintf(stderr, "MEMORY %zu live %+td peak %zu allocations %zu monos "
+                    "%+td\n", lineNumber,
+            (ptrdiff_t) (after.liveBytes - before.liveBytes),
+            after.windowPeakBytes, after.allocations - before.allocations,
+            (ptrdiff_t) (after.monos - before.monos));
+}
+
+/**
+ * Przeprowadza operacje kalkulatora związane z komendą IS_EQ. Porównuje dwa
+ * wielomiany ze szczytu stosu bez zdejmowania ich. Jeśli oba są spakowane,
+ * porównuje ich spakowane postacie.
+ * W przypadku problemów z wykonaniem tej komendy pokazuje odpowiednie błędy.
+ * @param[in] s : stos @f$s@f$
+ * @param[in] lineNumber : numer linii @f$lineNumber@f$
+ */
+void isEq(PolyStack *s, size_t lineNumber) {
+    if ((*s).index < 2) {
+        stackError(lineNumber);
+    } else {
+        const PackedPoly *p1 = PolyStackPeekPacked(s, 0);
+        const PackedPoly *p2 = PolyStackPeekPacked(s, 1);
+
+        if (p1 != NULL && p2 != NULL) {
+            printf("%d\n", PackedPolyIsEq(p2, p1));
         } else {
-            Poly p2 = PolyStackPop(s);
-            Poly result;
-            switch (op) {
-                case add: result = PolyAdd(&p2, &p1);
-                break;
-                case mul: result = PolyMul(&p2, &p1);
-                break;
-                case sub: result = PolySub(&p2, &p1);
-                break;
-                case is_eq:
-                    printf("%d\n", PolyIsEq(&p2, &p1));
-                break;
-                default:;
-                break;
-            }
-            if (op == is_eq) {
-                PolyStackPush(s, p2);
-                PolyStackPush(s, p1);
-            } else {
-                PolyStackPush(s, result);
-                PolyDestroy(&p1);
-                PolyDestroy(&p2);
-            }
+            printf("%d\n", PolyIsEq(PolyStackPeekAt(s, 1),
+                                    PolyStackPeekAt(s, 0)));
         }
     }
 }
@@ -301,7 +790,10 @@ TwoArgumentOperation op) {
  * @param[in] lineNumber : numer linii @f$lineNumber@f$
  */
 void executeCommand(PolyStack *s, Line l, size_t lineNumber) {
-    if (LineBeginsWith(l, AT)) {
+    if (LineBeginsWith(l, AT_MANY) && (l.lineLength == 7 ||
+                                       l.string[7] == SPACE)) {
+        atMany(s, l, lineNumber);
+    } else if (LineBeginsWith(l, AT)) {
         at(s, l, lineNumber);
     } else if (LineBeginsWith(l, ADD)) {
         twoPolyOperation(s, lineNumber, add);
@@ -315,35 +807,143 @@ void executeCommand(PolyStack *s, Line l, size_t lineNumber) {
         onePolyOperation(s, lineNumber, deg);
     } else if (LineBeginsWith(l, POP)) {
         onePolyOperation(s, lineNumber, pop);
+    } else if (LineBeginsWith(l, MEMSTAT)) {
+        memStat(s);
+    } else if (LineBeginsWith(l, PACK)) {
+        onePolyOperation(s, lineNumber, pack);
     } else if (LineBeginsWith(l, ZERO)) {
         zero(s);
     } else if (LineBeginsWith(l, CLONE)) {
         onePolyOperation(s, lineNumber, clone);
     } else if (LineBeginsWith(l, IS_EQ)) {
-        twoPolyOperation(s, lineNumber, is_eq);
+        isEq(s, lineNumber);
     } else if (LineBeginsWith(l, PRINT)) {
         onePolyOperation(s, lineNumber, print);
     } else if (LineBeginsWith(l, DEG_BY)) {
         degBy(s, l, lineNumber);
     } else if (LineBeginsWith(l, COMPOSE)) {
         compose(s, l, lineNumber);
-    }else if (LineBeginsWith(l, IS_ZERO)) {
+    } else if (LineBeginsWith(l, EVAL)) {
+        eval(s, l, lineNumber);
+    } else if (LineBeginsWith(l, POW)) {
+        power(s, l, lineNumber);
+    } else if (LineBeginsWith(l, SCALE)) {
+        scale(s, l, lineNumber);
+    } else if (LineBeginsWith(l, SHIFT)) {
+        shift(s, l, lineNumber);
+    } else if (LineBeginsWith(l, NTT_THRESHOLD)) {
+        nttThreshold(l, lineNumber);
+    } else if (LineBeginsWith(l, THREADS)) {
+        threads(l, lineNumber);
+    } else if (LineBeginsWith(l, IS_ZERO)) {
         onePolyOperation(s, lineNumber, is_zero);
     } else if (LineBeginsWith(l, IS_COEFF)) {
         onePolyOperation(s, lineNumber, is_coeff);
     }
 }
 
+/**
+ * Wypisuje na standardowe wyjście błędów błąd nieznanej opcji programu.
+ * @param[in] option : opcja @f$option@f$
+ */
+void wrongOptionError(const char *option) {
+    fprintf(stderr, "ERROR WRONG OPTION %s\n", option);
+}
+
+/**
+ * Wczytuje dodatni limit pamięci zapisany w systemie dziesiętnym.
+ * @param[in] string : ciąg znaków @f$string@f$ lub NULL
+ * @param[out] limit : wczytany limit
+ * @return czy ciąg znaków jest poprawnym limitem
+ */
+bool readLimit(const char *string, size_t *limit) {
+    if (string == NULL || *string == '\0') {
+
+        return false;
+    }
+
+    size_t result = 0;
+
+    for (const char *c = string; *c != '\0'; c++) {
+        if (*c < '0' || *c > '9' || result > (SIZE_MAX - (*c - '0')) / 10) {
+
+            return false;
+        }
+
+        result = result * 10 + (size_t) (*c - '0');
+    }
+
+    *limit = result;
+
+    return result > 0;
+}
+
+/**
+ * Odczytuje opcje programu i ustawia według nich stos, limit pamięci oraz
+ * wejście kalkulatora.
+ * @param[in] argc : liczba argumentów programu @f$argc@f$
+ * @param[in] argv : argumenty programu @f$argv@f$
+ * @param[in] s : stos @f$s@f$
+ * @param[out] trace : czy wypisywać zmiany liczników pamięci
+ * @return czy wszystkie opcje są poprawne
+ */
+bool readOptions(int argc, char *argv[], PolyStack *s, bool *trace) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], INTERN_OPTION) == 0) {
+            (*s).intern = true;
+        } else if (strcmp(argv[i], TRACE_MEMORY_OPTION) == 0) {
+            *trace = true;
+        } else if (strcmp(argv[i], MAX_MEMORY_OPTION) == 0) {
+            size_t limit;
+
+            if (!readLimit(argv[i + 1], &limit)) {
+                wrongOptionError(argv[i]);
+
+                return false;
+            }
+
+            MemorySetLimit(limit);
+            i++;
+        } else if (strcmp(argv[i], SCRIPT_OPTION) == 0) {
+            if (argv[i + 1] == NULL || !LineReadScript(argv[i + 1])) {
+                wrongOptionError(argv[i]);
+
+                return false;
+            }
+
+            i++;
+        } else {
+            wrongOptionError(argv[i]);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
 /**
  * Przeprowadza ciąg czynności charakterystycznych dla kalkulatora.
  * @return 0 jeśli wszystko przebiegło pomyślnie, 1 wpp.
  */
-int main() {
+int main(int argc, char *argv[]) {
     PolyStack s = PolyStackInit();
+    ArenaMark commandMark = ArenaGetMark();
     size_t lineNumber = 1;
+    bool trace = false;
+
+    if (!readOptions(argc, argv, &s, &trace)) {
+
+        return 1;
+    }
 
     while (IsNextLine()) {
         Line nextLine = LineRead();
+        Poly p;
+        MemoryStats before = MemoryStatsGet();
+        MemoryWindowReset();
+        MemoryLimitClear(); // każda linia jest osobną transakcją
+        PolyExpOverflowClear();
 
         if (ShouldIgnoreLine(nextLine)) {
         } else if (LineIsCommand(nextLine)) {
@@ -352,15 +952,25 @@ int main() {
             } else {
                 wrongCommandError(lineNumber);
             }
-        } else if (PolyIsCorrect(nextLine)) {
-            PolyStackPush(&s, PolyRead(nextLine));
+        } else if (PolyParse(nextLine, &p)) {
+            commitResults(&s, 0, 1, &p, lineNumber);
         } else {
             wrongPolyError(lineNumber);
         }
 
         LineDestroy(nextLine);
+        ArenaRelease(commandMark); // dane tymczasowe żyją do końca komendy
+
+        if (trace) {
+            traceMemory(lineNumber, before);
+        }
+
         lineNumber++;
     }
 
     PolyStackDestroy(&s);
+    LineReadFinish();
+    PolyThreadsRelease();
+    ArenaReset();
+    PoolRelease();
 }
\ No newline at end of file
@@ -9,9 +9,10 @@
 */
 
 /** To jest typ reprezentujący operacje dwuargumentowe. */
-enum TwoArgumentOperation {add, mul, sub, is_eq};
+enum TwoArgumentOperation {add, mul, sub};
 
 /** To jest typ reprezentujący operacje jednoargumentowe. */
-enum OneArgumentOperation {is_coeff, is_zero, clone, neg, deg, print, pop};
+enum OneArgumentOperation {is_coeff, is_zero, clone, neg, deg, print, pop,
+        pack};
 
 #endif //POPRAWKA_DUZE_ZADANIE_CALC_H
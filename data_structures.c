@@ -5,11 +5,116 @@
   @copyright Uniwersytet Warszawski
   @date 2021
 */
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include "data_structures.h"
 
+/** To jest makrodefinicja reprezentująca liczbę klas rozmiarów puli. */
+#define POOL_CLASSES 4
+
+/** To jest makrodefinicja reprezentująca rozmiar bloków najmniejszej klasy
+ * puli w bajtach. Każda kolejna klasa ma dwa razy większe bloki. */
+#define POOL_MIN_BLOCK 64
+
+/** To jest makrodefinicja reprezentująca maksymalną liczbę wolnych bloków
+ * jednej klasy przechowywanych przez wątek. */
+#define POOL_MAX_CACHED 4096
+
+/**
+ * To jest struktura przechowująca wolny blok puli. Wolne bloki tworzą listę.
+ */
+typedef struct PoolBlock {
+    struct PoolBlock *next; ///< następny wolny blok
+} PoolBlock;
+
+/**
+ * To jest struktura przechowująca listy wolnych bloków i liczniki jednego
+ * wątku.
+ */
+typedef struct PoolCache {
+    PoolBlock *free[POOL_CLASSES]; ///< listy wolnych bloków kolejnych klas
+    size_t cached[POOL_CLASSES]; ///< długości list wolnych bloków
+    PoolStats stats; ///< liczniki wątku
+} PoolCache;
+
+/** To jest zmienna przechowująca listy wolnych bloków bieżącego wątku. */
+static _Thread_local PoolCache poolCache;
+
+/** To jest makrodefinicja reprezentująca domyślny rozmiar fragmentu areny
+ * w bajtach. */
+#define ARENA_CHUNK_SIZE (1 << 16)
+
+/**
+ * To jest struktura przechowująca fragment areny. Fragmenty tworzą stos,
+ * a pamięć przydzielana jest z ostatniego fragmentu przez przesuwanie
+ * wskaźnika.
+ */
+typedef struct ArenaChunk {
+    struct ArenaChunk *previous; ///< poprzedni fragment areny
+    size_t size; ///< rozmiar danych fragmentu w bajtach
+    size_t used; ///< liczba zajętych bajtów fragmentu
+    max_align_t data[]; ///< dane fragmentu
+} ArenaChunk;
+
+/** To jest zmienna przechowująca ostatni fragment areny bieżącego wątku. */
+static _Thread_local ArenaChunk *arena = NULL;
+
+/** To jest zmienna przechowująca największy zwolniony fragment areny
+ * bieżącego wątku, gotowy do ponownego użycia. */
+static _Thread_local ArenaChunk *arenaSpare = NULL;
+
+/** To jest zmienna mówiąca, czy bieżący wątek zarejestrował zwalnianie
+ * swojej puli i areny przy zakończeniu. */
+static _Thread_local bool threadExitRegistered = false;
+
+/** To jest zmienna przechowująca klucz, którego destruktor zwalnia pulę
+ * i arenę kończącego się wątku. */
+static pthread_key_t threadKey;
+
+/** To jest zmienna gwarantująca jednokrotne utworzenie klucza threadKey. */
+static pthread_once_t threadKeyOnce = PTHREAD_ONCE_INIT;
+
+/** To jest zmienna przechowująca liczbę alokacji zakończonych wątków. */
+static atomic_size_t poolAllocations;
+
+/** To jest zmienna przechowująca liczbę trafień w listy wolnych bloków
+ * zakończonych wątków. */
+static atomic_size_t poolCacheHits;
+
+/** To jest zmienna przechowująca liczbę zwolnień zakończonych wątków. */
+static atomic_size_t poolFrees;
+
+/** To jest zmienna przechowująca liczbę bajtów zajętych przez bloki puli
+ * i fragmenty aren wszystkich wątków. */
+static atomic_size_t memoryLive;
+
+/** To jest zmienna przechowująca największą wartość memoryLive. */
+static atomic_size_t memoryPeak;
+
+/** To jest zmienna przechowująca największą wartość memoryLive od
+ * ostatniego wywołania MemoryWindowReset. */
+static atomic_size_t memoryWindowPeak;
+
+/** To jest zmienna przechowująca liczbę alokacji bloków puli i fragmentów
+ * aren. */
+static atomic_size_t memoryAllocations;
+
+/** To jest zmienna przechowująca liczbę jednomianów w zaalokowanych
+ * tablicach. */
+static atomic_size_t memoryMonos;
+
+/** To jest zmienna przechowująca limit liczby zajętych bajtów; zero oznacza
+ * brak limitu. */
+static atomic_size_t memoryLimit;
+
+/** To jest zmienna mówiąca, czy od ostatniego wywołania MemoryLimitClear
+ * przekroczono limit pamięci. */
+static atomic_bool memoryExceeded;
+
 PolyStack PolyStackInit() {
-    return (PolyStack) {.arr = NULL, .index = 0, .arraySize = 0};
+    return (PolyStack) {.arr = NULL, .index = 0, .arraySize = 0, .intern =
+            false};
 }
 
 bool PolyStackIsEmpty(PolyStack s) {
@@ -40,28 +145,112 @@ void ExtendPolyArray(Poly **arr, size_t *arraySize) {
     (*arr) = newArr;
 }
 
+/**
+ * Przedłuża tablicę elementów stosu.
+ * @param[in] s : stos @f$s@f$
+ */
+void ExtendStackArray(PolyStack *s) {
+    size_t newSize = (*s).arraySize == 0 ? STARTING_ARRAY_SIZE :
+            (*s).arraySize * 2;
+    PolyStackEntry *newArr = secureMalloc(newSize * sizeof(PolyStackEntry));
+
+    for (size_t i = 0; i < (*s).arraySize; i++) {
+        newArr[i] = (*s).arr[i];
+    }
+
+    free((*s).arr);
+    (*s).arr = newArr;
+    (*s).arraySize = newSize;
+}
+
 void PolyStackPush(PolyStack *s, Poly p) {
 
     if ((*s).index == (*s).arraySize) {
-        ExtendPolyArray(&((*s).arr), &((*s).arraySize));
+        ExtendStackArray(s);
+    }
+
+    if ((*s).intern) {
+        p = PolyIntern(&p);
     }
 
-    (*s).arr[(*s).index] = p;
+    (*s).arr[(*s).index] = (PolyStackEntry) {.p = p, .plan = NULL,
+            .packed = NULL};
     ((*s).index)++;
 }
 
 Poly PolyStackPop(PolyStack *s) {
     assert(!PolyStackIsEmpty(*s));
-    Poly result = (*s).arr[(*s).index - 1];
-    (*s).arr[(*s).index - 1] = PolyZero();
+    PolyStackEntry *entry = &(*s).arr[(*s).index - 1];
+    Poly result = entry->p;
+    PolyEvalPlanDestroy(entry->plan);
+    PackedPolyDestroy(entry->packed);
+    *entry = (PolyStackEntry) {.p = PolyZero(), .plan = NULL, .packed = NULL};
     ((*s).index)--;
     return result;
 }
 
+const Poly *PolyStackPeek(const PolyStack *s) {
+    assert(!PolyStackIsEmpty(*s));
+
+    return &(*s).arr[(*s).index - 1].p;
+}
+
+Poly *PolyStackTop(PolyStack *s) {
+    assert(!PolyStackIsEmpty(*s));
+    PolyStackEntry *entry = &(*s).arr[(*s).index - 1];
+    PolyEvalPlanDestroy(entry->plan);
+    PackedPolyDestroy(entry->packed);
+    entry->plan = NULL;
+    entry->packed = NULL;
+
+    return &entry->p;
+}
+
+const PolyEvalPlan *PolyStackTopPlan(PolyStack *s) {
+    assert(!PolyStackIsEmpty(*s));
+    PolyStackEntry *entry = &(*s).arr[(*s).index - 1];
+
+    if (entry->plan == NULL) {
+        entry->plan = PolyEvalPlanCreate(&entry->p);
+    }
+
+    return entry->plan;
+}
+
+bool PolyStackPackTop(PolyStack *s) {
+    assert(!PolyStackIsEmpty(*s));
+    PolyStackEntry *entry = &(*s).arr[(*s).index - 1];
+
+    if (entry->packed == NULL) {
+        if (!MemoryReserve(PolyPackedBytes(&entry->p))) {
+
+            return false;
+        }
+
+        entry->packed = PolyPack(&entry->p);
+    }
+
+    return true;
+}
+
+const Poly *PolyStackPeekAt(const PolyStack *s, size_t depth) {
+    assert(depth < (*s).index);
+
+    return &(*s).arr[(*s).index - 1 - depth].p;
+}
+
+const PackedPoly *PolyStackPeekPacked(const PolyStack *s, size_t depth) {
+    assert(depth < (*s).index);
+
+    return (*s).arr[(*s).index - 1 - depth].packed;
+}
+
 void PolyStackDestroy(PolyStack *s) {
     if (!PolyStackIsEmpty(*s)) {
         for (size_t i = 0; i < (*s).index; i++) {
-            PolyDestroy(&((*s).arr[i]));
+            PolyDestroy(&((*s).arr[i].p));
+            PolyEvalPlanDestroy((*s).arr[i].plan);
+            PackedPolyDestroy((*s).arr[i].packed);
         }
     }
     free((*s).arr);
@@ -84,4 +273,301 @@ void *secureMalloc(size_t size) {
     }
 
     return ptr;
-}
\ No newline at end of file
+}
+
+/**
+ * Podnosi licznik szczytowy do zadanej wartości, jeśli jest od niej mniejszy.
+ * @param[in] peak : licznik szczytowy @f$peak@f$
+ * @param[in] live : bieżąca liczba bajtów @f$live@f$
+ */
+void MemoryPeakRaise(atomic_size_t *peak, size_t live) {
+    size_t current = atomic_load_explicit(peak, memory_order_relaxed);
+
+    while (live > current && !atomic_compare_exchange_weak_explicit(
+            peak, &current, live, memory_order_relaxed,
+            memory_order_relaxed)) {
+    }
+}
+
+/**
+ * Dolicza alokację do liczników pamięci.
+ * @param[in] size : wielkość zaalokowanej pamięci @f$size@f$
+ */
+void MemoryAcquire(size_t size) {
+    size_t live = atomic_fetch_add_explicit(&memoryLive, size,
+                                            memory_order_relaxed) + size;
+    atomic_fetch_add_explicit(&memoryAllocations, 1, memory_order_relaxed);
+    MemoryPeakRaise(&memoryPeak, live);
+    MemoryPeakRaise(&memoryWindowPeak, live);
+    size_t limit = atomic_load_explicit(&memoryLimit, memory_order_relaxed);
+
+    if (limit != 0 && live > limit) {
+        atomic_store_explicit(&memoryExceeded, true, memory_order_relaxed);
+    }
+}
+
+/**
+ * Odlicza zwolnienie od liczników pamięci.
+ * @param[in] size : wielkość zwalnianej pamięci @f$size@f$
+ */
+void MemoryRelease(size_t size) {
+    atomic_fetch_sub_explicit(&memoryLive, size, memory_order_relaxed);
+}
+
+/**
+ * Zwalnia fragment areny i odlicza go od liczników pamięci. Dopuszcza
+ * wartość NULL.
+ * @param[in] chunk : fragment areny @f$chunk@f$
+ */
+void ArenaChunkFree(ArenaChunk *chunk) {
+    if (chunk != NULL) {
+        MemoryRelease(sizeof(ArenaChunk) + chunk->size);
+        free(chunk);
+    }
+}
+
+/**
+ * Wyznacza klasę rozmiaru bloku.
+ * @param[in] size : wielkość bloku @f$size@f$
+ * @return klasa rozmiaru lub POOL_CLASSES dla bloków spoza puli
+ */
+size_t PoolClassOf(size_t size) {
+    size_t sizeClass = 0;
+    size_t blockSize = POOL_MIN_BLOCK;
+
+    while (sizeClass < POOL_CLASSES && blockSize < size) {
+        sizeClass++;
+        blockSize *= 2;
+    }
+
+    return sizeClass;
+}
+
+/**
+ * Zwalnia listy wolnych bloków i arenę kończącego się wątku oraz dolicza
+ * jego liczniki do liczników globalnych.
+ * @param[in] arg : dowolna niezerowa wartość klucza @f$arg@f$
+ */
+void ThreadExit(void *arg) {
+    (void) arg;
+    ArenaReset();
+    PoolRelease();
+    atomic_fetch_add(&poolAllocations, poolCache.stats.allocations);
+    atomic_fetch_add(&poolCacheHits, poolCache.stats.cacheHits);
+    atomic_fetch_add(&poolFrees, poolCache.stats.frees);
+    poolCache.stats = (PoolStats) {.allocations = 0, .cacheHits = 0,
+            .frees = 0};
+}
+
+/**
+ * Tworzy klucz, którego destruktor zwalnia pulę i arenę wątku.
+ */
+void ThreadKeyCreate(void) {
+    pthread_key_create(&threadKey, ThreadExit);
+}
+
+/**
+ * Rejestruje zwolnienie puli i areny bieżącego wątku przy jego zakończeniu.
+ */
+void ThreadExitRegister(void) {
+    if (!threadExitRegistered) {
+        pthread_once(&threadKeyOnce, ThreadKeyCreate);
+        pthread_setspecific(threadKey, &threadExitRegistered);
+        threadExitRegistered = true;
+    }
+}
+
+void *securePoolMalloc(size_t size) {
+    size_t sizeClass = PoolClassOf(size);
+    poolCache.stats.allocations++;
+    MemoryAcquire(size);
+
+    if (sizeClass == POOL_CLASSES) {
+
+        return secureMalloc(size);
+    } else if (poolCache.free[sizeClass] != NULL) {
+        PoolBlock *block = poolCache.free[sizeClass];
+        poolCache.free[sizeClass] = block->next;
+        poolCache.cached[sizeClass]--;
+        poolCache.stats.cacheHits++;
+
+        return block;
+    }
+
+    return secureMalloc((size_t) POOL_MIN_BLOCK << sizeClass);
+}
+
+void securePoolFree(void *ptr, size_t size) {
+    size_t sizeClass = PoolClassOf(size);
+
+    if (ptr == NULL) {
+
+        return;
+    }
+
+    poolCache.stats.frees++;
+    MemoryRelease(size);
+
+    if (sizeClass == POOL_CLASSES ||
+        poolCache.cached[sizeClass] == POOL_MAX_CACHED) {
+        free(ptr);
+    } else {
+        ThreadExitRegister();
+        PoolBlock *block = ptr;
+        block->next = poolCache.free[sizeClass];
+        poolCache.free[sizeClass] = block;
+        poolCache.cached[sizeClass]++;
+    }
+}
+
+void PoolRelease(void) {
+    for (size_t i = 0; i < POOL_CLASSES; i++) {
+        while (poolCache.free[i] != NULL) {
+            PoolBlock *block = poolCache.free[i];
+            poolCache.free[i] = block->next;
+            free(block);
+        }
+
+        poolCache.cached[i] = 0;
+    }
+}
+
+PoolStats PoolStatsGet(void) {
+    return (PoolStats) {
+            .allocations = poolCache.stats.allocations +
+                    atomic_load(&poolAllocations),
+            .cacheHits = poolCache.stats.cacheHits +
+                    atomic_load(&poolCacheHits),
+            .frees = poolCache.stats.frees + atomic_load(&poolFrees)};
+}
+
+ArenaMark ArenaGetMark(void) {
+    return (ArenaMark) {.chunk = arena, .used = arena == NULL ? 0 :
+            arena->used};
+}
+
+void *ArenaAlloc(size_t size) {
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) *
+            sizeof(max_align_t);
+
+    if (arena == NULL || arena->size - arena->used < size) {
+        ArenaChunk *chunk;
+
+        if (arenaSpare != NULL && arenaSpare->size >= size) {
+            chunk = arenaSpare;
+            arenaSpare = NULL;
+        } else {
+            size_t chunkSize = size > ARENA_CHUNK_SIZE ? size :
+                    ARENA_CHUNK_SIZE;
+            chunk = secureMalloc(sizeof(ArenaChunk) + chunkSize);
+            chunk->size = chunkSize;
+            MemoryAcquire(sizeof(ArenaChunk) + chunkSize);
+            ThreadExitRegister();
+        }
+
+        chunk->previous = arena;
+        chunk->used = 0;
+        arena = chunk;
+    }
+
+    void *ptr = (char *) arena->data + arena->used;
+    arena->used += size;
+
+    return ptr;
+}
+
+void ArenaRelease(ArenaMark mark) {
+    while (arena != mark.chunk) {
+        ArenaChunk *chunk = arena;
+        arena = chunk->previous;
+
+        if (arenaSpare == NULL || arenaSpare->size < chunk->size) {
+            ArenaChunkFree(arenaSpare);
+            arenaSpare = chunk;
+        } else {
+            ArenaChunkFree(chunk);
+        }
+    }
+
+    if (arena != NULL) {
+        arena->used = mark.used;
+    }
+}
+
+void ArenaReset(void) {
+    ArenaRelease((ArenaMark) {.chunk = NULL, .used = 0});
+    ArenaChunkFree(arenaSpare);
+    arenaSpare = NULL;
+}
+
+void MemoryMonosAllocated(size_t count) {
+    atomic_fetch_add_explicit(&memoryMonos, count, memory_order_relaxed);
+}
+
+void MemoryMonosFreed(size_t count) {
+    atomic_fetch_sub_explicit(&memoryMonos, count, memory_order_relaxed);
+}
+
+MemoryStats MemoryStatsGet(void) {
+    return (MemoryStats) {
+            .liveBytes = atomic_load(&memoryLive),
+            .peakBytes = atomic_load(&memoryPeak),
+            .windowPeakBytes = atomic_load(&memoryWindowPeak),
+            .allocations = atomic_load(&memoryAllocations),
+            .monos = atomic_load(&memoryMonos)};
+}
+
+void MemoryWindowReset(void) {
+    atomic_store(&memoryWindowPeak, atomic_load(&memoryLive));
+}
+
+void MemorySetLimit(size_t limit) {
+    atomic_store(&memoryLimit, limit);
+}
+
+size_t MemoryGetLimit(void) {
+    return atomic_load_explicit(&memoryLimit, memory_order_relaxed);
+}
+
+bool MemoryReserve(size_t size) {
+    size_t limit = MemoryGetLimit();
+
+    if (limit == 0) {
+
+        return true;
+    }
+
+    size_t live = atomic_load_explicit(&memoryLive, memory_order_relaxed);
+
+    if (MemoryLimitExceeded() || live > limit || size > limit - live) {
+        atomic_store_explicit(&memoryExceeded, true, memory_order_relaxed);
+
+        return false;
+    }
+
+    return true;
+}
+
+bool MemoryLimitExceeded(void) {
+    return atomic_load_explicit(&memoryExceeded, memory_order_relaxed);
+}
+
+void MemoryLimitClear(void) {
+    atomic_store(&memoryExceeded, false);
+}
+
+MemoryStats PolyStackEntryMemory(const PolyStack *s, size_t depth) {
+    assert(depth < (*s).index);
+    const PolyStackEntry *entry = &(*s).arr[(*s).index - 1 - depth];
+    MemoryStats stats = {.liveBytes = 0, .peakBytes = 0, .windowPeakBytes =
+            0, .allocations = 0, .monos = 0};
+    PolyMemoryUsage(&entry->p, &stats.liveBytes, &stats.allocations,
+                    &stats.monos);
+
+    if (entry->packed != NULL) {
+        stats.liveBytes += PackedPolyBytes(entry->packed);
+        stats.allocations++;
+    }
+
+    return stats;
+}
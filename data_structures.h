@@ -8,20 +8,33 @@
   @date 2021
 */
 #include "poly.h"
+#include "packed_poly.h"
 
 /** To jest makrodefinicja reprezentująca początkową długość tablic
  * dynamicznych. */
 #define STARTING_ARRAY_SIZE 1
 
+/**
+ * To jest struktura przechowująca element stosu wielomianów.
+ * Oprócz wielomianu przechowuje leniwie tworzony plan jego wartościowania
+ * i, na życzenie, jego spakowaną kopię.
+ */
+typedef struct PolyStackEntry {
+    Poly p; ///< wielomian
+    PolyEvalPlan *plan; ///< plan wartościowania wielomianu lub NULL
+    PackedPoly *packed; ///< spakowany wielomian lub NULL
+} PolyStackEntry;
+
 /**
  * To jest struktura przechowująca stos wielomianów.
- * Składa się z tablicy wielomianów, długości tej tablicy i indexu, do
+ * Składa się z tablicy elementów, długości tej tablicy i indexu, do
  * którego poziomu jest zapełniona.
  */
 typedef struct PolyStack {
-    Poly *arr; ///< tablica wielomianów
+    PolyStackEntry *arr; ///< tablica elementów stosu
     size_t arraySize; ///< rozmiar tablicy wielomianów
     size_t index; ///< indeks poziomu zapełnienia
+    bool intern; ///< czy wkładane wielomiany są internowane
 } PolyStack;
 
 /**
@@ -38,7 +51,8 @@ PolyStack PolyStackInit();
 bool PolyStackIsEmpty(PolyStack s);
 
 /**
- * Wkłada wielomian na szczyt stosu.
+ * Wkłada wielomian na szczyt stosu. Jeśli stos internuje wielomiany, to
+ * wkładany jest internowany wielomian równy @p p.
  * @param[in] s : stos @f$s@f$
  * @param[in] p : wielomian @f$p@f$
  */
@@ -51,6 +65,56 @@ void PolyStackPush(PolyStack *s, Poly p);
  */
 Poly PolyStackPop(PolyStack *s);
 
+/**
+ * Zwraca wielomian ze szczytu stosu bez zdejmowania go.
+ * @param[in] s : niepusty stos @f$s@f$
+ * @return wskaźnik na wielomian ze szczytu stosu
+ */
+const Poly *PolyStackPeek(const PolyStack *s);
+
+/**
+ * Daje dostęp do wielomianu ze szczytu stosu w celu zmodyfikowania go
+ * w miejscu. Unieważnia plan wartościowania i spakowaną kopię tego
+ * wielomianu.
+ * @param[in] s : niepusty stos @f$s@f$
+ * @return wskaźnik na wielomian ze szczytu stosu
+ */
+Poly *PolyStackTop(PolyStack *s);
+
+/**
+ * Zwraca plan wartościowania wielomianu ze szczytu stosu. Plan jest tworzony
+ * przy pierwszym użyciu i przechowywany, dopóki wielomian jest na stosie.
+ * @param[in] s : niepusty stos @f$s@f$
+ * @return plan wartościowania wielomianu ze szczytu stosu
+ */
+const PolyEvalPlan *PolyStackTopPlan(PolyStack *s);
+
+/**
+ * Pakuje wielomian ze szczytu stosu. Spakowana kopia jest przechowywana,
+ * dopóki wielomian nie zostanie zdjęty ani zmodyfikowany. Rozmiar kopii
+ * jest wyliczany przed pakowaniem; jeśli nie mieści się w limicie pamięci,
+ * kopia nie jest tworzona.
+ * @param[in] s : niepusty stos @f$s@f$
+ * @return czy wielomian jest spakowany
+ */
+bool PolyStackPackTop(PolyStack *s);
+
+/**
+ * Zwraca wielomian leżący na zadanej głębokości stosu bez zdejmowania go.
+ * @param[in] s : stos @f$s@f$ o więcej niż @p depth elementach
+ * @param[in] depth : głębokość liczona od szczytu stosu @f$depth@f$
+ * @return wskaźnik na wielomian
+ */
+const Poly *PolyStackPeekAt(const PolyStack *s, size_t depth);
+
+/**
+ * Zwraca spakowaną kopię wielomianu leżącego na zadanej głębokości stosu.
+ * @param[in] s : stos @f$s@f$ o więcej niż @p depth elementach
+ * @param[in] depth : głębokość liczona od szczytu stosu @f$depth@f$
+ * @return spakowany wielomian lub NULL, jeśli wielomian nie był pakowany
+ */
+const PackedPoly *PolyStackPeekPacked(const PolyStack *s, size_t depth);
+
 /**
  * Usuwa stos i zwalnia pamięć po nim.
  * @param[in] s : stos @f$s@f$
@@ -76,4 +140,169 @@ void WritePolyToArray(Poly p, Poly **arr, size_t *index, size_t
  */
 void *secureMalloc(size_t size);
 
+/**
+ * To jest struktura przechowująca liczniki puli pamięci.
+ */
+typedef struct PoolStats {
+    size_t allocations; ///< liczba alokacji z puli
+    size_t cacheHits; ///< liczba alokacji obsłużonych z listy wolnych bloków
+    size_t frees; ///< liczba zwolnień do puli
+} PoolStats;
+
+/**
+ * Bezpiecznie alokuje pamięć podanej wielkości z puli. Małe bloki należą do
+ * klas rozmiarów i są brane z list wolnych bloków bieżącego wątku, a większe
+ * alokowane są funkcją secureMalloc. Pamięć należy zwolnić funkcją
+ * securePoolFree z tą samą wielkością.
+ * @param[in] size : wielkość do zaalokowania @f$size@f$
+ * @return adres z zaalokowaną pamięcią
+ */
+void *securePoolMalloc(size_t size);
+
+/**
+ * Zwalnia pamięć zaalokowaną funkcją securePoolMalloc. Małe bloki trafiają na
+ * listę wolnych bloków bieżącego wątku. Dopuszcza wartość NULL.
+ * @param[in] ptr : adres pamięci @f$ptr@f$
+ * @param[in] size : wielkość podana przy alokacji @f$size@f$
+ */
+void securePoolFree(void *ptr, size_t size);
+
+/**
+ * Zwalnia wszystkie wolne bloki z list bieżącego wątku. Listy wątków
+ * pomocniczych zwalniane są automatycznie przy ich zakończeniu.
+ */
+void PoolRelease(void);
+
+/**
+ * Zwraca liczniki puli pamięci zsumowane po bieżącym wątku i zakończonych
+ * wątkach.
+ * @return liczniki puli pamięci
+ */
+PoolStats PoolStatsGet(void);
+
+/**
+ * To jest struktura przechowująca znacznik areny, czyli stan areny, do
+ * którego można ją cofnąć.
+ */
+typedef struct ArenaMark {
+    struct ArenaChunk *chunk; ///< ostatni fragment areny
+    size_t used; ///< liczba zajętych bajtów ostatniego fragmentu
+} ArenaMark;
+
+/**
+ * Zwraca znacznik bieżącego stanu areny bieżącego wątku.
+ * @return znacznik areny
+ */
+ArenaMark ArenaGetMark(void);
+
+/**
+ * Przydziela pamięć na dane tymczasowe z areny bieżącego wątku przez
+ * przesunięcie wskaźnika. Pamięci nie zwalnia się pojedynczo - jest ona
+ * odzyskiwana przez ArenaRelease lub ArenaReset. Nie sprawdza limitu
+ * pamięci: duże tablice tymczasowe trzeba wcześniej sprawdzić funkcją
+ * MemoryReserve i przerwać obliczenia, jeśli się nie zmieszczą.
+ * @param[in] size : wielkość do przydzielenia @f$size@f$
+ * @return adres przydzielonej pamięci
+ */
+void *ArenaAlloc(size_t size);
+
+/**
+ * Cofa arenę bieżącego wątku do stanu ze znacznika, odzyskując całą pamięć
+ * przydzieloną po jego utworzeniu. Znaczniki należy cofać w kolejności
+ * odwrotnej do ich tworzenia.
+ * @param[in] mark : znacznik areny @f$mark@f$
+ */
+void ArenaRelease(ArenaMark mark);
+
+/**
+ * Opróżnia arenę bieżącego wątku i zwalnia całą jej pamięć.
+ */
+void ArenaReset(void);
+
+/**
+ * To jest struktura przechowująca liczniki pamięci. Liczone są bloki puli,
+ * w tym tablice jednomianów i spakowane wielomiany, oraz fragmenty aren
+ * wszystkich wątków.
+ */
+typedef struct MemoryStats {
+    size_t liveBytes; ///< liczba zajętych bajtów
+    size_t peakBytes; ///< największa liczba zajętych bajtów
+    size_t windowPeakBytes; ///< największa liczba zajętych bajtów od
+                            ///< ostatniego wywołania MemoryWindowReset
+    size_t allocations; ///< liczba wszystkich alokacji
+    size_t monos; ///< liczba jednomianów w zaalokowanych tablicach
+} MemoryStats;
+
+/**
+ * Dolicza jednomiany nowo zaalokowanej tablicy do liczników pamięci.
+ * @param[in] count : pojemność tablicy @f$count@f$
+ */
+void MemoryMonosAllocated(size_t count);
+
+/**
+ * Odlicza jednomiany zwalnianej tablicy od liczników pamięci.
+ * @param[in] count : pojemność tablicy @f$count@f$
+ */
+void MemoryMonosFreed(size_t count);
+
+/**
+ * Zwraca liczniki pamięci zsumowane po wszystkich wątkach.
+ * @return liczniki pamięci
+ */
+MemoryStats MemoryStatsGet(void);
+
+/**
+ * Rozpoczyna nowe okno pomiaru szczytowego zużycia pamięci. Licznik
+ * windowPeakBytes przyjmuje bieżącą liczbę zajętych bajtów.
+ */
+void MemoryWindowReset(void);
+
+/**
+ * Ustawia limit liczby zajętych bajtów. Limit jest miękki: alokacja, która
+ * go przekracza, nie kończy się błędem, lecz oznacza przekroczenie limitu,
+ * po którym duże operacje na wielomianach przerywają obliczenia i zwracają
+ * niepoprawne wyniki. Wyniki obliczeń zakończonych po przekroczeniu limitu
+ * należy usunąć.
+ * @param[in] limit : limit w bajtach @f$limit@f$; zero oznacza brak limitu
+ */
+void MemorySetLimit(size_t limit);
+
+/**
+ * Zwraca limit liczby zajętych bajtów.
+ * @return limit w bajtach; zero oznacza brak limitu
+ */
+size_t MemoryGetLimit(void);
+
+/**
+ * Sprawdza przed dużą alokacją, czy zmieści się ona w limicie pamięci.
+ * Jeśli nie, oznacza przekroczenie limitu.
+ * @param[in] size : wielkość planowanej alokacji @f$size@f$
+ * @return czy alokacja zmieści się w limicie i limit nie był przekroczony
+ */
+bool MemoryReserve(size_t size);
+
+/**
+ * Sprawdza, czy od ostatniego wywołania MemoryLimitClear przekroczono limit
+ * pamięci.
+ * @return czy limit pamięci został przekroczony
+ */
+bool MemoryLimitExceeded(void);
+
+/**
+ * Zapomina o przekroczeniu limitu pamięci. Wywoływana przed rozpoczęciem
+ * operacji, której wynik może zostać odrzucony.
+ */
+void MemoryLimitClear(void);
+
+/**
+ * Wylicza pamięć zajmowaną przez element leżący na zadanej głębokości stosu:
+ * tablice jednomianów wielomianu i jego spakowaną kopię. Tablice współdzielone
+ * z innymi wielomianami są liczone w całości. Pole allocations zawiera liczbę
+ * tablic, a pola szczytowe są zerowe.
+ * @param[in] s : stos @f$s@f$ o więcej niż @p depth elementach
+ * @param[in] depth : głębokość liczona od szczytu stosu @f$depth@f$
+ * @return liczniki pamięci elementu
+ */
+MemoryStats PolyStackEntryMemory(const PolyStack *s, size_t depth);
+
 #endif //POPRAWKA_DUZE_ZADANIE_DATA_STRUCTURES_H
@@ -5,13 +5,22 @@
   @copyright Uniwersytet Warszawski
   @date 2021
 */
+#define _DEFAULT_SOURCE
+
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "input-output.h"
 #include "poly.h"
 #include "data_structures.h"
+#include "lexer.h"
 
 /** To jest makrodefinicja reprezentująca znak końca linii. */
 #define ENDLINE '\n'
@@ -47,6 +56,37 @@
 /** To jest makrodefinicja reprezentująca znak na pewno niebędący
  * poprawnym znakiem w wielomianie. */
 #define NOTPOLYCHAR '&'
+/** To jest makrodefinicja reprezentująca rozmiar bloku wczytywanego przez
+ * czytnik linii w bajtach. */
+#define LINE_READER_BLOCK (1 << 20)
+/** To jest makrodefinicja reprezentująca maskę najstarszych bitów wszystkich
+ * bajtów słowa 64-bitowego. */
+#define HIGH_BITS 0x8080808080808080ULL
+/** To jest makrodefinicja reprezentująca największą długość zapisu
+ * dziesiętnego liczby typu long wraz ze znakiem minus. */
+#define LONG_DECIMAL_LENGTH 20
+/** To jest makrodefinicja reprezentująca największą głębokość zagnieżdżenia
+ * jednomianów we wczytywanym wielomianie. Głębsze wielomiany są uznawane za
+ * niepoprawne, zanim rekurencja wyczerpie stos. */
+#define MAX_PARSE_DEPTH 1000
+
+/** To jest zmienna przechowująca czytnik wejścia kalkulatora: standardowego
+ * wejścia albo pliku skryptu. */
+static LineReader inputReader = {.fd = STDIN_FILENO, .buffer = NULL,
+        .capacity = 0, .begin = 0, .end = 0, .eof = false, .mapped = false};
+
+/** To jest zmienna przechowująca zapisy dziesiętne liczb 00 - 99, kolejno po
+ * dwa znaki. */
+static const char digitPairs[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+/** To jest zmienna przechowująca ujście standardowego wyjścia, tworzone przy
+ * pierwszym wypisaniu. */
+static OutputSink stdoutSink = {.stream = NULL, .fd = -1, .length = 0};
 
 /**
  * Sprawdza, czy podany znak jest jednym ze znaków '0' - '9' lub minusem.
@@ -66,133 +106,443 @@ bool charIsDec(char c) {
     return (c >= ZEROCHAR && c <= NINECHAR);
 }
 
-bool IsNextLine() {
-    int nextChar = getchar();
+LineReader LineReaderInit(int fd) {
+    return (LineReader) {.fd = fd, .buffer = NULL, .capacity = 0, .begin = 0,
+            .end = 0, .eof = false, .mapped = false};
+}
+
+LineReader LineReaderMap(int fd) {
+    LineReader reader = LineReaderInit(fd);
+    struct stat status;
+
+    if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) ||
+        status.st_size <= 0 || (uintmax_t) status.st_size > SIZE_MAX) {
+
+        return reader;
+    }
+
+    size_t size = (size_t) status.st_size;
+    char *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                        0);
+
+    if (buffer == MAP_FAILED) {
+
+        return reader;
+    }
+
+    madvise(buffer, size, MADV_SEQUENTIAL);
+    reader.buffer = buffer;
+    reader.capacity = size;
+    reader.end = size;
+    reader.eof = true;
+    reader.mapped = true;
+
+    return reader;
+}
+
+/**
+ * Usuwa odwzorowanie pliku z pamięci. Nieprzeczytaną końcówkę pliku, która
+ * nie kończy się znakiem końca linii, przenosi do bufora na stercie, by
+ * zmieścił się za nią kończący znak '\0'.
+ * @param[in] reader : czytnik linii @f$reader@f$
+ */
+void LineReaderUnmap(LineReader *reader) {
+    size_t length = reader->end - reader->begin;
+    char *buffer = NULL;
+
+    if (length > 0) {
+        buffer = secureMalloc(length + 1);
+        memcpy(buffer, reader->buffer + reader->begin, length);
+    }
+
+    munmap(reader->buffer, reader->capacity);
+    reader->buffer = buffer;
+    reader->capacity = buffer == NULL ? 0 : length + 1;
+    reader->begin = 0;
+    reader->end = length;
+    reader->mapped = false;
+}
+
+/**
+ * Dowczytuje blok danych do bufora czytnika. Przed wczytaniem przenosi
+ * nieprzeczytane dane na początek bufora, a gdy bufor jest pełny, podwaja
+ * go. W buforze zawsze zostaje miejsce na kończący znak '\0'. Odwzorowany
+ * plik nie ma nowych danych, więc jest wtedy tylko usuwany z pamięci.
+ * @param[in] reader : czytnik linii @f$reader@f$
+ * @return czy wczytano nowe dane
+ */
+bool LineReaderFill(LineReader *reader) {
+    if (reader->mapped) {
+        LineReaderUnmap(reader);
 
-    if (nextChar == EOF) {
         return false;
+    }
 
-    } else {
-        ungetc(nextChar, stdin);
+    if (reader->eof) {
 
-        return true;
+        return false;
+    }
+
+    if (reader->begin > 0) {
+        memmove(reader->buffer, reader->buffer + reader->begin,
+                reader->end - reader->begin);
+        reader->end -= reader->begin;
+        reader->begin = 0;
+    }
+
+    if (reader->end + 1 >= reader->capacity) {
+        size_t capacity = reader->capacity == 0 ? LINE_READER_BLOCK :
+                reader->capacity * 2;
+        char *buffer = secureMalloc(capacity);
+
+        if (reader->buffer != NULL) {
+            memcpy(buffer, reader->buffer, reader->end);
+            free(reader->buffer);
+        }
+
+        reader->buffer = buffer;
+        reader->capacity = capacity;
+    }
+
+    ssize_t count;
+
+    do {
+        count = read(reader->fd, reader->buffer + reader->end,
+                     reader->capacity - reader->end - 1);
+    } while (count < 0 && errno == EINTR);
+
+    if (count <= 0) {
+        reader->eof = true;
+
+        return false;
     }
+
+    reader->end += (size_t) count;
+
+    return true;
+}
+
+bool LineReaderHasNext(LineReader *reader) {
+    return reader->begin < reader->end || LineReaderFill(reader);
 }
 
 /**
- * Wpisuje znak na koniec ciagu znaków.
- * @param[in] line : linia @f$line@f$
- * @param[in] allocatedLength : zaalokowana długość tablicy
- * @f$allocatedLength@f$
- * @param[in] lineLength : długość linii @f$lineLength@f$
- * @param[in] nextChar : znak @f$nextChar@f$
+ * Zastępuje znaki spoza zakresu typu char znakiem NOTPOLYCHAR. Ciąg jest
+ * najpierw sprawdzany słowami 64-bitowymi i przepisywany tylko wtedy, gdy
+ * zawiera bajt z ustawionym najstarszym bitem.
+ * @param[in,out] string : ciąg znaków @f$string@f$
+ * @param[in] length : długość ciągu znaków @f$length@f$
  */
-void writeCharToString(char **line, size_t *allocatedLength, size_t
-*lineLength, char nextChar) {
-    if (*line == NULL) {
-        (*line) = secureMalloc(STARTING_ARRA_YSIZE * sizeof(char));
-        *allocatedLength = STARTING_ARRA_YSIZE;
+void LineSanitize(char *string, size_t length) {
+    uint64_t bits = 0;
+    size_t i = 0;
+
+    for (; i + sizeof(bits) <= length; i += sizeof(bits)) {
+        uint64_t word;
+        memcpy(&word, string + i, sizeof(word));
+        bits |= word;
+    }
+
+    for (; i < length; i++) {
+        bits |= (unsigned char) string[i];
     }
 
-    if (*lineLength == *allocatedLength) {
-        *allocatedLength = *allocatedLength * 2;
-        char *tmp = secureMalloc(*allocatedLength * sizeof(char));
+    if ((bits & HIGH_BITS) == 0) {
 
-        for (size_t i = 0; i < *lineLength; i++) {
-            tmp[i] = (*line)[i];
+        return;
+    }
+
+    for (i = 0; i < length; i++) {
+        if ((unsigned char) string[i] > CHAR_MAX) {
+            string[i] = NOTPOLYCHAR;
         }
+    }
+}
+
+Line LineReaderRead(LineReader *reader) {
+    size_t scanned = 0;
+    char *newline = NULL;
+
+    while (newline == NULL) {
+        newline = reader->buffer == NULL ? NULL :
+                memchr(reader->buffer + reader->begin + scanned, ENDLINE,
+                       reader->end - reader->begin - scanned);
+        scanned = reader->end - reader->begin;
+
+        if (newline == NULL && !LineReaderFill(reader)) {
+            break;
+        }
+    }
+
+    if (reader->buffer == NULL) {
+
+        return (Line) {.string = "", .lineLength = 0};
+    }
+
+    char *string = reader->buffer + reader->begin;
+    size_t length = newline == NULL ? reader->end - reader->begin :
+            (size_t) (newline - string);
+    if (!reader->mapped) {
+        string[length] = NULL_CHARACTER; // odwzorowanego pliku nie zmieniamy
+    }
+
+    reader->begin += newline == NULL ? length : length + 1;
+    LineSanitize(string, length);
 
-        free(*line);
-        *line = tmp;
+    return (Line) {.string = string, .lineLength = length};
+}
+
+void LineReaderDestroy(LineReader *reader) {
+    if (reader->mapped) {
+        munmap(reader->buffer, reader->capacity);
+    } else {
+        free(reader->buffer);
     }
 
-    (*line)[*lineLength] = nextChar;
-    (*lineLength)++;
+    *reader = LineReaderInit(reader->fd);
+}
+
+bool IsNextLine() {
+    return LineReaderHasNext(&inputReader);
 }
 
 Line LineRead() {
-    char *string = NULL;
-    size_t allocatedLength = 0;
-    size_t lineLength = 0;
-    int nextChar = getchar();
-
-    while (nextChar != EOF && nextChar != ENDLINE) {
-        if (nextChar > CHAR_MAX) {
-            nextChar = NOTPOLYCHAR;
+    return LineReaderRead(&inputReader);
+}
+
+void LineDestroy(Line line) {
+    (void) line;
+}
+
+bool LineReadScript(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+
+        return false;
+    }
+
+    LineReadFinish();
+    inputReader = LineReaderMap(fd);
+
+    return true;
+}
+
+void LineReadFinish(void) {
+    int fd = inputReader.fd;
+    LineReaderDestroy(&inputReader);
+
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+}
+
+void OutputSinkInitStream(OutputSink *sink, FILE *stream) {
+    sink->stream = stream;
+    sink->fd = -1;
+    sink->length = 0;
+}
+
+void OutputSinkInitFd(OutputSink *sink, int fd) {
+    sink->stream = NULL;
+    sink->fd = fd;
+    sink->length = 0;
+}
+
+void OutputSinkFlush(OutputSink *sink) {
+    if (sink->stream != NULL) {
+        fwrite(sink->buffer, 1, sink->length, sink->stream);
+    } else {
+        size_t written = 0;
+
+        while (written < sink->length) {
+            ssize_t count = write(sink->fd, sink->buffer + written,
+                                  sink->length - written);
+
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (count <= 0) {
+                break; // tak jak printf, pomijamy błędy zapisu
+            }
+
+            written += (size_t) count;
         }
-        writeCharToString(&string, &allocatedLength, &lineLength, (char)
-        nextChar);
-        nextChar = getchar();
     }
 
-    writeCharToString(&string, &allocatedLength, &lineLength, '\0');
-    lineLength--;
+    sink->length = 0;
+}
 
-    return (Line) {.string = string, .lineLength = lineLength};
+/**
+ * Zapewnia w buforze ujścia miejsce na podaną liczbę znaków, w razie
+ * potrzeby opróżniając bufor.
+ * @param[in] sink : ujście @f$sink@f$
+ * @param[in] size : liczba znaków @f$size@f$
+ */
+void OutputSinkReserve(OutputSink *sink, size_t size) {
+    if (sink->length + size > OUTPUT_SINK_BUFFER) {
+        OutputSinkFlush(sink);
+    }
 }
 
-void LineDestroy(Line line) {
-    free(line.string);
+/**
+ * Dopisuje znak do ujścia.
+ * @param[in] sink : ujście @f$sink@f$
+ * @param[in] c : znak @f$c@f$
+ */
+void OutputSinkPutChar(OutputSink *sink, char c) {
+    OutputSinkReserve(sink, 1);
+    sink->buffer[sink->length++] = c;
 }
 
 /**
- * Wypisuje wielomian na wyjście bez kończenia linii.
+ * Dopisuje do ujścia liczbę w zapisie dziesiętnym, tak jak printf("%ld").
+ * Cyfry są wyznaczane od końca parami, z tablicy digitPairs.
+ * @param[in] sink : ujście @f$sink@f$
+ * @param[in] value : liczba @f$value@f$
+ */
+void OutputSinkPutLong(OutputSink *sink, long value) {
+    char digits[LONG_DECIMAL_LENGTH];
+    char *start = digits + LONG_DECIMAL_LENGTH;
+    unsigned long magnitude = value < 0 ? 0 - (unsigned long) value :
+            (unsigned long) value;
+
+    while (magnitude >= 100) {
+        start -= 2;
+        memcpy(start, &digitPairs[2 * (magnitude % 100)], 2);
+        magnitude /= 100;
+    }
+
+    if (magnitude >= 10) {
+        start -= 2;
+        memcpy(start, &digitPairs[2 * magnitude], 2);
+    } else {
+        *--start = (char) (ZEROCHAR + magnitude);
+    }
+
+    if (value < 0) {
+        *--start = MINUS;
+    }
+
+    size_t length = (size_t) (digits + LONG_DECIMAL_LENGTH - start);
+    OutputSinkReserve(sink, length);
+    memcpy(sink->buffer + sink->length, start, length);
+    sink->length += length;
+}
+
+/**
+ * Zapisuje wielomian do ujścia bez kończenia linii.
+ * @param[in] sink : ujście @f$sink@f$
  * @param[in] p : wielomian @f$p@f$
  */
-void PolyPrintH(const Poly *p);
+void PolyWriteH(OutputSink *sink, const Poly *p);
 
 /**
- * Wypisuje jednomian na wyjście bez kończenia linii.
+ * Zapisuje jednomian do ujścia bez kończenia linii.
+ * @param[in] sink : ujście @f$sink@f$
  * @param[in] m : jednomian @f$m@f$
  */
-void MonoPrint(const Mono *m) {
-    printf("(");
-    PolyPrintH(&m->p);
-    printf(",");
-    printf("%d", m->exp);
-    printf(")");
+void MonoWrite(OutputSink *sink, const Mono *m) {
+    OutputSinkPutChar(sink, OPEN_BRACKET);
+    PolyWriteH(sink, &m->p);
+    OutputSinkPutChar(sink, COLON);
+    OutputSinkPutLong(sink, m->exp);
+    OutputSinkPutChar(sink, CLOSE_BRACKET);
 }
 
-void PolyPrintH(const Poly *p) {
+void PolyWriteH(OutputSink *sink, const Poly *p) {
     if (PolyIsCoeff(p)) {
-        printf("%ld", p->coeff);
+        OutputSinkPutLong(sink, PolyGetCoeff(p));
     } else {
-        for (size_t i = 0; i < p->size; i++) {
-            MonoPrint(&p->arr[i]);
-            if (i < p->size - 1) {
-                printf("+");
+        Mono single;
+        const Mono *arr = PolyMonos(p, &single);
+        size_t size = PolyMonoCount(p);
+
+        for (size_t i = 0; i < size; i++) {
+            MonoWrite(sink, &arr[i]);
+            if (i < size - 1) {
+                OutputSinkPutChar(sink, PLUS);
             }
         }
     }
 }
 
+void PolyWrite(OutputSink *sink, const Poly *p) {
+    PolyWriteH(sink, p);
+    OutputSinkPutChar(sink, ENDLINE);
+}
+
+/**
+ * Zapisuje poddrzewo spakowanego wielomianu do ujścia bez kończenia linii.
+ * @param[in] sink : ujście @f$sink@f$
+ * @param[in] nodes : tablica węzłów
+ * @param[in] i : indeks korzenia poddrzewa
+ */
+void PackedNodeWrite(OutputSink *sink, const PackedNode *nodes, size_t i) {
+    if (nodes[i].isCoeff) {
+        OutputSinkPutLong(sink, nodes[i].coeff);
+    } else {
+        size_t child = i + 1;
+
+        for (size_t k = 0; k < nodes[i].size; k++) {
+            OutputSinkPutChar(sink, OPEN_BRACKET);
+            PackedNodeWrite(sink, nodes, child);
+            OutputSinkPutChar(sink, COLON);
+            OutputSinkPutLong(sink, nodes[child].exp);
+            OutputSinkPutChar(sink, CLOSE_BRACKET);
+            if (k < nodes[i].size - 1) {
+                OutputSinkPutChar(sink, PLUS);
+            }
+
+            child += nodes[child].length;
+        }
+    }
+}
+
+void PackedPolyWrite(OutputSink *sink, const PackedPoly *packed) {
+    PackedNodeWrite(sink, packed->nodes, 0);
+    OutputSinkPutChar(sink, ENDLINE);
+}
+
+/**
+ * Zwraca ujście standardowego wyjścia, przy pierwszym użyciu je tworząc.
+ * @return ujście standardowego wyjścia
+ */
+OutputSink *StdoutSink(void) {
+    if (stdoutSink.stream == NULL) {
+        OutputSinkInitStream(&stdoutSink, stdout);
+    }
+
+    return &stdoutSink;
+}
+
 void PolyPrint(const Poly *p) {
-    PolyPrintH(p);
-    printf("\n");
+    PolyWrite(StdoutSink(), p);
+    OutputSinkFlush(StdoutSink()); // zachowuje kolejność z wywołaniami printf
+}
+
+void PackedPolyPrint(const PackedPoly *packed) {
+    PackedPolyWrite(StdoutSink(), packed);
+    OutputSinkFlush(StdoutSink());
 }
 
 /**
- * Przedłuża tablicę jednomianów.
+ * Przedłuża dwukrotnie tablicę jednomianów funkcją realloc, która dużych
+ * tablic zwykle nie kopiuje.
  * @param[in] arr : tablica jednomianów @f$arr@f$
  * @param[in] arraySize : długość tablicy jednomianów @f$arraySize@f$
  */
 void ExtendArray(Mono **arr, size_t *arraySize) {
-    Mono *newArr;
-    if (*arraySize == 0) {
-        newArr = secureMalloc(STARTING_ARRA_YSIZE * sizeof(Mono));
-        *arraySize = STARTING_ARRA_YSIZE;
-    } else {
-        newArr = secureMalloc((*arraySize) * 2 * sizeof(Mono));
-
-        for (size_t i = 0; i < (*arraySize); i++) {
-            newArr[i] = (*arr)[i];
-        }
+    size_t newSize = *arraySize == 0 ? STARTING_ARRA_YSIZE : *arraySize * 2;
+    Mono *newArr = realloc(*arr, newSize * sizeof(Mono));
 
-        (*arraySize) = (*arraySize) * 2;
-        free(*arr);
+    if (newArr == NULL) {
+        exit(1);
     }
 
     (*arr) = newArr;
+    (*arraySize) = newSize;
 }
 
 /**
@@ -214,254 +564,218 @@ void WriteMonoToArray(const Mono *m, size_t *i, Mono **arr,
 
 poly_coeff_t ReadValueCoeff(Line line, size_t *index, bool *isEmpty, bool
 *nonDecimalChars) {
-    size_t firstIndex = *index;
-    char *end;
-    errno = 0;
-    poly_coeff_t value = strtol(&line.string[*index], &end, 10);
-    if ((value == LONG_MAX || value == LONG_MIN) && errno == ERANGE)
-    {
+    LexedNumber number = LexNumber(&line.string[*index],
+                                   line.lineLength - *index);
+    bool overflow;
+    poly_coeff_t value = LexedToLong(number, &overflow);
+
+    if (overflow) {
         *nonDecimalChars = true;
     }
 
-    for (size_t i = *index; i <= line.lineLength; i++) { // jest to
-        // bezpieczne bo na koniec każdej linii dopisuję '\0' w LineRead
-        if (&(line.string[i]) == end) {
-            if (*index == i) {
-                (*isEmpty) = true;
-            }
-            (*index) = i;
-        }
+    if (number.length == 0) {
+        (*isEmpty) = true;
     }
 
-    for (size_t i = firstIndex; i < *index; i++) {
+    for (size_t i = *index; i < *index + number.prefix; i++) {
         if (!charIsDecOrMinus(line.string[i])) {
             *nonDecimalChars = true;
         }
     }
 
+    (*index) += number.length;
+
     return value;
 }
 
 size_t ReadValueSizeT(Line line, size_t *index, bool *isEmpty, bool
 *nonDecimalChars) {
-    size_t firstIndex = *index;
-    char *end;
-    errno = 0;
-    size_t value = strtoul(&line.string[*index], &end, 10);
-    if ((value == ULONG_MAX) && errno == ERANGE)
-    {
+    LexedNumber number = LexNumber(&line.string[*index],
+                                   line.lineLength - *index);
+    bool overflow;
+    size_t value = LexedToUnsignedLong(number, &overflow);
+
+    if (overflow) {
         (*nonDecimalChars) = true;
     }
 
-    for (size_t i = *index; i <= line.lineLength; i++) { // jest to
-        // bezpieczne bo na koniec każdej linii dopisuję '\0' w LineRead
-        if (&(line.string[i]) == end) {
-            if (*index == i) {
-                (*isEmpty) = true;
-            }
-            (*index) = i;
-        }
+    if (number.length == 0) {
+        (*isEmpty) = true;
     }
 
-    for (size_t i = firstIndex; i < *index; i++) {
+    for (size_t i = *index; i < *index + number.prefix; i++) {
         if (!charIsDec(line.string[i])) {
             *nonDecimalChars = true;
         }
     }
 
+    (*index) += number.length;
+
     return value;
 }
 
 /**
- * Wczytuje wielomian z wejścia.
+ * Sprawdza, czy w linii pod podanym indeksem znajduje się podany znak.
  * @param[in] line : linia @f$line@f$
- * @param[in] index : indeks początku wczytywania danych z linii @f$index@f$
- * @return Wielomian zawarty w podanej linii.
+ * @param[in] index : indeks @f$index@f$
+ * @param[in] c : znak @f$c@f$
+ * @return Czy w linii pod indeksem @p index znajduje się znak @p c?
  */
-Poly PolyReadH(Line line, size_t *index);
+bool LineCharIs(Line line, size_t index, char c) {
+    return index < line.lineLength && line.string[index] == c;
+}
 
 /**
- * Wczytuje jednomian z wejścia.
+ * Wczytuje liczbę postaci [-]cyfry, która mieści się w typie poly_coeff_t.
  * @param[in] line : linia @f$line@f$
- * @param[in] index : indeks początku wczytywania danych z linii @f$index@f$
- * @return jednomian zawarty w podanej linii.
+ * @param[in,out] index : indeks początku liczby, a po wczytaniu indeks
+ * pierwszego znaku za nią @f$index@f$
+ * @param[out] value : wczytana liczba @f$value@f$
+ * @return Czy wczytano poprawną liczbę?
  */
-Mono MonoRead(Line line,  size_t *index) {
-    Poly p = PolyReadH(line, index);
-    (*index)++;
-    bool isEmpty = false;
-    bool nonDecChars = false;
-    poly_exp_t exp = (int) ReadValueCoeff(line, index, &isEmpty, &nonDecChars);
-    (*index)++;
-
-    return (Mono) {.p = p, .exp = exp};
+bool ParseCoeff(Line line, size_t *index, poly_coeff_t *value) {
+    LexedNumber number = LexNumber(&line.string[*index],
+                                   line.lineLength - *index);
+    bool overflow;
+    *value = LexedToLong(number, &overflow);
+    *index += number.length;
+
+    return number.length > 0 && !overflow &&
+           number.prefix == (number.negative ? 1 : 0);
 }
 
-Poly PolyReadH(Line line, size_t *index) {
-    Mono *arr = NULL;
-    size_t arraySize = 0;
-    size_t arrayIndex = 0;
-
-    while (*index < line.lineLength && line.string[*index] !=
-    COLON) {
-        if (line.string[*index] == OPEN_BRACKET) {
-            (*index)++;
-            Mono nextMono = MonoRead(line, index);
-            if (!MonoIsZero(&nextMono)) {
-                WriteMonoToArray(&nextMono, &arrayIndex, &arr, &arraySize);
-            }
-        } else if (line.string[*index] == PLUS){
-            (*index)++;
-        } else {
-            bool isEmpty = false;
-            bool nonDecChars = false;
-            return PolyFromCoeff(
-                    ReadValueCoeff(line, index, &isEmpty, &nonDecChars));
-        }
-    }
-
-    if (arraySize == 0) {
-
-        return PolyZero();
+/**
+ * Usuwa z pamięci jednomiany wczytane przed napotkaniem błędu.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ * @param[in] count : liczba jednomianów @f$count@f$
+ */
+void ParseAbandon(Mono *arr, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        MonoDestroy(&arr[i]);
     }
 
-    Poly result = PolyAddMonos(arrayIndex, arr);
     free(arr);
-
-    return result;
-}
-
-Poly PolyRead(Line line) {
-    size_t index = 0;
-
-    return PolyReadH(line, &index);
 }
 
 /**
- * Sprawdza, czy część linii jest prawidłowym jednomianem.
+ * Wczytuje wielomian zaczynający się pod podanym indeksem linii. Wielomian
+ * jest współczynnikiem albo niepustą sumą jednomianów połączonych znakiem
+ * '+'. Każdy znak linii jest czytany co najwyżej raz.
  * @param[in] line : linia @f$line@f$
- * @param[in] index : indeks początkowy @f$index@f$
- * @param[in] endIndex : indeks końcowy @f$endIndex@f$
- * @return Czy część linii jest prawidłowym jednomianem?
+ * @param[in,out] index : indeks początku wielomianu, a po wczytaniu indeks
+ * pierwszego znaku za nim @f$index@f$
+ * @param[in] depth : liczba jednomianów, w których zagnieżdżony jest
+ * wielomian @f$depth@f$
+ * @param[out] p : wczytany wielomian, ustawiany tylko w razie powodzenia
+ * @return Czy wczytano poprawny wielomian?
  */
-bool MonoIsCorrect(Line line, size_t *index, size_t endIndex);
+bool ParsePoly(Line line, size_t *index, size_t depth, Poly *p);
 
 /**
- * Sprawdza, czy część linii jest prawidłowym wielomianem.
+ * Wczytuje jednomian postaci (p,e) zaczynający się pod podanym indeksem
+ * linii, gdzie wykładnik e należy do przedziału @f$[0, INT\_MAX]@f$.
  * @param[in] line : linia @f$line@f$
- * @param[in] index : indeks początkowy @f$index@f$
- * @param[in] endIndex : indeks końcowy @f$endIndex@f$
- * @return Czy część linii jest prawidłowym wielomianem?
+ * @param[in,out] index : indeks znaku '(', a po wczytaniu indeks pierwszego
+ * znaku za jednomianem @f$index@f$
+ * @param[in] depth : głębokość zagnieżdżenia jednomianu @f$depth@f$
+ * @param[out] m : wczytany jednomian, ustawiany tylko w razie powodzenia
+ * @return Czy wczytano poprawny jednomian?
  */
-bool PolyIsCorrectH(Line line, size_t *index, size_t endIndex) {
-    if (*index >= endIndex) {
+bool ParseMono(Line line, size_t *index, size_t depth, Mono *m) {
+    Poly p;
+    poly_coeff_t exp;
+    (*index)++;
+
+    if (depth >= MAX_PARSE_DEPTH || !ParsePoly(line, index, depth + 1, &p)) {
 
         return false;
     }
-    bool atLeastOneMono = false;
 
-    while (*index < endIndex) {
-        if (line.string[*index] == OPEN_BRACKET) {
-            (*index)++;
+    if (!LineCharIs(line, *index, COLON)) {
+        PolyDestroy(&p);
 
-            if (!MonoIsCorrect(line, index, endIndex)) {
-
-                return false;
-            }
+        return false;
+    }
 
-            atLeastOneMono = true;
-        } else if (line.string[*index] == PLUS) {
-            if (!atLeastOneMono) {
+    (*index)++;
 
-                return false;
-            }
+    if (!ParseCoeff(line, index, &exp) || exp < 0 || exp > INT_MAX ||
+        !LineCharIs(line, *index, CLOSE_BRACKET)) {
+        PolyDestroy(&p);
 
-            (*index)++;
+        return false;
+    }
 
-            if (*index >= endIndex || line.string[*index] != OPEN_BRACKET) {
+    (*index)++;
+    *m = (Mono) {.p = p, .exp = (poly_exp_t) exp};
 
-                return false;
-            }
+    return true;
+}
 
-            (*index)++;
+bool ParsePoly(Line line, size_t *index, size_t depth, Poly *p) {
+    if (!LineCharIs(line, *index, OPEN_BRACKET)) {
+        poly_coeff_t coeff;
 
-            if (!MonoIsCorrect(line, index, endIndex)) {
+        if (!ParseCoeff(line, index, &coeff)) {
 
-                return false;
-            }
-        } else {
-            bool isEmpty = false;
-            bool nonDecChars = false;
-            ReadValueCoeff(line, index, &isEmpty, &nonDecChars);
+            return false;
+        }
 
-            if (isEmpty || nonDecChars) {
+        *p = PolyFromCoeff(coeff);
 
-                return false;
-            }
-        }
+        return true;
     }
 
-    return true;
-}
+    Mono *arr = NULL;
+    size_t arraySize = 0;
+    size_t arrayIndex = 0;
 
-bool MonoIsCorrect(Line line, size_t *index, size_t endIndex) {
-    if (*index >= endIndex) {
-        return false;
-    }
+    while (true) {
+        Mono m;
 
-    size_t hIndex = *index;
-    size_t newEndIndex = *index;
-    bool endLoop = false;
-    size_t nOfOpeningBraces = 1;
-    size_t nOfClosingBraces = 0;
-    while (!endLoop && hIndex < endIndex) {
-        if (line.string[hIndex] == COLON) {
-            newEndIndex = hIndex;
-        } else if (line.string[hIndex] == OPEN_BRACKET) {
-            nOfOpeningBraces++;
-        } else if (line.string[hIndex] == CLOSE_BRACKET) {
-            nOfClosingBraces++;
-            if (nOfOpeningBraces != nOfClosingBraces) {
-                newEndIndex = *index;
-            }
-        } else if (line.string[hIndex] == PLUS && nOfOpeningBraces ==
-        nOfClosingBraces) {
-            endLoop = true;
+        if (!LineCharIs(line, *index, OPEN_BRACKET) ||
+            !ParseMono(line, index, depth, &m)) {
+            ParseAbandon(arr, arrayIndex);
+
+            return false;
         }
-        hIndex++;
-    }
 
-    if (!PolyIsCorrectH(line, index, newEndIndex) || *index >= endIndex) {
-        return false;
-    }
+        if (MonoIsZero(&m)) {
+            MonoDestroy(&m);
+        } else {
+            WriteMonoToArray(&m, &arrayIndex, &arr, &arraySize);
+        }
 
-    (*index)++;
+        if (!LineCharIs(line, *index, PLUS)) {
+            break;
+        }
 
-    if (*index >= endIndex) {
-        return false;
+        (*index)++;
     }
 
-    bool isEmpty = false;
-    bool nonDecChars = false;
-    poly_coeff_t exp = ReadValueCoeff(line, index, &isEmpty, &nonDecChars);
+    *p = PolyOwnMonos(arrayIndex, arr);
+
+    return true;
+}
+
+bool PolyParse(Line line, Poly *p) {
+    size_t index = 0;
+    Poly result;
+
+    if (!ParsePoly(line, &index, 0, &result)) {
 
-    if (isEmpty || nonDecChars || exp < 0 || exp > INT_MAX || *index >=
-    endIndex) {
         return false;
     }
 
-    if (line.string[*index] != CLOSE_BRACKET) {
+    if (index != line.lineLength) {
+        PolyDestroy(&result);
+
         return false;
     }
-    (*index)++;
 
-    return true;
-}
+    *p = result;
 
-bool PolyIsCorrect(Line line) {
-    size_t index = 0;
-
-    return PolyIsCorrectH(line, &index, line.lineLength);
+    return true;
 }
 
 bool ShouldIgnoreLine(Line line) {
@@ -506,11 +820,37 @@ bool LineIsValidCommand(Line line) {
         return true;
     }
 
+    if (size >= 4 && LineBeginsWith(line, EVAL)) {
+
+        return true;
+    }
+
+    if (size >= 3 && LineBeginsWith(line, POW)) {
+
+        return true;
+    }
+
+    if (size >= 5 && (LineBeginsWith(line, SCALE) ||
+                      LineBeginsWith(line, SHIFT))) {
+
+        return true;
+    }
+
     if (size >= 7 && LineBeginsWith(line, COMPOSE)) {
 
         return true;
     }
 
+    if (size >= 13 && LineBeginsWith(line, NTT_THRESHOLD)) {
+
+        return true;
+    }
+
+    if (size >= 7 && LineBeginsWith(line, THREADS)) {
+
+        return true;
+    }
+
     if (size == 3) {
         if (LineBeginsWith(line, ADD) || LineBeginsWith(line, MUL) ||
         LineBeginsWith(line, NEG) || LineBeginsWith(line, SUB) ||
@@ -522,7 +862,7 @@ bool LineIsValidCommand(Line line) {
             return false;
         }
     } else if (size == 4) {
-        if (LineBeginsWith(line, ZERO)) {
+        if (LineBeginsWith(line, ZERO) || LineBeginsWith(line, PACK)) {
 
             return true;
         } else {
@@ -539,7 +879,7 @@ bool LineIsValidCommand(Line line) {
             return false;
         }
     } else if (size == 7) {
-        if (LineBeginsWith(line, IS_ZERO)) {
+        if (LineBeginsWith(line, IS_ZERO) || LineBeginsWith(line, MEMSTAT)) {
 
             return true;
         } else {
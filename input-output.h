@@ -7,8 +7,10 @@
   @copyright Uniwersytet Warszawski
   @date 2021
 */
+#include <stdio.h>
 #include <stdlib.h>
 #include "poly.h"
+#include "packed_poly.h"
 /** To jest makrodefinicja reprezentująca ciąg znaków "ZERO". */
 #define ZERO "ZERO"
 /** To jest makrodefinicja reprezentująca ciąg znaków "IS_COEFF". */
@@ -31,14 +33,32 @@
 #define DEG "DEG"
 /** To jest makrodefinicja reprezentująca ciąg znaków "DEG_BY". */
 #define DEG_BY "DEG_BY"
+/** To jest makrodefinicja reprezentująca ciąg znaków "AT_MANY". */
+#define AT_MANY "AT_MANY"
 /** To jest makrodefinicja reprezentująca ciąg znaków "AT". */
 #define AT "AT"
 /** To jest makrodefinicja reprezentująca ciąg znaków "PRINT". */
 #define PRINT "PRINT"
 /** To jest makrodefinicja reprezentująca ciąg znaków "POP". */
 #define POP "POP"
+/** To jest makrodefinicja reprezentująca ciąg znaków "PACK". */
+#define PACK "PACK"
+/** To jest makrodefinicja reprezentująca ciąg znaków "MEMSTAT". */
+#define MEMSTAT "MEMSTAT"
+/** To jest makrodefinicja reprezentująca ciąg znaków "EVAL". */
+#define EVAL "EVAL"
+/** To jest makrodefinicja reprezentująca ciąg znaków "POW". */
+#define POW "POW"
+/** To jest makrodefinicja reprezentująca ciąg znaków "SCALE". */
+#define SCALE "SCALE"
+/** To jest makrodefinicja reprezentująca ciąg znaków "SHIFT". */
+#define SHIFT "SHIFT"
 /** To jest makrodefinicja reprezentująca ciąg znaków "COMPOSE". */
 #define COMPOSE "COMPOSE"
+/** To jest makrodefinicja reprezentująca ciąg znaków "NTT_THRESHOLD". */
+#define NTT_THRESHOLD "NTT_THRESHOLD"
+/** To jest makrodefinicja reprezentująca ciąg znaków "THREADS". */
+#define THREADS "THREADS"
 
 /**
  * To jest struktura przechowująca linię.
@@ -49,6 +69,77 @@ typedef struct Line {
     size_t lineLength; ///< długość linii
 } Line;
 
+/** To jest makrodefinicja reprezentująca rozmiar bufora ujścia w bajtach. */
+#define OUTPUT_SINK_BUFFER (1 << 16)
+
+/**
+ * To jest struktura przechowująca ujście wypisywanego tekstu. Znaki są
+ * zbierane we wbudowanym buforze i przekazywane dalej dużymi porcjami: do
+ * strumienia funkcją fwrite albo do deskryptora pliku funkcją write.
+ */
+typedef struct OutputSink {
+    FILE *stream; ///< strumień albo NULL, gdy ujściem jest deskryptor
+    int fd; ///< deskryptor pliku, używany gdy @p stream jest równy NULL
+    size_t length; ///< liczba znaków w buforze
+    char buffer[OUTPUT_SINK_BUFFER]; ///< bufor
+} OutputSink;
+
+/**
+ * To jest struktura przechowująca czytnik linii. Czytnik wczytuje dane
+ * z deskryptora pliku dużymi blokami funkcją read albo odwzorowuje cały plik
+ * w pamięci funkcją mmap i zwraca linie będące widokami swojego bufora.
+ */
+typedef struct LineReader {
+    int fd; ///< deskryptor czytanego pliku
+    char *buffer; ///< bufor wczytanych danych
+    size_t capacity; ///< rozmiar bufora
+    size_t begin; ///< indeks początku nieprzeczytanych danych
+    size_t end; ///< indeks końca wczytanych danych
+    bool eof; ///< czy osiągnięto koniec pliku
+    bool mapped; ///< czy bufor jest odwzorowanym w pamięci plikiem
+} LineReader;
+
+/**
+ * Tworzy czytnik linii z deskryptora pliku.
+ * @param[in] fd : deskryptor pliku otwartego do czytania @f$fd@f$
+ * @return czytnik linii
+ */
+LineReader LineReaderInit(int fd);
+
+/**
+ * Tworzy czytnik linii zwykłego pliku odwzorowanego w całości w pamięci
+ * z radą MADV_SEQUENTIAL. Linie są widokami odwzorowania kończącymi się
+ * znakiem końca linii zamiast '\0', więc czytanie nie kopiuje stron pliku.
+ * Gdy pliku nie da się odwzorować, zwraca czytnik z LineReaderInit.
+ * @param[in] fd : deskryptor pliku otwartego do czytania @f$fd@f$
+ * @return czytnik linii
+ */
+LineReader LineReaderMap(int fd);
+
+/**
+ * Sprawdza, czy czytnik ma kolejną linię.
+ * @param[in] reader : czytnik linii @f$reader@f$
+ * @return czy istnieje kolejna linia
+ */
+bool LineReaderHasNext(LineReader *reader);
+
+/**
+ * Wczytuje kolejną linię bez kopiowania jej. Linia jest widokiem bufora
+ * czytnika zakończonym znakiem '\0' (w odwzorowanym pliku znakiem końca
+ * linii) i pozostaje ważna do następnego wywołania tej funkcji. Znaki spoza zakresu typu char są zastępowane znakiem
+ * niewystępującym w poprawnych wielomianach.
+ * @param[in] reader : czytnik linii @f$reader@f$
+ * @return kolejna linia
+ */
+Line LineReaderRead(LineReader *reader);
+
+/**
+ * Usuwa czytnik linii lub odwzorowanie pliku z pamięci. Nie zamyka
+ * deskryptora pliku.
+ * @param[in] reader : czytnik linii @f$reader@f$
+ */
+void LineReaderDestroy(LineReader *reader);
+
 /**
  * Sprawdza, czy istnieje kolejna linia na wejściu.
  * @return Czy istnieje kolejna linia na wejściu.
@@ -82,36 +173,91 @@ size_t ReadValueSizeT(Line line, size_t *index, bool *isEmpty, bool
 *nonDecimalChars);
 
 /**
- * Wczytuje linię z wejścia.
- * @return Linia z ciągu znaków na wejściu.
+ * Wczytuje linię z wejścia czytnikiem wejścia kalkulatora.
+ * @return Linia z ciągu znaków na wejściu, ważna do następnego wywołania.
  */
 Line LineRead();
 
 /**
- * Usuwa linię z pamięci.
+ * Usuwa linię z pamięci. Linie są widokami bufora czytnika, więc nie
+ * zwalnia pamięci, a zwalnia ją dopiero LineReadFinish.
  * @param[in] line : linia @f$line@f$
  */
 void LineDestroy(Line line);
 
 /**
- * Wypisuje wielomian na wyjście.
+ * Przełącza wejście kalkulatora ze standardowego wejścia na plik skryptu
+ * odwzorowany w pamięci, a gdy odwzorowanie się nie uda, czytany blokami.
+ * @param[in] path : ścieżka pliku skryptu @f$path@f$
+ * @return czy udało się otworzyć plik
+ */
+bool LineReadScript(const char *path);
+
+/**
+ * Zwalnia czytnik wejścia kalkulatora i zamyka plik skryptu.
+ */
+void LineReadFinish(void);
+
+/**
+ * Inicjuje ujście przekazujące tekst do strumienia funkcją fwrite.
+ * @param[out] sink : ujście @f$sink@f$
+ * @param[in] stream : strumień @f$stream@f$
+ */
+void OutputSinkInitStream(OutputSink *sink, FILE *stream);
+
+/**
+ * Inicjuje ujście przekazujące tekst do deskryptora pliku funkcją write.
+ * @param[out] sink : ujście @f$sink@f$
+ * @param[in] fd : deskryptor pliku otwartego do pisania @f$fd@f$
+ */
+void OutputSinkInitFd(OutputSink *sink, int fd);
+
+/**
+ * Przekazuje zawartość bufora ujścia do strumienia lub deskryptora i opróżnia
+ * bufor.
+ * @param[in] sink : ujście @f$sink@f$
+ */
+void OutputSinkFlush(OutputSink *sink);
+
+/**
+ * Zapisuje wielomian wraz ze znakiem końca linii do bufora ujścia, bez
+ * wywołań printf i bez alokacji. Bufor jest opróżniany, gdy się zapełni.
+ * @param[in] sink : ujście @f$sink@f$
+ * @param[in] p : wielomian @f$p@f$
+ */
+void PolyWrite(OutputSink *sink, const Poly *p);
+
+/**
+ * Zapisuje spakowany wielomian do bufora ujścia w tej samej postaci co
+ * PolyWrite.
+ * @param[in] sink : ujście @f$sink@f$
+ * @param[in] packed : spakowany wielomian @f$packed@f$
+ */
+void PackedPolyWrite(OutputSink *sink, const PackedPoly *packed);
+
+/**
+ * Wypisuje wielomian na standardowe wyjście za pomocą PolyWrite.
  * @param[in] p : wielomian @f$p@f$
  */
 void PolyPrint(const Poly *p);
 
 /**
- * Wczytuje wielomian z wejścia.
- * @param[in] line : linia @f$line@f$
- * @return Wielomian zawarty w podanej linii.
+ * Wypisuje spakowany wielomian na wyjście w tej samej postaci co PolyPrint.
+ * @param[in] packed : spakowany wielomian @f$packed@f$
  */
-Poly PolyRead(Line line);
+void PackedPolyPrint(const PackedPoly *packed);
 
 /**
- * Sprawdza, czy linia jest prawidłowym wielomianem.
+ * Wczytuje wielomian z linii, sprawdzając jednocześnie jego poprawność.
+ * Działa w jednym przejściu po linii, w czasie liniowym względem jej długości.
+ * Wielomian, w którym jednomiany są zagnieżdżone więcej niż 1000 razy, jest
+ * uznawany za niepoprawny.
  * @param[in] line : linia @f$line@f$
+ * @param[out] p : wielomian zawarty w linii, ustawiany tylko wtedy, gdy linia
+ * jest prawidłowym wielomianem
  * @return Czy linia jest prawidłowym wielomianem?
  */
-bool PolyIsCorrect(Line line);
+bool PolyParse(Line line, Poly *p);
 
 /**
  * Sprawdza, czy należy ignorować linię.
@@ -0,0 +1,233 @@
+#ifndef POPRAWKA_DUZE_ZADANIE_LEXER_H
+#define POPRAWKA_DUZE_ZADANIE_LEXER_H
+/** @file
+  Lekser liczb całkowitych zapisanych w systemie dziesiętnym. Funkcje są
+  wywoływane dla każdej liczby w linii, więc są zdefiniowane w nagłówku.
+
+  @authors Jakub Krakowiak <jk429351@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * To jest struktura przechowująca liczbę wczytaną z ciągu znaków. Liczba
+ * składa się z przedrostka, czyli białych znaków i opcjonalnego znaku '+'
+ * lub '-', oraz niepustego ciągu cyfr.
+ */
+typedef struct LexedNumber {
+    size_t length; ///< liczba wczytanych znaków; zero, gdy nie ma liczby
+    size_t prefix; ///< liczba znaków przedrostka
+    unsigned long magnitude; ///< wartość bezwzględna lub ULONG_MAX
+    bool negative; ///< czy liczba jest poprzedzona znakiem '-'
+    bool overflow; ///< czy wartość bezwzględna przekracza ULONG_MAX
+} LexedNumber;
+
+/** To jest makrodefinicja reprezentująca liczbę cyfr czytanych naraz. */
+#define LEX_CHUNK_DIGITS 8
+/** To jest makrodefinicja reprezentująca liczbę cyfr, która na pewno nie
+ * przepełnia typu unsigned long. */
+#define LEX_SAFE_DIGITS (ULONG_MAX > 0xFFFFFFFFUL ? 19 : 9)
+/** To jest makrodefinicja reprezentująca wartość @f$10^8@f$, przez którą
+ * mnożony jest wynik przed dodaniem ośmiu cyfr. */
+#define LEX_CHUNK_SCALE 100000000UL
+/** To jest makrodefinicja reprezentująca słowo ośmiu znaków '0'. */
+#define LEX_ZEROS 0x3030303030303030ULL
+/** To jest makrodefinicja reprezentująca maskę starszych półbajtów słowa. */
+#define LEX_HIGH_NIBBLES 0xF0F0F0F0F0F0F0F0ULL
+/** To jest makrodefinicja reprezentująca słowo, którego dodanie przenosi
+ * znaki ':' - '?' do kolejnej szesnastki. */
+#define LEX_DIGIT_CARRY 0x0606060606060606ULL
+
+/** To jest makrodefinicja włączająca czytanie ośmiu cyfr naraz, które
+ * zakłada kolejność bajtów little-endian. */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LEX_SWAR 1
+#else
+#define LEX_SWAR 0
+#endif
+
+/**
+ * Sprawdza, czy podany znak jest jednym ze znaków '0' - '9'.
+ * @param[in] c : znak @f$c@f$
+ * @return Czy podany znak jest cyfrą?
+ */
+static inline bool LexIsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Sprawdza, czy podany znak jest białym znakiem w rozumieniu funkcji isspace
+ * w domyślnych ustawieniach lokalnych "C", które kalkulator stosuje.
+ * @param[in] c : znak @f$c@f$
+ * @return Czy podany znak jest białym znakiem?
+ */
+static inline bool LexIsSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * Wczytuje osiem znaków naraz, jeśli wszystkie są cyframi. Sprawdzenie
+ * i zamiana na liczbę odbywają się na jednym słowie 64-bitowym: cyfry są
+ * łączone parami, czwórkami i ósemkami.
+ * @param[in] string : ciąg co najmniej ośmiu znaków @f$string@f$
+ * @param[out] value : wartość ośmiu cyfr
+ * @return czy wszystkie znaki są cyframi
+ */
+static inline bool LexChunk(const char *string, unsigned long *value) {
+    uint64_t word;
+    memcpy(&word, string, sizeof(word));
+
+    if ((word & LEX_HIGH_NIBBLES) != LEX_ZEROS ||
+        ((word + LEX_DIGIT_CARRY) & LEX_HIGH_NIBBLES) != LEX_ZEROS) {
+
+        return false;
+    }
+
+    word -= LEX_ZEROS;
+    word = (word * 10 + (word >> 8)) & 0x00FF00FF00FF00FFULL;
+    word = (word * 100 + (word >> 16)) & 0x0000FFFF0000FFFFULL;
+    word = (word * 10000 + (word >> 32)) & 0xFFFFFFFFULL;
+    *value = (unsigned long) word;
+
+    return true;
+}
+
+/**
+ * Wczytuje najdłuższy ciąg cyfr z początku ciągu znaków, wykrywając
+ * przepełnienie typu unsigned long. Pierwsze LEX_SAFE_DIGITS cyfr nie może
+ * go przepełnić, więc są czytane bez sprawdzania, w miarę możliwości po
+ * osiem naraz. Cyfry za przepełnieniem są tylko pomijane.
+ * @param[in] string : ciąg znaków @f$string@f$
+ * @param[in] length : liczba dostępnych znaków @f$length@f$
+ * @param[out] number : liczba, której wartość bezwzględna i przepełnienie
+ * są uzupełniane
+ * @return liczba wczytanych cyfr
+ */
+static inline size_t LexDigits(const char *string, size_t length,
+                               LexedNumber *number) {
+    size_t safe = length < LEX_SAFE_DIGITS ? length : LEX_SAFE_DIGITS;
+    unsigned long result = 0;
+    unsigned long chunk;
+    bool overflow = false;
+    size_t i = 0;
+
+    while (LEX_SWAR && i + LEX_CHUNK_DIGITS <= safe &&
+           LexChunk(string + i, &chunk)) {
+        result = result * LEX_CHUNK_SCALE + chunk;
+        i += LEX_CHUNK_DIGITS;
+    }
+
+    while (i < safe && LexIsDigit(string[i])) {
+        result = result * 10 + (unsigned long) (string[i] - '0');
+        i++;
+    }
+
+    while (i < length && LexIsDigit(string[i])) {
+        unsigned long digit = (unsigned long) (string[i] - '0');
+        overflow |= result > (ULONG_MAX - digit) / 10;
+        result = result * 10 + digit;
+        i++;
+
+        while (LEX_SWAR && overflow && i + LEX_CHUNK_DIGITS <= length &&
+               LexChunk(string + i, &chunk)) {
+            i += LEX_CHUNK_DIGITS;
+        }
+    }
+
+    number->magnitude = overflow ? ULONG_MAX : result;
+    number->overflow = overflow;
+
+    return i;
+}
+
+/**
+ * Wczytuje liczbę z początku ciągu znaków, akceptując te same ciągi co
+ * funkcje strtol i strtoul o podstawie 10. W odróżnieniu od nich nie czyta
+ * więcej niż @p length znaków i nie wymaga kończącego znaku '\0'. Cyfry są
+ * czytane w jednym przejściu, po osiem naraz.
+ * @param[in] string : ciąg znaków @f$string@f$
+ * @param[in] length : liczba dostępnych znaków @f$length@f$
+ * @return wczytana liczba
+ */
+static inline LexedNumber LexNumber(const char *string, size_t length) {
+    LexedNumber number = {.length = 0, .prefix = 0, .magnitude = 0,
+                          .negative = false, .overflow = false};
+    size_t i = 0;
+
+    while (i < length && LexIsSpace(string[i])) {
+        i++;
+    }
+
+    bool negative = i < length && string[i] == '-';
+
+    if (i < length && (string[i] == '+' || negative)) {
+        i++;
+    }
+
+    size_t digits = LexDigits(string + i, length - i, &number);
+
+    if (digits == 0) {
+
+        return (LexedNumber) {.length = 0, .prefix = 0, .magnitude = 0,
+                              .negative = false, .overflow = false};
+    }
+
+    number.prefix = i;
+    number.length = i + digits;
+    number.negative = negative;
+
+    return number;
+}
+
+/**
+ * Zamienia wczytaną liczbę na wartość typu long, tak jak strtol.
+ * @param[in] number : wczytana liczba @f$number@f$
+ * @param[out] overflow : czy wartość nie mieści się w typie long; wynikiem
+ * jest wtedy LONG_MAX lub LONG_MIN
+ * @return wartość liczby
+ */
+static inline long LexedToLong(LexedNumber number, bool *overflow) {
+    unsigned long bound = number.negative ? (unsigned long) LONG_MAX + 1 :
+            (unsigned long) LONG_MAX;
+    *overflow = number.overflow || number.magnitude > bound;
+
+    if (*overflow) {
+
+        return number.negative ? LONG_MIN : LONG_MAX;
+    }
+
+    if (number.negative && number.magnitude > 0) {
+
+        return -(long) (number.magnitude - 1) - 1;
+    }
+
+    return (long) number.magnitude;
+}
+
+/**
+ * Zamienia wczytaną liczbę na wartość typu unsigned long, tak jak strtoul.
+ * Liczba ujemna jest zamieniana na wartość przeciwną modulo
+ * @f$ULONG\_MAX + 1@f$.
+ * @param[in] number : wczytana liczba @f$number@f$
+ * @param[out] overflow : czy wartość bezwzględna nie mieści się w typie
+ * unsigned long; wynikiem jest wtedy ULONG_MAX
+ * @return wartość liczby
+ */
+static inline unsigned long LexedToUnsignedLong(LexedNumber number,
+                                                bool *overflow) {
+    *overflow = number.overflow;
+
+    if (*overflow) {
+
+        return ULONG_MAX;
+    }
+
+    return number.negative ? 0 - number.magnitude : number.magnitude;
+}
+
+#endif //POPRAWKA_DUZE_ZADANIE_LEXER_H
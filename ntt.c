@@ -0,0 +1,362 @@
+/** @file
+  Realizacja mnożenia wektorów współczynników za pomocą liczbowej transformaty
+  Fouriera (NTT)
+
+  @authors Jakub Krakowiak <jk429351@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include "ntt.h"
+#include "data_structures.h"
+
+/** To jest makrodefinicja reprezentująca liczbę modułów używanych w NTT. */
+#define NTT_PRIMES 3
+
+/** To jest makrodefinicja reprezentująca długość bloku transformaty, który
+ * mieści się w pamięci podręcznej i jest przekształcany etap po etapie. */
+#define NTT_BLOCK (1 << 14)
+
+/** To jest typ reprezentujący iloczyn dwóch liczb 64-bitowych. */
+typedef unsigned __int128 NttWide;
+
+/**
+ * To jest struktura przechowująca liczbę pierwszą postaci @f$k2^s + 1@f$
+ * wraz ze stałymi potrzebnymi do mnożenia Montgomery'ego.
+ */
+typedef struct NttPrime {
+    uint64_t mod; ///< liczba pierwsza mniejsza niż @f$2^{62}@f$
+    uint64_t root; ///< generator grupy multiplikatywnej modulo @p mod
+    uint64_t negInv; ///< @f$-mod^{-1} \bmod 2^{64}@f$
+    uint64_t r2; ///< @f$2^{128} \bmod mod@f$
+} NttPrime;
+
+/** To jest tablica modułów. Każdy dzieli się przez @f$2^{33}@f$ po odjęciu
+ * jedynki, co pozwala na transformaty długości do @f$2^{33}@f$. */
+static const NttPrime primes[NTT_PRIMES] = {
+        {4611685941117976577UL, 3UL, 4611685941117976575UL,
+                1600614052114192UL},
+        {4611685692009873409UL, 19UL, 4611685692009873407UL,
+                120654358717815824UL},
+        {4611685606110527489UL, 3UL, 4611685606110527487UL,
+                243181185737883664UL},
+};
+
+/** To jest makrodefinicja reprezentująca odwrotność pierwszego modułu modulo
+ * drugi moduł, w postaci Montgomery'ego. */
+#define INV_M0_MOD_M1 1908283734698826364UL
+/** To jest makrodefinicja reprezentująca pierwszy moduł modulo trzeci moduł,
+ * w postaci Montgomery'ego. */
+#define M0_MOD_M2 49397518382803968UL
+/** To jest makrodefinicja reprezentująca odwrotność iloczynu dwóch pierwszych
+ * modułów modulo trzeci moduł, w postaci Montgomery'ego. */
+#define INV_M0M1_MOD_M2 1155877610249497595UL
+
+/**
+ * Mnoży dwie liczby modulo @p p metodą Montgomery'ego. Jeśli jeden
+ * z czynników jest w postaci Montgomery'ego, to wynik jest w postaci zwykłej,
+ * a jeśli oba, to w postaci Montgomery'ego.
+ * @param[in] a : czynnik mniejszy niż moduł @f$a@f$
+ * @param[in] b : czynnik mniejszy niż moduł @f$b@f$
+ * @param[in] p : moduł @f$p@f$
+ * @return @f$ab2^{-64} \bmod p@f$
+ */
+static inline uint64_t MontMul(uint64_t a, uint64_t b, const NttPrime *p) {
+    NttWide t = (NttWide)a * b;
+    uint64_t m = (uint64_t)t * p->negInv;
+    uint64_t result = (uint64_t)((t + (NttWide)m * p->mod) >> 64);
+
+    return result >= p->mod ? result - p->mod : result;
+}
+
+/**
+ * Podnosi liczbę w postaci Montgomery'ego do potęgi.
+ * @param[in] x : podstawa w postaci Montgomery'ego @f$x@f$
+ * @param[in] n : wykładnik @f$n@f$
+ * @param[in] p : moduł @f$p@f$
+ * @return @f$x^n@f$ w postaci Montgomery'ego
+ */
+static uint64_t MontPow(uint64_t x, uint64_t n, const NttPrime *p) {
+    uint64_t result = MontMul(1, p->r2, p);
+
+    while (n > 0) {
+        if (n & 1) {
+            result = MontMul(result, x, p);
+        }
+
+        x = MontMul(x, x, p);
+        n >>= 1;
+    }
+
+    return result;
+}
+
+/**
+ * Zamienia współczynnik na resztę modulo @p p w postaci Montgomery'ego.
+ * Moduł jest bliski @f$2^{62}@f$, więc wartość bezwzględna współczynnika jest
+ * mniejsza niż jego trzykrotność i wystarczą odejmowania zamiast dzielenia.
+ * @param[in] c : współczynnik @f$c@f$
+ * @param[in] p : moduł @f$p@f$
+ * @return @f$c \bmod p@f$ w postaci Montgomery'ego
+ */
+static uint64_t NttResidue(poly_coeff_t c, const NttPrime *p) {
+    uint64_t u = c >= 0 ? (uint64_t)c : 0 - (uint64_t)c;
+
+    while (u >= p->mod) {
+        u -= p->mod;
+    }
+
+    if (c < 0 && u != 0) {
+        u = p->mod - u;
+    }
+
+    return MontMul(u, p->r2, p);
+}
+
+/**
+ * Wykonuje jeden etap transformaty z podziałem w dziedzinie częstotliwości
+ * na bloku długości @p m. Kolejne potęgi pierwiastka pierwotnego stopnia @p m
+ * leżą w tablicy @p roots pod indeksami od @p m / 2 do @p m - 1, więc etap
+ * czyta je po kolei.
+ * @param[in] a : blok wektora reszt @f$a@f$
+ * @param[in] m : długość bloku, potęga dwójki @f$m@f$
+ * @param[in] roots : tablica pierwiastków @f$roots@f$
+ * @param[in] p : moduł @f$p@f$
+ */
+static inline void NttForwardStage(uint64_t *a, size_t m,
+                                   const uint64_t *roots, const NttPrime *p) {
+    size_t half = m >> 1;
+    const uint64_t *w = roots + half;
+    // kopia modułu nie może się pokrywać z wektorem, więc kompilator nie
+    // odczytuje jej ponownie po każdym zapisie do wektora
+    const NttPrime prime = *p;
+
+    for (size_t j = 0; j < half; j++) {
+        uint64_t u = a[j];
+        uint64_t v = a[j + half];
+        uint64_t sum = u + v;
+
+        a[j] = sum >= prime.mod ? sum - prime.mod : sum;
+        a[j + half] = MontMul(u >= v ? u - v : u + prime.mod - v, w[j],
+                              &prime);
+    }
+}
+
+/**
+ * Wykonuje jeden etap transformaty z podziałem w dziedzinie czasu na bloku
+ * długości @p m. Pierwiastki są ułożone tak jak w NttForwardStage.
+ * @param[in] a : blok wektora reszt @f$a@f$
+ * @param[in] m : długość bloku, potęga dwójki @f$m@f$
+ * @param[in] roots : tablica pierwiastków @f$roots@f$
+ * @param[in] p : moduł @f$p@f$
+ */
+static inline void NttBackwardStage(uint64_t *a, size_t m,
+                                    const uint64_t *roots, const NttPrime *p) {
+    size_t half = m >> 1;
+    const uint64_t *w = roots + half;
+    const NttPrime prime = *p; // kopia, tak jak w NttForwardStage
+
+    for (size_t j = 0; j < half; j++) {
+        uint64_t u = a[j];
+        uint64_t v = MontMul(a[j + half], w[j], &prime);
+        uint64_t sum = u + v;
+
+        a[j] = sum >= prime.mod ? sum - prime.mod : sum;
+        a[j + half] = u >= v ? u - v : u + prime.mod - v;
+    }
+}
+
+/**
+ * Wykonuje w miejscu transformatę NTT z podziałem w dziedzinie częstotliwości.
+ * Wynik jest zapisany w kolejności odwróconych bitów indeksów. Bloki dłuższe
+ * niż NTT_BLOCK dzielone są rekurencyjnie, więc dalsze etapy pracują na
+ * fragmentach mieszczących się w pamięci podręcznej.
+ * @param[in] a : wektor reszt w postaci Montgomery'ego @f$a@f$
+ * @param[in] m : długość wektora, potęga dwójki @f$m@f$
+ * @param[in] roots : tablica pierwiastków @f$roots@f$
+ * @param[in] p : moduł @f$p@f$
+ */
+static void NttForward(uint64_t *a, size_t m, const uint64_t *roots,
+                       const NttPrime *p) {
+    if (m > NTT_BLOCK) {
+        NttForwardStage(a, m, roots, p);
+        NttForward(a, m >> 1, roots, p);
+        NttForward(a + (m >> 1), m >> 1, roots, p);
+
+        return;
+    }
+
+    for (size_t length = m; length >= 2; length >>= 1) {
+        for (size_t i = 0; i < m; i += length) {
+            NttForwardStage(a + i, length, roots, p);
+        }
+    }
+}
+
+/**
+ * Wykonuje w miejscu transformatę NTT z podziałem w dziedzinie czasu na
+ * wektorze zapisanym w kolejności odwróconych bitów indeksów. Wynik jest
+ * zapisany w zwykłej kolejności. Bloki dłuższe niż NTT_BLOCK dzielone są
+ * rekurencyjnie, tak jak w NttForward.
+ * @param[in] a : wektor reszt w postaci Montgomery'ego @f$a@f$
+ * @param[in] m : długość wektora, potęga dwójki @f$m@f$
+ * @param[in] roots : tablica pierwiastków @f$roots@f$
+ * @param[in] p : moduł @f$p@f$
+ */
+static void NttBackward(uint64_t *a, size_t m, const uint64_t *roots,
+                        const NttPrime *p) {
+    if (m > NTT_BLOCK) {
+        NttBackward(a, m >> 1, roots, p);
+        NttBackward(a + (m >> 1), m >> 1, roots, p);
+        NttBackwardStage(a, m, roots, p);
+
+        return;
+    }
+
+    for (size_t length = 2; length <= m; length <<= 1) {
+        for (size_t i = 0; i < m; i += length) {
+            NttBackwardStage(a + i, length, roots, p);
+        }
+    }
+}
+
+/**
+ * Liczy splot dwóch wektorów modulo jedna liczba pierwsza. Transformaty
+ * w przód zostawiają wynik w kolejności odwróconych bitów, a transformata
+ * odwrotna ją przywraca, więc wektory nie są przestawiane.
+ * @param[in] a : pierwszy wektor współczynników @f$a@f$
+ * @param[in] aLength : długość wektora @p a @f$aLength@f$
+ * @param[in] b : drugi wektor współczynników @f$b@f$
+ * @param[in] bLength : długość wektora @p b @f$bLength@f$
+ * @param[in] n : długość transformaty @f$n@f$
+ * @param[in] p : moduł @f$p@f$
+ * @param[in] result : tablica długości @p n na reszty wyniku w postaci zwykłej
+ * @f$result@f$
+ * @param[in] buffer : tablica pomocnicza długości 2 @p n
+ * @f$buffer@f$
+ */
+static void NttConvolution(const poly_coeff_t *a, size_t aLength,
+                           const poly_coeff_t *b, size_t bLength, size_t n,
+                           const NttPrime *p, uint64_t *result,
+                           uint64_t *buffer) {
+    const NttPrime prime = *p; // kopia, tak jak w NttForwardStage
+    p = &prime;
+    uint64_t *fb = buffer;
+    uint64_t *roots = buffer + n;
+    uint64_t root = MontPow(MontMul(p->root, p->r2, p), (p->mod - 1) / n, p);
+
+    // potęgi pierwiastka stopnia n leżą na końcu tablicy, a potęgi
+    // pierwiastków mniejszych stopni to co druga potęga pierwiastka stopnia
+    // dwa razy większego
+    roots[n / 2] = MontMul(1, p->r2, p);
+
+    for (size_t i = n / 2 + 1; i < n; i++) {
+        roots[i] = MontMul(roots[i - 1], root, p);
+    }
+
+    for (size_t i = n / 2 - 1; i > 0; i--) {
+        roots[i] = roots[2 * i];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        result[i] = i < aLength ? NttResidue(a[i], p) : 0;
+    }
+
+    NttForward(result, n, roots, p);
+
+    if (b == a && bLength == aLength) { // kwadrat - jedna transformata
+        fb = result;
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            fb[i] = i < bLength ? NttResidue(b[i], p) : 0;
+        }
+
+        NttForward(fb, n, roots, p);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        result[i] = MontMul(result[i], fb[i], p);
+    }
+
+    // transformata odwrotna to transformata z odwróconą kolejnością
+    // wyrazów 1..n-1, pomnożona przez odwrotność n
+    NttBackward(result, n, roots, p);
+
+    uint64_t nInverse = MontMul(MontPow(MontMul(n % p->mod, p->r2, p),
+                                        p->mod - 2, p), 1, p);
+
+    for (size_t i = 1; i < n - i; i++) {
+        uint64_t tmp = result[i];
+        result[i] = result[n - i];
+        result[n - i] = tmp;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        // reszta w postaci Montgomery'ego razy zwykła odwrotność n daje
+        // wynik w postaci zwykłej
+        result[i] = MontMul(result[i], nInverse, p);
+    }
+}
+
+bool NttMultiply(const poly_coeff_t *a, size_t aLength, const poly_coeff_t *b,
+                 size_t bLength, unsigned long *result) {
+    assert(aLength > 0 && bLength > 0);
+    size_t resultLength = aLength + bLength - 1;
+    size_t n = 2;
+
+    while (n < resultLength) {
+        n <<= 1;
+    }
+
+    if (!MemoryReserve((2 * n + NTT_PRIMES * n) * sizeof(uint64_t))) {
+
+        return false;
+    }
+
+    ArenaMark mark = ArenaGetMark();
+    uint64_t *residues[NTT_PRIMES];
+    uint64_t *buffer = ArenaAlloc(2 * n * sizeof(uint64_t));
+
+    for (size_t k = 0; k < NTT_PRIMES; k++) {
+        residues[k] = ArenaAlloc(n * sizeof(uint64_t));
+        NttConvolution(a, aLength, b, bLength, n, &primes[k], residues[k],
+                       buffer);
+    }
+
+    const NttPrime *p1 = &primes[1];
+    const NttPrime *p2 = &primes[2];
+    uint64_t m0 = primes[0].mod;
+    uint64_t m0m1 = m0 * p1->mod; // modulo 2^64
+    uint64_t m = m0m1 * p2->mod; // modulo 2^64
+
+    for (size_t i = 0; i < resultLength; i++) {
+        // algorytm Garnera: wynik = x0 + x1 * m0 + x2 * m0 * m1
+        uint64_t x0 = residues[0][i];
+        uint64_t r = x0 >= p1->mod ? x0 - p1->mod : x0;
+        uint64_t x1 = residues[1][i] >= r ? residues[1][i] - r :
+                residues[1][i] + p1->mod - r;
+        x1 = MontMul(x1, INV_M0_MOD_M1, p1);
+
+        r = x0 >= p2->mod ? x0 - p2->mod : x0;
+        uint64_t s = MontMul(x1 >= p2->mod ? x1 - p2->mod : x1, M0_MOD_M2, p2);
+        r = r + s >= p2->mod ? r + s - p2->mod : r + s;
+        uint64_t x2 = residues[2][i] >= r ? residues[2][i] - r :
+                residues[2][i] + p2->mod - r;
+        x2 = MontMul(x2, INV_M0M1_MOD_M2, p2);
+
+        uint64_t value = x0 + x1 * m0 + x2 * m0m1;
+
+        // liczby większe niż połowa iloczynu modułów są ujemne; cyfry
+        // połowy iloczynu w zapisie mieszanym to (m_i - 1) / 2
+        bool negative = x2 != (p2->mod - 1) / 2 ? x2 > (p2->mod - 1) / 2 :
+                        x1 != (p1->mod - 1) / 2 ? x1 > (p1->mod - 1) / 2 :
+                        x0 > (m0 - 1) / 2;
+
+        result[i] = negative ? value - m : value;
+    }
+
+    ArenaRelease(mark);
+
+    return true;
+}
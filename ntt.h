@@ -0,0 +1,34 @@
+#ifndef POPRAWKA_DUZE_ZADANIE_NTT_H
+#define POPRAWKA_DUZE_ZADANIE_NTT_H
+/** @file
+  Interfejs mnożenia wektorów współczynników za pomocą liczbowej transformaty
+  Fouriera (NTT)
+
+  @authors Jakub Krakowiak <jk429351@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+#include "poly.h"
+
+/**
+ * Wylicza splot dwóch wektorów współczynników. Mnożenie wykonywane jest modulo
+ * trzy 62-bitowe liczby pierwsze, a wynik jest odtwarzany z chińskiego
+ * twierdzenia o resztach. Współczynniki wyniku są równe modulo @f$2^{64}@f$
+ * współczynnikom splotu liczonego w arytmetyce typu poly_coeff_t, czyli
+ * dokładnie takie, jak przy mnożeniu współczynników "po kolei".
+ * Zapisuje @p aLength + @p bLength - 1 współczynników do tablicy @p result.
+ * Jeśli @p b to ten sam wektor co @p a, to liczony jest kwadrat i każda
+ * z transformat w przód wykonywana jest raz.
+ * Tablice pomocnicze transformat są przed alokacją sprawdzane w limicie
+ * pamięci; jeśli się w nim nie mieszczą, splot nie jest liczony.
+ * @param[in] a : pierwszy wektor współczynników @f$a@f$
+ * @param[in] aLength : długość wektora @p a @f$aLength@f$
+ * @param[in] b : drugi wektor współczynników @f$b@f$
+ * @param[in] bLength : długość wektora @p b @f$bLength@f$
+ * @param[in] result : tablica na wynik @f$result@f$
+ * @return czy splot zmieścił się w limicie pamięci i został policzony
+ */
+bool NttMultiply(const poly_coeff_t *a, size_t aLength, const poly_coeff_t *b,
+                 size_t bLength, unsigned long *result);
+
+#endif //POPRAWKA_DUZE_ZADANIE_NTT_H
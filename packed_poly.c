@@ -0,0 +1,347 @@
+/** @file
+  Implementacja spakowanej, niemodyfikowalnej postaci wielomianów rzadkich
+  wielu zmiennych
+
+  @authors Jakub Krakowiak <jk429351@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+#include "packed_poly.h"
+#include "data_structures.h"
+#include <stdlib.h>
+
+/**
+ * Zlicza węzły, które zajmie wielomian po spakowaniu.
+ * @param[in] p : wielomian @f$p@f$
+ * @return liczba węzłów drzewa wielomianu @p p
+ */
+size_t PackedLength(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+
+        return 1;
+    }
+
+    Mono single;
+    const Mono *monos = PolyMonos(p, &single);
+    size_t count = PolyMonoCount(p);
+    size_t result = 1;
+
+    for (size_t i = 0; i < count; i++) {
+        result += PackedLength(&monos[i].p);
+    }
+
+    return result;
+}
+
+/**
+ * Zapisuje wielomian w kolejności pre-order od węzła o indeksie @p i.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] exp : wykładnik jednomianu, którego współczynnikiem jest @p p
+ * @param[out] nodes : tablica węzłów
+ * @param[in] i : indeks pierwszego wolnego węzła
+ * @return indeks pierwszego węzła za zapisanym poddrzewem
+ */
+size_t PackedWrite(const Poly *p, poly_exp_t exp, PackedNode *nodes,
+                   size_t i) {
+    PackedNode *node = &nodes[i];
+    node->exp = exp;
+    node->isCoeff = PolyIsCoeff(p);
+
+    if (node->isCoeff) {
+        node->coeff = PolyGetCoeff(p);
+        node->length = 1;
+
+        return i + 1;
+    }
+
+    Mono single;
+    const Mono *monos = PolyMonos(p, &single);
+    size_t end = i + 1;
+    node->size = PolyMonoCount(p);
+
+    for (size_t k = 0; k < node->size; k++) {
+        end = PackedWrite(&monos[k].p, monos[k].exp, nodes, end);
+    }
+
+    node->length = end - i;
+
+    return end;
+}
+
+PackedPoly *PolyPack(const Poly *p) {
+    size_t length = PackedLength(p);
+    PackedPoly *packed = securePoolMalloc(sizeof(PackedPoly) +
+                                          length * sizeof(PackedNode));
+    packed->length = length;
+    PackedWrite(p, 0, packed->nodes, 0);
+
+    return packed;
+}
+
+size_t PolyPackedBytes(const Poly *p) {
+    return sizeof(PackedPoly) + PackedLength(p) * sizeof(PackedNode);
+}
+
+/**
+ * Odtwarza wielomian z poddrzewa zaczynającego się w węźle o indeksie @p i.
+ * @param[in] nodes : tablica węzłów
+ * @param[in] i : indeks korzenia poddrzewa
+ * @return wielomian zapisany w poddrzewie
+ */
+Poly PackedNodeUnpack(const PackedNode *nodes, size_t i) {
+    if (nodes[i].isCoeff) {
+
+        return PolyFromCoeff(nodes[i].coeff);
+    }
+
+    size_t count = nodes[i].size;
+    Mono *monos = secureMalloc(count * sizeof(Mono));
+    size_t child = i + 1;
+
+    for (size_t k = 0; k < count; k++) {
+        Poly coeff = PackedNodeUnpack(nodes, child);
+        monos[k] = MonoFromPoly(&coeff, nodes[child].exp);
+        child += nodes[child].length;
+    }
+
+    return PolyOwnMonos(count, monos);
+}
+
+Poly PolyUnpack(const PackedPoly *packed) {
+    return PackedNodeUnpack(packed->nodes, 0);
+}
+
+size_t PackedPolyBytes(const PackedPoly *packed) {
+    return sizeof(PackedPoly) + packed->length * sizeof(PackedNode);
+}
+
+void PackedPolyDestroy(PackedPoly *packed) {
+    if (packed != NULL) {
+        securePoolFree(packed, PackedPolyBytes(packed));
+    }
+}
+
+/**
+ * Zwraca stopień wielomianu zapisanego w poddrzewie.
+ * @param[in] nodes : tablica węzłów
+ * @param[in] i : indeks korzenia poddrzewa
+ * @return stopień wielomianu (-1 dla wielomianu tożsamościowo równego zeru)
+ */
+poly_exp_t PackedNodeDeg(const PackedNode *nodes, size_t i) {
+    if (nodes[i].isCoeff) {
+
+        return nodes[i].coeff == 0 ? -1 : 0;
+    }
+
+    poly_exp_t result = 0;
+    size_t child = i + 1;
+
+    for (size_t k = 0; k < nodes[i].size; k++) {
+        poly_exp_t holder = nodes[child].exp + PackedNodeDeg(nodes, child);
+
+        if (holder > result) {
+            result = holder;
+        }
+
+        child += nodes[child].length;
+    }
+
+    return result;
+}
+
+poly_exp_t PackedPolyDeg(const PackedPoly *packed) {
+    return PackedNodeDeg(packed->nodes, 0);
+}
+
+/**
+ * Zwraca stopień wielomianu zapisanego w poddrzewie ze względu na zmienną
+ * o indeksie @p var_idx.
+ * @param[in] nodes : tablica węzłów
+ * @param[in] i : indeks korzenia poddrzewa
+ * @param[in] var_idx : indeks zmiennej @f$var\_idx@f$
+ * @return stopień wielomianu (-1 dla wielomianu tożsamościowo równego zeru)
+ */
+poly_exp_t PackedNodeDegBy(const PackedNode *nodes, size_t i,
+                           size_t var_idx) {
+    if (nodes[i].isCoeff) {
+
+        return nodes[i].coeff == 0 ? -1 : 0;
+    }
+
+    poly_exp_t result = 0;
+    size_t child = i + 1;
+
+    for (size_t k = 0; k < nodes[i].size; k++) {
+        poly_exp_t holder = var_idx == 0 ? nodes[child].exp :
+                            PackedNodeDegBy(nodes, child, var_idx - 1);
+
+        if (holder > result) {
+            result = holder;
+        }
+
+        child += nodes[child].length;
+    }
+
+    return result;
+}
+
+poly_exp_t PackedPolyDegBy(const PackedPoly *packed, size_t var_idx) {
+    return PackedNodeDegBy(packed->nodes, 0, var_idx);
+}
+
+bool PackedPolyIsEq(const PackedPoly *p, const PackedPoly *q) {
+    if (p->length != q->length) {
+
+        return false;
+    }
+
+    for (size_t i = 0; i < p->length; i++) {
+        const PackedNode *a = &p->nodes[i];
+        const PackedNode *b = &q->nodes[i];
+
+        if (a->isCoeff != b->isCoeff || a->exp != b->exp ||
+            a->length != b->length ||
+            (a->isCoeff ? a->coeff != b->coeff : a->size != b->size)) {
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * To jest struktura opisująca poddrzewo spakowanego wielomianu wzięte
+ * z wagą do kombinacji liniowej.
+ */
+typedef struct PackedTerm {
+    size_t node; ///< indeks korzenia poddrzewa
+    unsigned long weight; ///< waga poddrzewa
+    poly_exp_t exp; ///< wykładnik jednomianu, którego współczynnikiem jest
+                    ///< poddrzewo
+} PackedTerm;
+
+/**
+ * Porównuje składniki kombinacji liniowej według wykładników.
+ * @param[in] a : wskaźnik na składnik @f$a@f$
+ * @param[in] b : wskaźnik na składnik @f$b@f$
+ * @return -1, 0 lub 1 w zależności od tego, czy wykładnik @p a jest
+ * mniejszy, równy, czy większy od wykładnika @p b
+ */
+int ComparePackedTerms(const void *a, const void *b) {
+    poly_exp_t x = ((const PackedTerm *) a)->exp;
+    poly_exp_t y = ((const PackedTerm *) b)->exp;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Wylicza kombinację liniową poddrzew spakowanego wielomianu bez
+ * odtwarzania ich: sumę wielomianów z poddrzew pomnożonych przez wagi.
+ * Współczynniki liczbowe są sumowane od razu, a jednomiany poddrzew
+ * o równych wykładnikach łączone są rekurencyjnie w jeden jednomian, więc
+ * alokowane są tylko tablice jednomianów wyniku.
+ * @param[in] nodes : tablica węzłów
+ * @param[in] terms : składniki kombinacji; ich pola exp są pomijane
+ * @param[in] count : liczba składników @f$count@f$
+ * @return kombinacja liniowa poddrzew
+ */
+Poly PackedCombine(const PackedNode *nodes, const PackedTerm *terms,
+                   size_t count) {
+    unsigned long sum = 0;
+    size_t childCount = 0;
+
+    for (size_t j = 0; j < count; j++) {
+        const PackedNode *node = &nodes[terms[j].node];
+
+        if (node->isCoeff) {
+            sum += (unsigned long) node->coeff * terms[j].weight;
+        } else {
+            childCount += node->size;
+        }
+    }
+
+    if (childCount == 0) {
+
+        return PolyFromCoeff((poly_coeff_t) sum);
+    }
+
+    ArenaMark mark = ArenaGetMark();
+    PackedTerm *children = ArenaAlloc(childCount * sizeof(PackedTerm));
+    size_t n = 0;
+
+    for (size_t j = 0; j < count; j++) {
+        const PackedNode *node = &nodes[terms[j].node];
+        size_t child = terms[j].node + 1;
+
+        for (size_t k = 0; !node->isCoeff && k < node->size; k++) {
+            children[n] = (PackedTerm) {.node = child, .weight =
+                    terms[j].weight, .exp = nodes[child].exp};
+            n++;
+            child += nodes[child].length;
+        }
+    }
+
+    qsort(children, childCount, sizeof(PackedTerm), ComparePackedTerms);
+
+    Mono *monos = ArenaAlloc((childCount + 1) * sizeof(Mono));
+    size_t size = 0;
+
+    if (sum != 0 && children[0].exp != 0) {
+        Poly constant = PolyFromCoeff((poly_coeff_t) sum);
+        monos[size] = MonoFromPoly(&constant, 0);
+        size++;
+    }
+
+    for (size_t begin = 0, end; begin < childCount; begin = end) {
+        end = begin + 1;
+
+        while (end < childCount && children[end].exp == children[begin].exp) {
+            end++;
+        }
+
+        Poly coeff = PackedCombine(nodes, children + begin, end - begin);
+
+        if (children[begin].exp == 0) {
+            Poly constant = PolyFromCoeff((poly_coeff_t) sum);
+            coeff = PolyAddOwn(&coeff, &constant);
+        }
+
+        if (!PolyIsZero(&coeff)) {
+            monos[size] = MonoFromPoly(&coeff, children[begin].exp);
+            size++;
+        }
+    }
+
+    Poly result = PolyAddMonos(size, monos);
+    ArenaRelease(mark);
+
+    return result;
+}
+
+Poly PackedPolyAt(const PackedPoly *packed, poly_coeff_t x) {
+    const PackedNode *nodes = packed->nodes;
+
+    if (nodes[0].isCoeff) {
+
+        return PolyFromCoeff(nodes[0].coeff);
+    }
+
+    ArenaMark mark = ArenaGetMark();
+    PackedTerm *terms = ArenaAlloc(nodes[0].size * sizeof(PackedTerm));
+    unsigned long power = 1;
+    poly_exp_t previous = 0;
+    size_t child = 1;
+
+    for (size_t k = 0; k < nodes[0].size; k++) {
+        power *= (unsigned long) CoeffPow(x, nodes[child].exp - previous);
+        previous = nodes[child].exp;
+        terms[k] = (PackedTerm) {.node = child, .weight = power, .exp = 0};
+        child += nodes[child].length;
+    }
+
+    Poly result = PackedCombine(nodes, terms, nodes[0].size);
+    ArenaRelease(mark);
+
+    return result;
+}
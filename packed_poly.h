@@ -0,0 +1,110 @@
+#ifndef POPRAWKA_DUZE_ZADANIE_PACKED_POLY_H
+#define POPRAWKA_DUZE_ZADANIE_PACKED_POLY_H
+/** @file
+  Interfejs spakowanej, niemodyfikowalnej postaci wielomianów rzadkich wielu
+  zmiennych
+
+  @authors Jakub Krakowiak <jk429351@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+#include "poly.h"
+
+/**
+ * To jest struktura przechowująca węzeł spakowanego wielomianu. Węzeł jest
+ * współczynnikiem liczbowym albo wielomianem, którego jednomiany zajmują
+ * kolejne poddrzewa za węzłem. Każdy węzeł poza korzeniem jest
+ * współczynnikiem jednomianu o wykładniku @p exp.
+ */
+typedef struct PackedNode {
+    union {
+        poly_coeff_t coeff; ///< współczynnik liczbowy
+        size_t size; ///< liczba jednomianów
+    };
+    size_t length; ///< liczba węzłów poddrzewa łącznie z tym węzłem
+    poly_exp_t exp; ///< wykładnik jednomianu; w korzeniu zero
+    bool isCoeff; ///< czy węzeł jest współczynnikiem liczbowym
+} PackedNode;
+
+/**
+ * To jest struktura przechowująca spakowany wielomian: całe drzewo
+ * wielomianu zapisane w jednym ciągłym bloku pamięci w kolejności pre-order.
+ * Zamiast wskaźników węzły przechowują długości poddrzew, więc następny
+ * jednomian węzła o indeksie @f$i@f$ zaczyna się pod indeksem
+ * @f$i + length@f$. Równe wielomiany mają identyczne ciągi węzłów.
+ */
+typedef struct PackedPoly {
+    size_t length; ///< liczba węzłów
+    PackedNode nodes[]; ///< węzły w kolejności pre-order
+} PackedPoly;
+
+/**
+ * Pakuje wielomian do jednego bloku pamięci.
+ * @param[in] p : wielomian @f$p@f$
+ * @return spakowany wielomian niezależny od @p p
+ */
+PackedPoly *PolyPack(const Poly *p);
+
+/**
+ * Wylicza, ile pamięci zajmie wielomian po spakowaniu, bez pakowania go.
+ * @param[in] p : wielomian @f$p@f$
+ * @return wielkość pamięci w bajtach
+ */
+size_t PolyPackedBytes(const Poly *p);
+
+/**
+ * Odtwarza wielomian ze spakowanej postaci.
+ * @param[in] packed : spakowany wielomian @f$packed@f$
+ * @return wielomian równy spakowanemu
+ */
+Poly PolyUnpack(const PackedPoly *packed);
+
+/**
+ * Zwraca wielkość pamięci zajmowanej przez spakowany wielomian.
+ * @param[in] packed : spakowany wielomian @f$packed@f$
+ * @return wielkość pamięci w bajtach
+ */
+size_t PackedPolyBytes(const PackedPoly *packed);
+
+/**
+ * Usuwa spakowany wielomian z pamięci. Dopuszcza wartość NULL.
+ * @param[in] packed : spakowany wielomian @f$packed@f$
+ */
+void PackedPolyDestroy(PackedPoly *packed);
+
+/**
+ * Zwraca stopień spakowanego wielomianu, tak jak PolyDeg.
+ * @param[in] packed : spakowany wielomian @f$packed@f$
+ * @return stopień wielomianu
+ */
+poly_exp_t PackedPolyDeg(const PackedPoly *packed);
+
+/**
+ * Zwraca stopień spakowanego wielomianu ze względu na zadaną zmienną, tak
+ * jak PolyDegBy. Poddrzewa głębsze niż zmienna są przeskakiwane.
+ * @param[in] packed : spakowany wielomian @f$packed@f$
+ * @param[in] var_idx : indeks zmiennej @f$var\_idx@f$
+ * @return stopień wielomianu ze względu na zmienną o indeksie @p var_idx
+ */
+poly_exp_t PackedPolyDegBy(const PackedPoly *packed, size_t var_idx);
+
+/**
+ * Sprawdza równość dwóch spakowanych wielomianów jednym przejściem po
+ * ciągach węzłów.
+ * @param[in] p : spakowany wielomian @f$p@f$
+ * @param[in] q : spakowany wielomian @f$q@f$
+ * @return @f$p = q@f$
+ */
+bool PackedPolyIsEq(const PackedPoly *p, const PackedPoly *q);
+
+/**
+ * Wylicza wartość spakowanego wielomianu w punkcie @p x, tak jak PolyAt.
+ * Wielomian jest wartościowany bezpośrednio na węzłach, bez odtwarzania
+ * współczynników: alokowane są tylko tablice jednomianów wyniku.
+ * @param[in] packed : spakowany wielomian @f$packed@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return @f$p(x, x_1, x_2, \ldots)@f$
+ */
+Poly PackedPolyAt(const PackedPoly *packed, poly_coeff_t x);
+
+#endif //POPRAWKA_DUZE_ZADANIE_PACKED_POLY_H
@@ -7,48 +7,649 @@
 */
 #include "poly.h"
 #include "data_structures.h"
+#include "ntt.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
+
+/** To jest makrodefinicja reprezentująca liczbę iloczynów jednomianów, od
+ * której mnożenie rzadkich wielomianów wykonywane jest za pomocą kopca. */
+#define HEAP_MUL_THRESHOLD 1024
+
+/** To jest makrodefinicja reprezentująca największą średnią liczbę iloczynów
+ * jednomianów przypadających na jeden możliwy wykładnik iloczynu, przy
+ * której czynniki uznawane są za rzadkie. */
+#define HEAP_MUL_DENSITY 4
+
+/** To jest makrodefinicja reprezentująca maksymalną liczbę zmiennych
+ * wielomianów mnożonych przez podstawienie Kroneckera. */
+#define KRONECKER_MAX_VARS 8
+
+/** To jest makrodefinicja reprezentująca maksymalną długość wektora
+ * współczynników iloczynu przy podstawieniu Kroneckera. */
+#define KRONECKER_MAX_LENGTH (1 << 22)
+
+/** To jest makrodefinicja reprezentująca minimalną liczbę iloczynów
+ * współczynników, od której opłaca się podstawienie Kroneckera. */
+#define KRONECKER_MIN_PRODUCTS 256
+
+/** To jest makrodefinicja reprezentująca dopuszczalny stosunek długości
+ * wektora współczynników do liczby iloczynów współczynników. */
+#define KRONECKER_DENSITY 4
+
+/** To jest makrodefinicja reprezentująca domyślną liczbę współczynników
+ * mniejszego czynnika, od której gęste wielomiany mnożone są za pomocą NTT. */
+#define DEFAULT_NTT_THRESHOLD 2048
+
+/** To jest zmienna przechowująca liczbę współczynników mniejszego czynnika,
+ * od której gęste wielomiany mnożone są za pomocą NTT. */
+static size_t nttThreshold = DEFAULT_NTT_THRESHOLD;
+
+/** To jest makrodefinicja reprezentująca liczbę iloczynów jednomianów, od
+ * której mnożenie jest rozdzielane między wątki. */
+#define PARALLEL_MUL_THRESHOLD (1 << 15)
+
+/** To jest makrodefinicja reprezentująca największy wykładnik, do którego
+ * dwumian o współczynnikach niebędących liczbami jest potęgowany ze wzoru
+ * dwumianowego Newtona. Wzór przechowuje wszystkie potęgi jednego ze
+ * współczynników, więc dla większych wykładników używane jest szybkie
+ * potęgowanie. */
+#define BINOMIAL_MAX_POLY_POWERS 64
+
+/** To jest makrodefinicja reprezentująca maksymalną liczbę wątków używanych
+ * przy mnożeniu. */
+#define MAX_THREADS 256
+
+/** To jest makrodefinicja reprezentująca nazwę zmiennej środowiskowej
+ * z liczbą wątków używanych przy mnożeniu. */
+#define THREADS_ENV "POLY_THREADS"
+
+/** To jest zmienna przechowująca liczbę wątków używanych przy mnożeniu. */
+static size_t threadCount = 1;
+
+/** To jest zmienna gwarantująca jednokrotne odczytanie zmiennej
+ * środowiskowej THREADS_ENV. */
+static pthread_once_t threadCountOnce = PTHREAD_ONCE_INIT;
+
+/** To jest zmienna mówiąca, czy bieżący wątek wykonuje część równoległego
+ * mnożenia. Takie wątki nie rozdzielają dalej swojej pracy. */
+static _Thread_local bool insideWorker = false;
+
+/** To jest zmienna mówiąca, czy bieżący wątek mnoży wielomiany, dla których
+ * podstawienie Kroneckera zostało już odrzucone. Mnożenia współczynników
+ * wykonywane w ramach takiego mnożenia nie sprawdzają go ponownie. */
+static _Thread_local bool kroneckerRejected = false;
+
+/** To jest zmienna mówiąca, czy od ostatniego wywołania PolyExpOverflowClear
+ * któraś operacja dała wykładnik większy niż INT_MAX. */
+static atomic_bool expOverflow;
+
+/**
+ * To jest unia przechowująca nagłówek tablicy jednomianów. Nagłówek leży
+ * w pamięci bezpośrednio przed tablicą i przechowuje liczbę wielomianów,
+ * które ją współdzielą. Współdzielona tablica nie może być modyfikowana.
+ * Tablica internowana jest dodatkowo zapisana w tablicy haszującej i również
+ * nie może być modyfikowana.
+ */
+typedef union MonoArrayHeader {
+    struct {
+        atomic_size_t refs; ///< liczba wielomianów współdzielących tablicę
+        atomic_bool interned; ///< czy tablica jest internowana
+        size_t hash; ///< skrót internowanej tablicy
+        size_t capacity; ///< liczba jednomianów, na które zaalokowano tablicę
+    };
+    max_align_t align; ///< wyrównanie tablicy jednomianów
+} MonoArrayHeader;
+
+/** To jest makrodefinicja reprezentująca początkową liczbę miejsc tablicy
+ * haszującej internowanych tablic jednomianów. */
+#define INTERN_STARTING_CAPACITY 1024
+
+/**
+ * To jest struktura przechowująca miejsce tablicy haszującej internowanych
+ * tablic jednomianów.
+ */
+typedef struct InternSlot {
+    Mono *arr; ///< NULL, usunięte miejsce lub internowana tablica jednomianów
+    size_t size; ///< liczba jednomianów internowanej tablicy
+} InternSlot;
+
+/**
+ * To jest struktura przechowująca tablicę haszującą internowanych tablic
+ * jednomianów z adresowaniem otwartym. Tablica nie zwiększa liczby odwołań
+ * do internowanych tablic - usuwana tablica jednomianów sama się z niej
+ * wypisuje.
+ */
+typedef struct InternTable {
+    InternSlot *slots; ///< miejsca tablicy
+    size_t capacity; ///< liczba miejsc, potęga dwójki
+    size_t used; ///< liczba miejsc niebędących NULL
+    size_t count; ///< liczba internowanych tablic jednomianów
+} InternTable;
+
+/** To jest zmienna przechowująca tablicę internowanych tablic jednomianów. */
+static InternTable internTable = {.slots = NULL, .capacity = 0, .used = 0,
+        .count = 0};
+
+/** To jest zmienna chroniąca tablicę internowanych tablic jednomianów. */
+static pthread_mutex_t internMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** To jest zmienna, której adres oznacza usunięte miejsce tablicy
+ * haszującej. */
+static Mono internRemoved;
+
+/**
+ * Zwraca nagłówek tablicy jednomianów.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ * @return nagłówek tablicy @p arr
+ */
+MonoArrayHeader *MonoArrayHeaderOf(const Mono *arr) {
+    return (MonoArrayHeader *) arr - 1;
+}
+
+/**
+ * Wylicza wielkość pamięci zajmowanej przez tablicę jednomianów wraz
+ * z nagłówkiem.
+ * @param[in] capacity : liczba jednomianów @f$capacity@f$
+ * @return wielkość pamięci w bajtach
+ */
+size_t MonoArrayBytes(size_t capacity) {
+    return sizeof(MonoArrayHeader) + capacity * sizeof(Mono);
+}
+
+/**
+ * Sprawdza przed alokacją, czy tablica jednomianów zmieści się w limicie
+ * pamięci.
+ * @param[in] capacity : liczba jednomianów @f$capacity@f$
+ * @return czy tablica zmieści się w limicie
+ */
+bool MonoArrayReserve(size_t capacity) {
+    if (capacity > (SIZE_MAX - sizeof(MonoArrayHeader)) / sizeof(Mono)) {
+
+        return MemoryReserve(SIZE_MAX);
+    }
+
+    return MemoryReserve(MonoArrayBytes(capacity));
+}
+
+/**
+ * Alokuje tablicę jednomianów wraz z nagłówkiem z puli pamięci. Tylko tak zaalokowane
+ * tablice mogą trafić do wielomianów. Nie sprawdza limitu pamięci: tablice,
+ * których rozmiar zależy od wyniku obliczeń, trzeba wcześniej sprawdzić
+ * funkcją MonoArrayReserve i przerwać obliczenia, jeśli się nie zmieszczą.
+ * @param[in] size : liczba jednomianów @f$size@f$
+ * @return tablica jednomianów, do której odwołuje się jeden wielomian
+ */
+Mono *MonoArrayAlloc(size_t size) {
+    MonoArrayHeader *header = securePoolMalloc(MonoArrayBytes(size));
+    atomic_init(&header->refs, 1);
+    atomic_init(&header->interned, false);
+    header->capacity = size;
+    MemoryMonosAllocated(size);
+
+    return (Mono *) (header + 1);
+}
+
+/**
+ * Zwalnia niewspółdzieloną tablicę jednomianów, nie usuwając jednomianów,
+ * które zostały z niej przeniesione. Dopuszcza wartość NULL.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ */
+void MonoArrayFree(Mono *arr) {
+    if (arr != NULL) {
+        assert(atomic_load(&MonoArrayHeaderOf(arr)->refs) == 1);
+        MemoryMonosFreed(MonoArrayHeaderOf(arr)->capacity);
+        securePoolFree(MonoArrayHeaderOf(arr), MonoArrayBytes
+                (MonoArrayHeaderOf(arr)->capacity));
+    }
+}
+
+/**
+ * Zapewnia miejsce na kolejny jednomian niewspółdzielonej tablicy. Pełną
+ * tablicę zastępuje tablicą dwukrotnie większą, alokowaną funkcją
+ * MonoArrayAlloc, i przenosi do niej jednomiany. Jeśli większa tablica nie
+ * zmieści się w limicie pamięci, nie alokuje jej i pozostawia @p arr bez
+ * zmian.
+ * @param[in] arr : tablica jednomianów lub NULL @f$arr@f$
+ * @param[in] size : liczba jednomianów w tablicy @f$size@f$
+ * @return tablica mieszcząca co najmniej @p size + 1 jednomianów lub NULL
+ */
+Mono *MonoArrayGrow(Mono *arr, size_t size) {
+    if (arr != NULL && size < MonoArrayHeaderOf(arr)->capacity) {
+
+        return arr;
+    }
+
+    size_t capacity = arr == NULL ? STARTING_ARRAY_SIZE :
+            2 * MonoArrayHeaderOf(arr)->capacity;
+
+    if (!MonoArrayReserve(capacity)) {
+
+        return NULL;
+    }
+
+    Mono *result = MonoArrayAlloc(capacity);
+
+    if (arr != NULL) {
+        memcpy(result, arr, size * sizeof(Mono));
+        MonoArrayFree(arr);
+    }
+
+    return result;
+}
+
+/**
+ * Usuwa jednomiany z początku niewspółdzielonej tablicy i zwalnia tablicę.
+ * Służy do porzucenia częściowego wyniku przerwanych obliczeń. Dopuszcza
+ * wartość NULL.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ * @param[in] size : liczba jednomianów do usunięcia @f$size@f$
+ */
+void MonoArrayAbandon(Mono *arr, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        MonoDestroy(&arr[i]);
+    }
+
+    MonoArrayFree(arr);
+}
+
+bool PolyExpOverflowed(void) {
+    return atomic_load_explicit(&expOverflow, memory_order_relaxed);
+}
+
+void PolyExpOverflowClear(void) {
+    atomic_store(&expOverflow, false);
+}
+
+/**
+ * Dodaje wykładniki. Jeśli suma przekracza INT_MAX, oznacza przekroczenie
+ * zakresu wykładników.
+ * @param[in] a : wykładnik @f$a@f$
+ * @param[in] b : wykładnik @f$b@f$
+ * @param[out] sum : suma @f$a + b@f$, jeśli mieści się w zakresie
+ * @return czy suma mieści się w zakresie
+ */
+bool ExpAdd(poly_exp_t a, poly_exp_t b, poly_exp_t *sum) {
+    if (__builtin_add_overflow(a, b, sum)) {
+        atomic_store_explicit(&expOverflow, true, memory_order_relaxed);
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Mnoży wykładniki. Jeśli iloczyn przekracza INT_MAX, oznacza przekroczenie
+ * zakresu wykładników.
+ * @param[in] a : wykładnik @f$a@f$
+ * @param[in] b : wykładnik @f$b@f$
+ * @param[out] product : iloczyn @f$a b@f$, jeśli mieści się w zakresie
+ * @return czy iloczyn mieści się w zakresie
+ */
+bool ExpMul(poly_exp_t a, poly_exp_t b, poly_exp_t *product) {
+    if (__builtin_mul_overflow(a, b, product)) {
+        atomic_store_explicit(&expOverflow, true, memory_order_relaxed);
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Tworzy wielomian @f$cx_i^n@f$ zapisany bezpośrednio w strukturze.
+ * @param[in] c : współczynnik @f$c@f$, niezerowy
+ * @param[in] n : wykładnik @f$n@f$, dodatni
+ * @return wielomian @f$cx_i^n@f$
+ */
+Poly PolyInlineMono(poly_coeff_t c, poly_exp_t n) {
+    assert(c != 0 && n > 0);
+
+    return (Poly) {.coeff = c, .arr = (Mono *) ((uintptr_t) n << 1 | 1)};
+}
 
 /**
- * Dodaje dwa wielomiany, ale przejmuje je na własność.
+ * Sprawdza, czy wielomian ma tablicę jednomianów z nagłówkiem.
  * @param[in] p : wielomian @f$p@f$
- * @param[in] q : wielomian @f$q@f$
- * @return @f$p + q@f$
+ * @return czy wielomian nie jest współczynnikiem ani jednomianem zapisanym
+ * bezpośrednio w strukturze
+ */
+bool PolyHasArray(const Poly *p) {
+    return !PolyIsCoeff(p) && !PolyIsInline(p);
+}
+
+/**
+ * Daje wielomian niebędący współczynnikiem w postaci tablicy jednomianów.
+ * Dla jednomianu zapisanego bezpośrednio w strukturze tworzy widok, który
+ * podobnie jak fragment tablicy przy mnożeniu równoległym nie ma nagłówka -
+ * nie jest kopiowany ani usuwany.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] view : miejsce na widok @f$view@f$
+ * @param[in] single : miejsce na jednomian widoku @f$single@f$
+ * @return @p p lub widok z tablicą jednomianów @p single
  */
-Poly PolyAddH(Poly *p, Poly *q);
+const Poly *PolyMonoView(const Poly *p, Poly *view, Mono *single) {
+    if (PolyIsInline(p)) {
+        *view = (Poly) {.size = 1, .arr = (Mono *) PolyMonos(p, single)};
 
+        return view;
+    }
+
+    return p;
+}
 
 /**
- * Neguje jednomian, ale przejmuje go na własność.
- * @param[in] m : jednomian @f$m@f$
- * @return @f$-m@f$
+ * Wypisuje internowaną tablicę jednomianów z tablicy haszującej.
+ * @param[in] arr : internowana tablica jednomianów @f$arr@f$
  */
-Mono MonoNeg(Mono *m);
+void InternTableRemove(Mono *arr);
 
 void PolyDestroy(Poly *p) {
-    if (p->arr != NULL) {
+    if (PolyHasArray(p) && atomic_fetch_sub_explicit(&MonoArrayHeaderOf
+            (p->arr)->refs, 1, memory_order_acq_rel) == 1) {
+        if (atomic_load(&MonoArrayHeaderOf(p->arr)->interned)) {
+            InternTableRemove(p->arr);
+        }
+
         for (size_t i = 0; i < p->size; i++) {
             MonoDestroy(&p->arr[i]);
         }
-        free(p->arr);
+        MemoryMonosFreed(MonoArrayHeaderOf(p->arr)->capacity);
+        securePoolFree(MonoArrayHeaderOf(p->arr), MonoArrayBytes
+                (MonoArrayHeaderOf(p->arr)->capacity));
+    }
+}
+
+void PolyMemoryUsage(const Poly *p, size_t *bytes, size_t *arrays,
+                     size_t *monos) {
+    if (PolyHasArray(p)) {
+        size_t capacity = MonoArrayHeaderOf(p->arr)->capacity;
+        *bytes += MonoArrayBytes(capacity);
+        (*arrays)++;
+        *monos += capacity;
+
+        for (size_t i = 0; i < p->size; i++) {
+            PolyMemoryUsage(&p->arr[i].p, bytes, arrays, monos);
+        }
     }
 }
 
 Poly PolyClone(const Poly *p) {
-    Poly result;
-    if (p->arr != NULL) {
-        result.size = p->size;
-        result.arr = secureMalloc(result.size * sizeof(Mono));
+    if (PolyHasArray(p)) {
+        atomic_fetch_add_explicit(&MonoArrayHeaderOf(p->arr)->refs, 1,
+                                  memory_order_relaxed);
+    }
+
+    return *p;
+}
 
-        for (size_t i = 0; i < result.size; ++i) {
-            result.arr[i] = MonoClone(&p->arr[i]);
+/**
+ * Zapewnia, że tablica jednomianów wielomianu nie jest współdzielona z innymi
+ * wielomianami, więc można ją modyfikować. Współdzieloną tablicę zastępuje
+ * kopią, której jednomiany współdzielą swoje współczynniki z oryginałem.
+ * Jednomian zapisany bezpośrednio w strukturze przenosi do nowej tablicy.
+ * @param[in,out] p : wielomian @f$p@f$
+ */
+void PolyUnshare(Poly *p) {
+    if (PolyIsInline(p)) {
+        Mono single;
+        Mono *arr = MonoArrayAlloc(1);
+        arr[0] = *PolyMonos(p, &single);
+        *p = (Poly) {.size = 1, .arr = arr};
+
+        return;
+    } else if (PolyIsCoeff(p) || (atomic_load_explicit(&MonoArrayHeaderOf(p->arr)
+            ->refs, memory_order_acquire) == 1 &&
+            !atomic_load(&MonoArrayHeaderOf(p->arr)->interned))) {
+
+        return;
+    }
+
+    Mono *arr = MonoArrayAlloc(p->size);
+
+    for (size_t i = 0; i < p->size; i++) {
+        arr[i] = MonoClone(&p->arr[i]);
+    }
+
+    Poly copy = (Poly) {.size = p->size, .arr = arr};
+    PolyDestroy(p);
+    *p = copy;
+}
+
+/**
+ * Miesza bity liczby, tak by skróty podobnych tablic jednomianów się różniły.
+ * @param[in] x : liczba @f$x@f$
+ * @return wymieszana liczba
+ */
+size_t HashMix(size_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdUL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53UL;
+    x ^= x >> 33;
+
+    return x;
+}
+
+/**
+ * Wylicza skrót tablicy jednomianów, których współczynniki są liczbami,
+ * jednomianami zapisanymi bezpośrednio w strukturze lub internowanymi
+ * wielomianami. Skrót internowanego współczynnika jest odczytywany
+ * z nagłówka, więc koszt nie zależy od głębokości wielomianu.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ * @param[in] size : liczba jednomianów @f$size@f$
+ * @return skrót tablicy
+ */
+size_t MonoArrayHash(const Mono *arr, size_t size) {
+    size_t hash = HashMix(size);
+
+    for (size_t i = 0; i < size; i++) {
+        const Poly *coeff = &arr[i].p;
+        size_t coeffHash = PolyHasArray(coeff) ? MonoArrayHeaderOf(coeff->arr)
+                ->hash : HashMix((size_t) coeff->coeff) + (size_t) coeff->arr;
+
+        hash = HashMix(hash + (size_t) arr[i].exp);
+        hash = HashMix(hash + coeffHash);
+    }
+
+    return hash;
+}
+
+/**
+ * Sprawdza, czy dwie tablice jednomianów o internowanych współczynnikach są
+ * równe. Współczynniki z tablicami jednomianów porównywane są po adresach.
+ * @param[in] a : tablica jednomianów @f$a@f$
+ * @param[in] b : tablica jednomianów @f$b@f$
+ * @param[in] size : liczba jednomianów obu tablic @f$size@f$
+ * @return czy tablice są równe
+ */
+bool MonoArraysIdentical(const Mono *a, const Mono *b, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (a[i].exp != b[i].exp || a[i].p.arr != b[i].p.arr ||
+            (!PolyHasArray(&a[i].p) && a[i].p.coeff != b[i].p.coeff)) {
+
+            return false;
         }
-    } else { // p->arr == NULL
-        result.arr = NULL;
-        result.coeff = p->coeff;
     }
 
-    return result;
+    return true;
+}
+
+/**
+ * Zwiększa liczbę odwołań do tablicy jednomianów, o ile tablica nie jest
+ * właśnie usuwana.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ * @return czy udało się zwiększyć liczbę odwołań
+ */
+bool MonoArrayTryAcquire(Mono *arr) {
+    atomic_size_t *refs = &MonoArrayHeaderOf(arr)->refs;
+    size_t expected = atomic_load(refs);
+
+    while (expected > 0) {
+        if (atomic_compare_exchange_weak(refs, &expected, expected + 1)) {
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Przebudowuje tablicę haszującą, usuwając z niej oznaczenia usuniętych
+ * miejsc. Wywoływana przy zablokowanym internMutex.
+ */
+void InternTableRebuild(void) {
+    size_t capacity = INTERN_STARTING_CAPACITY;
+
+    while (capacity < 4 * internTable.count) {
+        capacity *= 2;
+    }
+
+    InternSlot *slots = secureMalloc(capacity * sizeof(InternSlot));
+
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i] = (InternSlot) {.arr = NULL, .size = 0};
+    }
+
+    for (size_t i = 0; i < internTable.capacity; i++) {
+        Mono *arr = internTable.slots[i].arr;
+
+        if (arr != NULL && arr != &internRemoved) {
+            size_t j = MonoArrayHeaderOf(arr)->hash & (capacity - 1);
+
+            while (slots[j].arr != NULL) {
+                j = (j + 1) & (capacity - 1);
+            }
+
+            slots[j] = internTable.slots[i];
+        }
+    }
+
+    free(internTable.slots);
+    internTable.slots = slots;
+    internTable.capacity = capacity;
+    internTable.used = internTable.count;
+}
+
+/**
+ * Wyszukuje w tablicy haszującej tablicę jednomianów równą @p arr. Jeśli jej
+ * nie ma, to internuje tablicę @p arr.
+ * @param[in] arr : tablica jednomianów o internowanych współczynnikach
+ * @f$arr@f$
+ * @param[in] size : liczba jednomianów @f$size@f$
+ * @param[in] hash : skrót tablicy @f$hash@f$
+ * @return internowana tablica równa @p arr; jeśli różni się od @p arr, to
+ * odwołanie do niej należy do wywołującego
+ */
+Mono *InternTableFindOrInsert(Mono *arr, size_t size, size_t hash) {
+    pthread_mutex_lock(&internMutex);
+
+    if (2 * (internTable.used + 1) > internTable.capacity) {
+        InternTableRebuild();
+    }
+
+    size_t mask = internTable.capacity - 1;
+    size_t i = hash & mask;
+    InternSlot *removed = NULL;
+
+    while (internTable.slots[i].arr != NULL) {
+        Mono *candidate = internTable.slots[i].arr;
+
+        if (candidate == &internRemoved) {
+            if (removed == NULL) {
+                removed = &internTable.slots[i];
+            }
+        } else if (MonoArrayHeaderOf(candidate)->hash == hash &&
+                   internTable.slots[i].size == size &&
+                   MonoArraysIdentical(candidate, arr, size) &&
+                   MonoArrayTryAcquire(candidate)) {
+            pthread_mutex_unlock(&internMutex);
+
+            return candidate;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    if (removed == NULL) {
+        removed = &internTable.slots[i];
+        internTable.used++;
+    }
+
+    *removed = (InternSlot) {.arr = arr, .size = size};
+    internTable.count++;
+    MonoArrayHeaderOf(arr)->hash = hash;
+    atomic_store(&MonoArrayHeaderOf(arr)->interned, true);
+    pthread_mutex_unlock(&internMutex);
+
+    return arr;
+}
+
+void InternTableRemove(Mono *arr) {
+    pthread_mutex_lock(&internMutex);
+    size_t mask = internTable.capacity - 1;
+    size_t i = MonoArrayHeaderOf(arr)->hash & mask;
+
+    while (internTable.slots[i].arr != arr) {
+        i = (i + 1) & mask;
+    }
+
+    internTable.slots[i].arr = &internRemoved;
+    internTable.count--;
+
+    if (internTable.count == 0) {
+        free(internTable.slots);
+        internTable = (InternTable) {.slots = NULL, .capacity = 0, .used = 0,
+                .count = 0};
+    }
+
+    pthread_mutex_unlock(&internMutex);
+}
+
+/**
+ * Tworzy wielomian z niezerowych jednomianów posortowanych rosnąco po
+ * wykładnikach. Przejmuje na własność tablicę @p arr. Jeśli jedynym
+ * jednomianem jest stała przy wykładniku zero, to zwraca współczynnik,
+ * a jeśli jedynym jednomianem jest liczba przy dodatnim wykładniku, to
+ * zwraca jednomian zapisany bezpośrednio w strukturze.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ * @param[in] size : liczba jednomianów @f$size@f$
+ * @return wielomian złożony z jednomianów tablicy @p arr
+ */
+Poly PolyFromSortedMonos(Mono *arr, size_t size);
+
+Poly PolyIntern(Poly *p) {
+    if (!PolyHasArray(p) || atomic_load(&MonoArrayHeaderOf(p->arr)->interned)) {
+
+        return *p;
+    }
+
+    PolyUnshare(p);
+
+    for (size_t i = 0; i < p->size; i++) {
+        p->arr[i].p = PolyIntern(&p->arr[i].p);
+    }
+
+    *p = PolyFromSortedMonos(p->arr, p->size);
+
+    if (!PolyHasArray(p)) {
+
+        return *p;
+    }
+
+    size_t size = p->size;
+    Mono *arr = InternTableFindOrInsert(p->arr, size, MonoArrayHash(p->arr,
+                                                                    size));
+
+    if (arr != p->arr) {
+        PolyDestroy(p);
+    }
+
+    return (Poly) {.size = size, .arr = arr};
 }
 
 /**
@@ -59,7 +660,7 @@ Poly PolyClone(const Poly *p) {
  */
 Mono MonoAdd(Mono *m, Mono *n) {
     assert(MonoGetExp(m) == MonoGetExp(n));
-    return (Mono) {.p = PolyAddH(&m->p, &n->p), .exp = m->exp};
+    return (Mono) {.p = PolyAddOwn(&m->p, &n->p), .exp = m->exp};
 }
 
 /**
@@ -87,7 +688,7 @@ Poly PolyAddCoeffs(const Poly *p, const Poly *q) {
 void WriteMonoToPoly(const Mono *m, size_t *i, Mono **arr,
                      size_t sizeToAllocate) {
     if (*arr == NULL) {
-        *arr = secureMalloc(sizeToAllocate * sizeof(Mono));
+        *arr = MonoArrayAlloc(sizeToAllocate);
     }
 
     (*arr)[*i] = *m;
@@ -124,6 +725,7 @@ Poly PolyAddCoeffAndNonCoeff (Poly *c, Poly *n) {
         return *n;
     }
 
+    PolyUnshare(n);
     size_t sizeToAllocate = n->size + 1;
     size_t ni = 0; // nonCoeff index
     size_t ri = 0; // result index
@@ -135,22 +737,7 @@ Poly PolyAddCoeffAndNonCoeff (Poly *c, Poly *n) {
 
         ClearZerosFromMonoArray(n->arr, n->size, &ri);
 
-        if (ri == 0) {
-            free(n->arr);
-
-            return PolyZero();
-        } else if (ri == 1 && n->arr[0].exp == 0 && PolyIsCoeff(&(n->arr[0])
-        .p)) {
-            Poly result = PolyFromCoeff(n->arr[0].p.coeff);
-            free(n->arr);
-
-            return result;
-        } else {
-            n->size = ri;
-
-            return *n;
-        }
-
+        return PolyFromSortedMonos(n->arr, ri);
     } else {
         WriteMonoToPoly(&cMono, &ri, &arr, sizeToAllocate);
 
@@ -159,14 +746,14 @@ Poly PolyAddCoeffAndNonCoeff (Poly *c, Poly *n) {
             ni++;
         }
 
-        free(n->arr);
+        MonoArrayFree(n->arr);
 
         if (arr != NULL) {
             Poly result;
 
             if (ri == 1 && arr[0].exp == 0 && PolyIsCoeff(&arr[0].p)) {
                 result = PolyFromCoeff(arr[0].p.coeff);
-                free(arr);
+                MonoArrayFree(arr);
             } else {
                 result.size = ri;
                 result.arr = arr;
@@ -221,27 +808,13 @@ Poly PEatsQ(Poly *p, const Poly *q) {
         pi++;
     }
 
-    free(q->arr);
+    MonoArrayFree(q->arr);
 
     size_t resultSize = 0;
 
     ClearZerosFromMonoArray(p->arr, p->size, &resultSize);
 
-    if (resultSize == 0) {
-        free(p->arr);
-
-        return PolyZero();
-    } else if (resultSize == 1 && p->arr[0].exp == 0 && PolyIsCoeff(&(p->arr[0]
-    .p))) {
-        Poly result = PolyFromCoeff(p->arr[0].p.coeff);
-        free(p->arr);
-
-        return result;
-    } else {
-        p->size = resultSize;
-
-        return *p;
-    }
+    return PolyFromSortedMonos(p->arr, resultSize);
 }
 
 /**
@@ -252,12 +825,23 @@ Poly PEatsQ(Poly *p, const Poly *q) {
  */
 Poly PolyAddNonCoeffs (Poly *p, Poly *q) {
     assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
-    size_t sizeToAllocate = p->size + q->size;
+
+    if (PolyIsInline(p) && p->arr == q->arr) { // ten sam wykładnik
+        poly_coeff_t sum = (poly_coeff_t) ((unsigned long) p->coeff +
+                (unsigned long) q->coeff);
+
+        return sum == 0 ? PolyZero() : (Poly) {.coeff = sum, .arr = p->arr};
+    }
+
     Mono *arr = NULL;
     size_t pi = 0; // p_index
     size_t qi = 0; // q_index
     size_t ri = 0; // result_index
 
+    PolyUnshare(p);
+    PolyUnshare(q);
+    size_t sizeToAllocate = p->size + q->size;
+
     if (PHasAllExpThatQHas(p, q)) {
 
         return PEatsQ(p, q);
@@ -294,28 +878,13 @@ Poly PolyAddNonCoeffs (Poly *p, Poly *q) {
         qi++;
     }
 
-    free(p->arr);
-    free(q->arr);
+    MonoArrayFree(p->arr);
+    MonoArrayFree(q->arr);
 
-    if (arr != NULL) {
-        Poly result;
-
-        if (ri == 1 && arr[0].exp == 0 && PolyIsCoeff(&arr[0].p)) {
-            result = PolyFromCoeff(arr[0].p.coeff);
-            free(arr);
-        } else {
-            result.size = ri;
-            result.arr = arr;
-        }
-
-        return result;
-    } else {
-
-        return PolyZero();
-    }
+    return PolyFromSortedMonos(arr, ri);
 }
 
-Poly PolyAddH(Poly *p, Poly *q) {
+Poly PolyAddOwn(Poly *p, Poly *q) {
     if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
 
         return PolyAddCoeffs(p, q);
@@ -337,7 +906,7 @@ Poly PolyAdd(const Poly *p, const Poly *q) {
     Poly pCopy = PolyClone(p);
     Poly qCopy = PolyClone(q);
 
-    return PolyAddH(&pCopy, &qCopy);
+    return PolyAddOwn(&pCopy, &qCopy);
 }
 
 /**
@@ -364,6 +933,25 @@ int CompareMonos(const void *m, const void *n) {
     }
 }
 
+/**
+ * Sprawdza, czy jednomiany są uporządkowane niemalejąco według wykładników.
+ * Pozwala pominąć sortowanie tablic, które już są uporządkowane, na przykład
+ * wczytanych z wypisanego wcześniej wielomianu.
+ * @param[in] count : liczba jednomianów @f$count@f$
+ * @param[in] monos : tablica jednomianów @f$monos@f$
+ * @return czy tablica jest uporządkowana
+ */
+bool MonosSorted(size_t count, const Mono *monos) {
+    for (size_t i = 1; i < count; i++) {
+        if (monos[i - 1].exp > monos[i].exp) {
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
 /**
  * Łączy za sobą jednomiany o tych samych wykładnikach z tablicy @p monos.
  * @param[in] count : długość tablicy jednomianów przed połączeniem@f$count@f$
@@ -394,6 +982,15 @@ Mono* MonosMerge(size_t count, size_t *resultSize, Mono *monos) {
     return monos;
 }
 
+/**
+ * Sumuje listę jednomianów i tworzy z nich wielomian. Przejmuje na własność
+ * tablicę @p monosCopy zaalokowaną funkcją MonoArrayAlloc i jej zawartość.
+ * @param[in] count : liczba jednomianów @f$count@f$
+ * @param[in] monosCopy : tablica jednomianów @f$monosCopy@f$
+ * @return wielomian będący sumą jednomianów
+ */
+Poly PolyOwnMonoArray(size_t count, Mono *monosCopy);
+
 /**
  * Wykonuje pewną operację na tablicy jednomianów, tworząc wielomian.
  * @param[in] count : długość tablicy jednomianów @f$count@f$
@@ -409,7 +1006,7 @@ Poly PolySthMonos(size_t count, const Mono monos[], bool ifClone) {
         return PolyZero();
     }
 
-    Mono *monosCopy = secureMalloc(count * sizeof(Mono));
+    Mono *monosCopy = MonoArrayAlloc(count);
 
     for (size_t i = 0; i < count; i++) {
         if (ifClone) {
@@ -419,7 +1016,7 @@ Poly PolySthMonos(size_t count, const Mono monos[], bool ifClone) {
         }
     }
 
-    return PolyOwnMonos(count, monosCopy);
+    return PolyOwnMonoArray(count, monosCopy);
 }
 
 Poly PolyAddMonos(size_t count, const Mono monos[]) {
@@ -432,31 +1029,36 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]) {
     return PolySthMonos(count, monos, true);
 }
 
-Poly PolyOwnMonos(size_t count, Mono *monosCopy) {
+Poly PolyOwnMonos(size_t count, Mono *monos) {
+    if (count == 0 || monos == NULL) {
+        free(monos);
 
-    qsort(monosCopy, count, sizeof(Mono), CompareMonos);
+        return PolyZero();
+    }
 
-    size_t resultSize = 0;
-    monosCopy = MonosMerge(count, &resultSize, monosCopy);
+    Mono *monosCopy = MonoArrayAlloc(count);
+    memcpy(monosCopy, monos, count * sizeof(Mono));
+    free(monos);
 
-    if (resultSize == 0) {
-        free(monosCopy);
+    return PolyOwnMonoArray(count, monosCopy);
+}
 
-        return PolyZero();
-    } else {
-        Poly result;
+/**
+ * Sumuje listę jednomianów i tworzy z nich wielomian. Przejmuje na własność
+ * tablicę @p monosCopy zaalokowaną funkcją MonoArrayAlloc i jej zawartość.
+ * @param[in] count : liczba jednomianów @f$count@f$
+ * @param[in] monosCopy : tablica jednomianów @f$monosCopy@f$
+ * @return wielomian będący sumą jednomianów
+ */
+Poly PolyOwnMonoArray(size_t count, Mono *monosCopy) {
+    if (!MonosSorted(count, monosCopy)) {
+        qsort(monosCopy, count, sizeof(Mono), CompareMonos);
+    }
 
-        if (resultSize == 1 && monosCopy[0].exp == 0 && PolyIsCoeff
-                (&monosCopy[0].p)) {
-            result = PolyFromCoeff(monosCopy[0].p.coeff);
-            free(monosCopy);
-        } else {
-            result.size = resultSize;
-            result.arr = monosCopy;
-        }
+    size_t resultSize = 0;
+    monosCopy = MonosMerge(count, &resultSize, monosCopy);
 
-        return result;
-    }
+    return PolyFromSortedMonos(monosCopy, resultSize);
 }
 
 /**
@@ -496,415 +1098,2350 @@ Poly PolyMulCoeffs(const Poly *p, const Poly *q) {
  */
 Poly PolyMulCoeffAndNonCoeff(const Poly *c, const Poly *n) {
     assert(PolyIsCoeff(c) && !PolyIsCoeff(n));
+    Poly result = PolyClone(n);
+    PolyScaleInPlace(&result, c->coeff);
 
-    if (PolyIsZero(c)) {
+    return result;
+}
 
-        return PolyZero();
+/**
+ * To jest struktura przechowująca element kopca używanego przy mnożeniu.
+ * Element odpowiada iloczynowi jednomianu @p i z pierwszego czynnika
+ * i jednomianu @p j z drugiego czynnika.
+ */
+typedef struct HeapEntry {
+    poly_exp_t exp; ///< wykładnik iloczynu jednomianów
+    size_t i; ///< indeks jednomianu w pierwszym czynniku
+    size_t j; ///< indeks jednomianu w drugim czynniku
+} HeapEntry;
+
+/**
+ * Wstawia element do kopca minimalnego względem wykładników.
+ * @param[in] heap : kopiec @f$heap@f$
+ * @param[in] heapSize : liczba elementów kopca @f$heapSize@f$
+ * @param[in] entry : wstawiany element @f$entry@f$
+ */
+void HeapPush(HeapEntry *heap, size_t *heapSize, HeapEntry entry) {
+    size_t i = *heapSize;
+    (*heapSize)++;
+
+    while (i > 0 && heap[(i - 1) / 2].exp > entry.exp) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
     }
 
-    Poly cCopy = PolyClone(c);
-    Mono cMono = MonoFromPoly(&cCopy, 0);
-    Poly nCopy = PolyClone(n);
-    Mono holder;
-    size_t resultI = 0;
+    heap[i] = entry;
+}
+
+/**
+ * Zdejmuje z kopca element o najmniejszym wykładniku.
+ * @param[in] heap : kopiec @f$heap@f$
+ * @param[in] heapSize : liczba elementów kopca @f$heapSize@f$
+ * @return element o najmniejszym wykładniku
+ */
+HeapEntry HeapPop(HeapEntry *heap, size_t *heapSize) {
+    assert(*heapSize > 0);
+    HeapEntry result = heap[0];
+    (*heapSize)--;
+    HeapEntry last = heap[*heapSize];
+    size_t i = 0;
+
+    while (2 * i + 1 < *heapSize) {
+        size_t child = 2 * i + 1;
 
-    for (size_t i = 0; i < n->size; i++) {
-        holder = MonoMul(&cMono, &nCopy.arr[i]);
-        MonoDestroy(&nCopy.arr[i]);
+        if (child + 1 < *heapSize && heap[child + 1].exp < heap[child].exp) {
+            child++;
+        }
 
-        if (!MonoIsZero(&holder)) {
-            nCopy.arr[resultI] = holder;
-            resultI++;
+        if (heap[child].exp >= last.exp) {
+            break;
         }
+
+        heap[i] = heap[child];
+        i = child;
     }
 
-    if (resultI == 0) {
-        free(nCopy.arr);
+    heap[i] = last;
+
+    return result;
+}
+
+/**
+ * Tworzy wielomian z niezerowych jednomianów posortowanych rosnąco po
+ * wykładnikach. Przejmuje na własność tablicę @p arr. Jeśli jedynym
+ * jednomianem jest stała przy wykładniku zero, to zwraca współczynnik,
+ * a jeśli jedynym jednomianem jest liczba przy dodatnim wykładniku, to
+ * zwraca jednomian zapisany bezpośrednio w strukturze.
+ * @param[in] arr : tablica jednomianów @f$arr@f$
+ * @param[in] size : liczba jednomianów @f$size@f$
+ * @return wielomian złożony z jednomianów tablicy @p arr
+ */
+Poly PolyFromSortedMonos(Mono *arr, size_t size) {
+    if (size == 0) {
+        MonoArrayFree(arr);
 
         return PolyZero();
-    } else {
-        nCopy.size = resultI;
+    } else if (size == 1 && arr[0].exp == 0 && PolyIsCoeff(&arr[0].p)) {
+        Poly result = arr[0].p;
+        MonoArrayFree(arr);
+
+        return result;
+    } else if (size == 1 && PolyIsCoeff(&arr[0].p)) {
+        Poly result = PolyInlineMono(arr[0].p.coeff, arr[0].exp);
+        MonoArrayFree(arr);
 
-        return nCopy;
+        return result;
     }
+
+    return (Poly) {.size = size, .arr = arr};
 }
 
 /**
- * Mnoży dwa wielomiany niebędące współczynnikami oraz przejmuje je na własność.
+ * Mnoży dwa wielomiany niebędące współczynnikami algorytmem Johnsona.
+ * Iloczyny jednomianów są generowane za pomocą kopca w kolejności rosnących
+ * wykładników, a iloczyny o równych wykładnikach są od razu sumowane.
+ * Nie wymaga sortowania, a zużycie pamięci jest proporcjonalne do rozmiaru
+ * wyniku i liczby jednomianów mniejszego czynnika. Kopiec i każde
+ * powiększenie tablicy wyniku są sprawdzane w limicie pamięci; jeśli się nie
+ * mieszczą, mnożenie jest przerywane, a wynikiem jest zero.
  * @param[in] p : wielomian @f$p@f$
  * @param[in] q : wielomian @f$q@f$
  * @return @f$p * q@f$
  */
-Poly PolyMulNonCoeffs(const Poly *p, const Poly *q) {
+Poly PolyMulHeap(const Poly *p, const Poly *q) {
     assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
-    Mono *result = NULL;
-    Mono holder;
-    size_t resultI = 0;
+    Mono pSingle, qSingle;
+    Poly pView, qView;
+    p = PolyMonoView(p, &pView, &pSingle);
+    q = PolyMonoView(q, &qView, &qSingle);
+
+    if (p->size > q->size) { // kopiec ma rozmiar mniejszego czynnika
+        const Poly *tmp = p;
+        p = q;
+        q = tmp;
+    }
 
-    for (size_t i = 0; i < p->size; i++) {
-        for (size_t j = 0; j < q->size; j++) {
-            holder = MonoMul(&p->arr[i], &q->arr[j]);
+    if (!MemoryReserve(p->size * sizeof(HeapEntry))) {
 
-            if (!MonoIsZero(&holder)) {
+        return PolyZero(); // wynik i tak zostanie odrzucony
+    }
 
-                if (result == NULL) {
-                    result = secureMalloc(p->size * q->size * sizeof(Mono));
-                }
+    ArenaMark mark = ArenaGetMark();
+    HeapEntry *heap = ArenaAlloc(p->size * sizeof(HeapEntry));
+    size_t heapSize = 0;
+    Mono *result = NULL;
+    size_t resultSize = 0;
 
-                result[resultI] = holder;
-                resultI++;
-            }
-        }
-    }
+    HeapPush(heap, &heapSize, (HeapEntry) {.exp = p->arr[0].exp + q->arr[0]
+    .exp, .i = 0, .j = 0});
 
-    if (result != NULL) {
-        Poly afterReduction = PolyAddMonos(resultI, result);
-        free(result);
+    while (heapSize > 0) {
+        poly_exp_t exp = heap[0].exp;
+        Poly sum = PolyZero();
 
-        return afterReduction;
-    } else {
+        while (heapSize > 0 && heap[0].exp == exp) {
+            HeapEntry e = HeapPop(heap, &heapSize);
+            Poly product = PolyMul(&p->arr[e.i].p, &q->arr[e.j].p);
+            sum = PolyAddOwn(&sum, &product);
 
-        return PolyZero();
-    }
-}
+            if (e.j == 0 && e.i + 1 < p->size) {
+                HeapPush(heap, &heapSize, (HeapEntry) {.exp = p->arr[e.i + 1]
+                        .exp + q->arr[0].exp, .i = e.i + 1, .j = 0});
+            }
 
-Poly PolyMul(const Poly *p, const Poly *q) {
-    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+            if (e.j + 1 < q->size) {
+                HeapPush(heap, &heapSize, (HeapEntry) {.exp = p->arr[e.i].exp +
+                        q->arr[e.j + 1].exp, .i = e.i, .j = e.j + 1});
+            }
+        }
 
-        return PolyMulCoeffs(p, q);
-    } else {
-        if (PolyIsCoeff(p)) {
+        if (!PolyIsZero(&sum)) {
+            Mono *grown = MonoArrayGrow(result, resultSize);
 
-            return PolyMulCoeffAndNonCoeff(p, q);
-        } else if (PolyIsCoeff(q)) {
+            if (grown == NULL) {
+                PolyDestroy(&sum);
+                MonoArrayAbandon(result, resultSize);
+                ArenaRelease(mark);
 
-            return PolyMulCoeffAndNonCoeff(q, p);
-        } else {
+                return PolyZero(); // wynik i tak zostanie odrzucony
+            }
 
-            return PolyMulNonCoeffs(p, q);
+            result = grown;
+            result[resultSize] = MonoFromPoly(&sum, exp);
+            resultSize++;
         }
     }
+
+    ArenaRelease(mark);
+
+    return PolyFromSortedMonos(result, resultSize);
 }
 
 /**
- * Sprawdza, czy jednomiany mają te same wartości.
- * @param[in] m : jednomian @f$m@f$
- * @param[in] n : jednomian @f$n@f$
- * @return @f$m == n@f$
+ * Sprawdza, czy czynniki są na tyle rzadkie, że ich iloczyny jednomianów
+ * rzadko mają równe wykładniki. Wtedy mnożenie za pomocą kopca nie traci
+ * czasu na sumowanie wielu iloczynów o tym samym wykładniku.
+ * @param[in] p : wielomian w postaci tablicy jednomianów @f$p@f$
+ * @param[in] q : wielomian w postaci tablicy jednomianów @f$q@f$
+ * @return czy na jeden możliwy wykładnik iloczynu przypada średnio nie
+ * więcej niż HEAP_MUL_DENSITY iloczynów jednomianów
  */
-bool MonoIsEq(const Mono *m, const Mono *n) {
-    return PolyIsEq(&m->p, &n->p) && m->exp == n->exp;
+bool PolyMulIsSparse(const Poly *p, const Poly *q) {
+    size_t span = (size_t) (p->arr[p->size - 1].exp - p->arr[0].exp) +
+            (size_t) (q->arr[q->size - 1].exp - q->arr[0].exp) + 1;
+
+    return p->size * q->size <= span * HEAP_MUL_DENSITY;
 }
 
 /**
- * Sprawdza czy dwa wielomiany będące współczynnikami są równe.
- * @param[in] p : wielomian @f$p@f$
- * @param[in] q : wielomian @f$q@f$
- * @return @f$p == q@f$
+ * To jest struktura opisująca wielomian przy podstawieniu Kroneckera.
+ * Przechowuje liczbę zmiennych, maksymalne wykładniki przy kolejnych
+ * zmiennych i liczbę niezerowych współczynników liczbowych.
  */
-bool PolyIsEqCoeffs(const Poly *p, const Poly *q) {
-    assert(PolyIsCoeff(p) && PolyIsCoeff(q));
-
-    return p->coeff == q->coeff;
-}
+typedef struct KroneckerShape {
+    size_t vars; ///< liczba zmiennych, czyli głębokość drzewa wielomianu
+    poly_exp_t deg[KRONECKER_MAX_VARS]; ///< maksymalne wykładniki zmiennych
+    size_t terms; ///< liczba współczynników liczbowych
+    bool fits; ///< czy wielomian ma co najwyżej KRONECKER_MAX_VARS zmiennych
+} KroneckerShape;
 
 /**
- * Sprawdza czy dwa wielomiany niebędące współczynnikami są równe.
+ * Wyznacza kształt wielomianu, przechodząc jego drzewo.
  * @param[in] p : wielomian @f$p@f$
- * @param[in] q : wielomian @f$q@f$
- * @return @f$p == q@f$
+ * @param[in] level : indeks zmiennej wielomianu @p p @f$level@f$
+ * @param[in] shape : wyznaczany kształt @f$shape@f$
  */
-bool PolyIsEqNonCoeffs(const Poly *p, const Poly *q) {
-    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+void KroneckerShapeOf(const Poly *p, size_t level, KroneckerShape *shape) {
+    if (PolyIsCoeff(p)) {
+        shape->terms++;
 
-    if (p->size == q->size) {
+        if (level > shape->vars) {
+            shape->vars = level;
+        }
 
-        for (size_t i = 0; i < p->size; i++) {
+        return;
+    }
 
-            if (!MonoIsEq(&p->arr[i], &q->arr[i])) {
+    if (level >= KRONECKER_MAX_VARS) {
+        shape->fits = false;
 
-                return false;
-            }
-        }
+        return;
+    }
 
-        return true;
-    } else {
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
 
-        return false;
+    for (size_t i = 0; i < p->size && shape->fits; i++) {
+        if (p->arr[i].exp > shape->deg[level]) {
+            shape->deg[level] = p->arr[i].exp;
+        }
+
+        KroneckerShapeOf(&p->arr[i].p, level + 1, shape);
     }
 }
 
-bool PolyIsEq(const Poly *p, const Poly *q) {
-    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
-
-        return PolyIsEqCoeffs(p, q);
-    } else if (!PolyIsCoeff(p) && !PolyIsCoeff(q)) {
-
-        return PolyIsEqNonCoeffs(p, q);
+/**
+ * Zapisuje współczynniki liczbowe wielomianu jako listę par (indeks,
+ * współczynnik) w jednowymiarowym wektorze otrzymanym z podstawienia
+ * Kroneckera.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] level : indeks zmiennej wielomianu @p p @f$level@f$
+ * @param[in] base : indeks odpowiadający dotychczasowym wykładnikom
+ * @f$base@f$
+ * @param[in] stride : odległości w wektorze między kolejnymi potęgami
+ * zmiennych @f$stride@f$
+ * @param[in] index : tablica indeksów @f$index@f$
+ * @param[in] coeffs : tablica współczynników @f$coeffs@f$
+ * @param[in] count : liczba zapisanych współczynników @f$count@f$
+ */
+void KroneckerPack(const Poly *p, size_t level, size_t base, const size_t
+*stride, size_t *index, poly_coeff_t *coeffs, size_t *count) {
+    if (PolyIsCoeff(p)) {
+        index[*count] = base;
+        coeffs[*count] = p->coeff;
+        (*count)++;
     } else {
+        Mono single;
+        Poly view;
+        p = PolyMonoView(p, &view, &single);
 
-        return false;
+        for (size_t i = 0; i < p->size; i++) {
+            KroneckerPack(&p->arr[i].p, level + 1, base + (size_t)p->arr[i]
+            .exp * stride[level], stride, index, coeffs, count);
+        }
     }
 }
 
 /**
- * Neguje wartość wielomianu oraz przejmuje go na własność.
- * @param[in] pCopy : wielomian @f$pCopy@f$
- * @return @f$-pCopy@f$
+ * Odtwarza wielomian w postaci rekurencyjnej z jednowymiarowego wektora
+ * współczynników otrzymanego z podstawienia Kroneckera.
+ * @param[in] flat : wektor współczynników @f$flat@f$
+ * @param[in] level : indeks odtwarzanej zmiennej @f$level@f$
+ * @param[in] vars : liczba zmiennych @f$vars@f$
+ * @param[in] base : indeks odpowiadający dotychczasowym wykładnikom
+ * @f$base@f$
+ * @param[in] stride : odległości w wektorze między kolejnymi potęgami
+ * zmiennych @f$stride@f$
+ * @param[in] length : liczba potęg kolejnych zmiennych @f$length@f$
+ * @param[in] buffers : tablice pomocnicze na jednomiany, po jednej dla każdej
+ * zmiennej @f$buffers@f$
+ * @return wielomian o współczynnikach z wektora @p flat
  */
-Poly PolyNegH(Poly *pCopy) {
-    if (PolyIsCoeff(pCopy)) {
-        pCopy->coeff = (-1) * pCopy->coeff;
-    } else {
-        for (size_t i = 0; i < pCopy->size; i++) {
-            pCopy->arr[i] = MonoNeg(&pCopy->arr[i]);
-        }
+Poly KroneckerUnpack(const unsigned long *flat, size_t level, size_t vars,
+                     size_t base, const size_t *stride, const size_t *length,
+                     Mono **buffers) {
+    if (level == vars) {
+
+        return PolyFromCoeff((poly_coeff_t)flat[base]);
     }
 
-    return *pCopy;
-}
+    size_t count = 0;
 
-Mono MonoNeg(Mono *m) {
+    for (size_t e = 0; e < length[level]; e++) {
+        Poly coeff = KroneckerUnpack(flat, level + 1, vars, base + e *
+                stride[level], stride, length, buffers);
 
-    return (Mono) {.p = PolyNegH(&m->p), .exp = m->exp};
-}
+        if (!PolyIsZero(&coeff)) {
+            buffers[level][count] = MonoFromPoly(&coeff, (poly_exp_t)e);
+            count++;
+        }
+    }
 
-Poly PolyNeg(const Poly *p) {
-    Poly pCopy = PolyClone(p);
+    if (count == 0) {
 
-    return PolyNegH(&pCopy);
-}
+        return PolyZero();
+    } else if (!MonoArrayReserve(count)) {
+        for (size_t i = 0; i < count; i++) {
+            MonoDestroy(&buffers[level][i]);
+        }
 
-Poly PolySub(const Poly *p, const Poly *q) {
-    Poly pCopy = PolyClone(p);
-    Poly qCopy = PolyNeg(q);
+        return PolyZero(); // wynik i tak zostanie odrzucony
+    }
 
-    return PolyAddH(&pCopy, &qCopy);
+    Mono *arr = MonoArrayAlloc(count);
+
+    for (size_t i = 0; i < count; i++) {
+        arr[i] = buffers[level][i];
+    }
+
+    return PolyFromSortedMonos(arr, count);
 }
 
 /**
- * Zwraca stopień wielomianu jednomianu ze względu na zadaną zmienną (-1 dla
- * wielomianu
- * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
- * Zmienna o indeksie 0 oznacza zmienną główną tego wielomianu.
- * Większe indeksy oznaczają zmienne wielomianów znajdujących się
- * we współczynnikach.
- * @param[in] m : jednomian
- * @param[in] var_idx : indeks zmiennej
- * @return stopień wielomianu jednomianu @p m z względu na zmienną o indeksie
- * @p var_idx
+ * Mnoży dwa wielomiany niebędące współczynnikami za pomocą podstawienia
+ * Kroneckera, jeśli są one gęste i mają ograniczone stopnie. Wielomiany są
+ * zamieniane na jednowymiarowe wektory współczynników, mnożone w płaskiej
+ * tablicy, a wynik jest zamieniany z powrotem na postać rekurencyjną.
+ * Jeśli na jeden wyraz dłuższego wektora przypada co najmniej nttThreshold
+ * iloczynów współczynników, to splot liczony jest za pomocą NTT; rzadsze
+ * wektory, na przykład wielomiany o ograniczonym stopniu łącznym, mnożone są
+ * bezpośrednio. Tablice pomocnicze każdego etapu są przed
+ * alokacją sprawdzane w limicie pamięci; jeśli się nie mieszczą, mnożenie
+ * jest przerywane, a wynikiem jest zero.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] result : iloczyn @f$p * q@f$, jeśli udało się go wyznaczyć
+ * @f$result@f$
+ * @return Czy wielomiany zostały pomnożone tą metodą?
  */
-poly_exp_t MonoDegBy(const Mono *m, size_t var_idx) {
-    if (var_idx == 0) {
-        return m->exp;
-    } else {
-        return PolyDegBy(&m->p, var_idx - 1);
-    }
-}
+bool PolyMulKronecker(const Poly *p, const Poly *q, Poly *result) {
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    KroneckerShape ps = {.vars = 0, .deg = {0}, .terms = 0, .fits = true};
+    KroneckerShape qs = {.vars = 0, .deg = {0}, .terms = 0, .fits = true};
 
-poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
-    if (PolyIsZero(p)) {
+    KroneckerShapeOf(p, 0, &ps);
+    KroneckerShapeOf(q, 0, &qs);
 
-        return -1;
+    if (!ps.fits || !qs.fits ||
+        ps.terms * qs.terms < KRONECKER_MIN_PRODUCTS) {
+
+        return false;
     }
 
-    if (PolyIsCoeff(p)) {
+    size_t vars = ps.vars > qs.vars ? ps.vars : qs.vars;
+    size_t stride[KRONECKER_MAX_VARS];
+    size_t length[KRONECKER_MAX_VARS];
+    size_t total = 1;
 
-        return 0;
-    } else {
-        poly_exp_t result = 0;
+    for (size_t v = vars; v > 0; v--) {
+        if (ps.deg[v - 1] > INT_MAX - qs.deg[v - 1]) {
+            // wykładnik iloczynu nie mieści się w zakresie, co zgłosi
+            // mnożenie bez podstawienia
 
-        for (size_t i = 0; i < p->size; i++) {
-            poly_exp_t holder = MonoDegBy(&p->arr[i], var_idx);
+            return false;
+        }
 
-            if ( holder > result) {
-                result = holder;
-            }
+        length[v - 1] = (size_t)ps.deg[v - 1] + (size_t)qs.deg[v - 1] + 1;
+        stride[v - 1] = total;
+
+        if (length[v - 1] > KRONECKER_MAX_LENGTH / total) {
+
+            return false;
         }
 
-        return result;
+        total *= length[v - 1];
     }
-}
 
-/**
- * Zwraca stopień wielomianu jednomianu (-1 dla wielomianu tożsamościowo
- * równego zeru).
- * @param[in] m : jednomian
- * @return stopień wielomianu jednomianu @p m
- */
-poly_exp_t MonoDeg(const Mono *m) {
-    return PolyDeg(&m->p) + m->exp;
-}
+    if (total > ps.terms * qs.terms * KRONECKER_DENSITY) { // wynik rzadki
 
-poly_exp_t PolyDeg(const Poly *p) {
-    if (PolyIsZero(p)) {
+        return false;
+    }
 
-        return -1;
+    if (ps.terms > qs.terms) { // pętla zewnętrzna po mniejszym czynniku
+        const Poly *tmpPoly = p;
+        p = q;
+        q = tmpPoly;
+        KroneckerShape tmpShape = ps;
+        ps = qs;
+        qs = tmpShape;
     }
 
-    if (PolyIsCoeff(p)) {
+    if (!MemoryReserve((ps.terms + qs.terms) * (sizeof(size_t) +
+                       sizeof(poly_coeff_t)) + total * sizeof(unsigned long))) {
+        *result = PolyZero(); // wynik i tak zostanie odrzucony
 
-        return 0;
-    } else {
-        poly_exp_t result = 0;
+        return true;
+    }
 
-        for (size_t i = 0; i < p->size; i++) {
-            poly_exp_t holder = MonoDeg(&p->arr[i]);
+    ArenaMark mark = ArenaGetMark();
+    size_t *pIndex = ArenaAlloc(ps.terms * sizeof(size_t));
+    poly_coeff_t *pCoeffs = ArenaAlloc(ps.terms * sizeof(poly_coeff_t));
+    size_t *qIndex = ArenaAlloc(qs.terms * sizeof(size_t));
+    poly_coeff_t *qCoeffs = ArenaAlloc(qs.terms * sizeof(poly_coeff_t));
+    unsigned long *flat = ArenaAlloc(total * sizeof(unsigned long));
+    size_t pCount = 0;
+    size_t qCount = 0;
 
-            if ( holder > result) {
-                result = holder;
-            }
-        }
+    KroneckerPack(p, 0, 0, stride, pIndex, pCoeffs, &pCount);
+    KroneckerPack(q, 0, 0, stride, qIndex, qCoeffs, &qCount);
 
-        return result;
+    for (size_t i = 0; i < total; i++) {
+        flat[i] = 0;
     }
-}
 
-/**
- * Podnosi @p x do potęgi @p n.
- * @param[in] x : zmienna @f$x@f$
- * @param[in] n : wykładnik @f$n@f$
- * @return @f$x^n@f$
- */
-poly_coeff_t Power(poly_coeff_t x, poly_exp_t n) {
-    if (x == 0) {
-        return 0;
-    }
+    size_t pLength = pIndex[pCount - 1] + 1;
+    size_t qLength = qIndex[qCount - 1] + 1;
+    size_t bufferBytes = 0;
 
-    poly_coeff_t result = 1;
-    for (poly_exp_t i = 0; i < n; i++) {
-        result *= x;
+    for (size_t v = 0; v < vars; v++) {
+        bufferBytes += length[v] * sizeof(Mono);
     }
 
-    return result;
-}
+    // NTT opłaca się, gdy na jeden wyraz dłuższego wektora przypada dość
+    // iloczynów współczynników - dla gęstych wektorów to po prostu liczba
+    // współczynników mniejszego czynnika
+    size_t longer = pLength > qLength ? pLength : qLength;
+    bool ntt = pCount * qCount / longer >= nttThreshold;
+    bool qDense = !ntt && qCount * KRONECKER_DENSITY >= qLength;
 
-/**
- * Wylicza wartość jednomianu w zadanym pukcie i zapisuje pod zmienną @p result
- * @param[in] m : jednomian @f$m@f$
- * @param[in] x : zmienna @f$x@f$
- * @param[in] result : wynik @f$result@f$
- */
-void MonoAt(const Mono *m, poly_coeff_t x, Poly *result) {
-    poly_coeff_t newCoeff = Power(x, m->exp);
-    Poly polyFromCoeff = PolyFromCoeff(newCoeff);
-    Poly afterMul = PolyMul(&m->p, &polyFromCoeff);
-    Poly holder = PolyAdd(result, &afterMul);
-    PolyDestroy(&afterMul);
-    PolyDestroy(result);
-    (*result) = holder;
+    if (!MemoryReserve(bufferBytes + (ntt ? (pLength + qLength) *
+                       sizeof(poly_coeff_t) : qDense ? qLength *
+                       sizeof(unsigned long) : (qCount + 1) *
+                       sizeof(size_t)))) {
+        ArenaRelease(mark);
+        *result = PolyZero(); // wynik i tak zostanie odrzucony
+
+        return true;
+    }
+
+    if (ntt) {
+        // oba czynniki są duże - splot liczony transformatą NTT; kwadrat
+        // wielomianu przekazywany jest jednym wektorem, co oszczędza jedną
+        // transformatę
+        bool square = p == q || (PolyHasArray(p) && p->arr == q->arr);
+        poly_coeff_t *pFlat = ArenaAlloc(pLength * sizeof(poly_coeff_t));
+        poly_coeff_t *qFlat = square ? pFlat :
+                ArenaAlloc(qLength * sizeof(poly_coeff_t));
+
+        for (size_t i = 0; i < pLength; i++) {
+            pFlat[i] = 0;
+        }
+
+        for (size_t i = 0; i < pCount; i++) {
+            pFlat[pIndex[i]] = pCoeffs[i];
+        }
+
+        if (!square) {
+            for (size_t j = 0; j < qLength; j++) {
+                qFlat[j] = 0;
+            }
+
+            for (size_t j = 0; j < qCount; j++) {
+                qFlat[qIndex[j]] = qCoeffs[j];
+            }
+        }
+
+        if (!NttMultiply(pFlat, pLength, qFlat, qLength, flat)) {
+            ArenaRelease(mark);
+            *result = PolyZero(); // wynik i tak zostanie odrzucony
+
+            return true;
+        }
+    } else if (qDense) {
+        // q jest gęsty - pętla wewnętrzna po ciągłym fragmencie pamięci
+        unsigned long *qFlat = ArenaAlloc(qLength * sizeof(unsigned long));
+
+        for (size_t j = 0; j < qLength; j++) {
+            qFlat[j] = 0;
+        }
+
+        for (size_t j = 0; j < qCount; j++) {
+            qFlat[qIndex[j]] = (unsigned long)qCoeffs[j];
+        }
+
+        for (size_t i = 0; i < pCount; i++) {
+            unsigned long c = (unsigned long)pCoeffs[i];
+            unsigned long *row = flat + pIndex[i];
+
+            for (size_t j = 0; j < qLength; j++) {
+                row[j] += c * qFlat[j];
+            }
+        }
+    } else {
+        // q jest dzielony na serie współczynników o kolejnych indeksach, po
+        // których pętla wewnętrzna przechodzi bez tablicy indeksów
+        size_t *runs = ArenaAlloc((qCount + 1) * sizeof(size_t));
+        size_t runCount = 0;
+
+        for (size_t j = 0; j < qCount; j++) {
+            if (j == 0 || qIndex[j] != qIndex[j - 1] + 1) {
+                runs[runCount] = j;
+                runCount++;
+            }
+        }
+
+        runs[runCount] = qCount;
+
+        for (size_t i = 0; i < pCount; i++) {
+            unsigned long c = (unsigned long)pCoeffs[i];
+            unsigned long *row = flat + pIndex[i];
+
+            for (size_t r = 0; r < runCount; r++) {
+                unsigned long *target = row + qIndex[runs[r]];
+                const poly_coeff_t *source = qCoeffs + runs[r];
+                size_t runLength = runs[r + 1] - runs[r];
+
+                for (size_t k = 0; k < runLength; k++) {
+                    target[k] += c * (unsigned long)source[k];
+                }
+            }
+        }
+    }
+
+    Mono *buffers[KRONECKER_MAX_VARS];
+
+    for (size_t v = 0; v < vars; v++) {
+        buffers[v] = ArenaAlloc(length[v] * sizeof(Mono));
+    }
+
+    *result = KroneckerUnpack(flat, 0, vars, 0, stride, length, buffers);
+    ArenaRelease(mark);
+
+    return true;
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące współczynnikami. Jeśli pamięć potrzebna
+ * wybranej metodzie mnożenia nie zmieści się w limicie pamięci albo suma
+ * największych wykładników przekracza INT_MAX, zwraca zero.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulNonCoeffs(const Poly *p, const Poly *q);
+
+/**
+ * Ustawia liczbę wątków na wartość zmiennej środowiskowej THREADS_ENV,
+ * jeśli jest ona poprawną dodatnią liczbą.
+ */
+void ReadThreadCountFromEnv(void) {
+    const char *value = getenv(THREADS_ENV);
+
+    if (value == NULL || *value < '0' || *value > '9') {
+
+        return;
+    }
+
+    char *end;
+    unsigned long count = strtoul(value, &end, 10);
+
+    if (*end == '\0' && count > 0) {
+        threadCount = count > MAX_THREADS ? MAX_THREADS : count;
+    }
+}
+
+/**
+ * Zwraca liczbę wątków używanych przy mnożeniu.
+ * @return liczba wątków
+ */
+size_t ThreadCount(void) {
+    pthread_once(&threadCountOnce, ReadThreadCountFromEnv);
+
+    return threadCount;
+}
+
+/**
+ * To jest struktura opisująca zadanie wątku przy równoległym mnożeniu:
+ * iloczyn fragmentu pierwszego czynnika i drugiego czynnika.
+ */
+typedef struct MulTask {
+    Poly part; ///< fragment pierwszego czynnika
+    const Poly *q; ///< drugi czynnik
+    Poly result; ///< wynik zadania
+} MulTask;
+
+/**
+ * To jest struktura przechowująca pulę wątków wykonujących zadania
+ * równoległego mnożenia. Wątki są tworzone przy pierwszym mnożeniu, które ich
+ * potrzebuje, i czekają na kolejne zadania aż do wywołania PolyThreadsRelease.
+ */
+typedef struct MulPool {
+    pthread_mutex_t lock; ///< blokada chroniąca pozostałe pola
+    pthread_cond_t work; ///< zmienna warunkowa budząca wątki puli
+    pthread_cond_t done; ///< zmienna warunkowa budząca zlecającego zadania
+    pthread_t threads[MAX_THREADS]; ///< wątki puli
+    size_t started; ///< liczba utworzonych wątków
+    MulTask *tasks; ///< bieżące zadania
+    size_t count; ///< liczba bieżących zadań
+    size_t next; ///< indeks pierwszego niepobranego zadania
+    size_t pending; ///< liczba niezakończonych zadań
+    bool stop; ///< czy wątki puli mają się zakończyć
+} MulPool;
+
+/** To jest zmienna przechowująca pulę wątków mnożenia. */
+static MulPool mulPool = {.lock = PTHREAD_MUTEX_INITIALIZER,
+        .work = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER};
+
+/** To jest zmienna gwarantująca, że z puli wątków korzysta naraz tylko jedno
+ * mnożenie. Pozostałe mnożenia wykonują swoje zadania same. */
+static pthread_mutex_t mulPoolOwner = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Wykonuje zadanie równoległego mnożenia.
+ * @param[in] task : zadanie @f$task@f$
+ */
+void MulTaskRun(MulTask *task) {
+    bool wasInsideWorker = insideWorker;
+    bool wasKroneckerRejected = kroneckerRejected;
+    insideWorker = true;
+    kroneckerRejected = true;
+    task->result = PolyMulNonCoeffs(&task->part, task->q);
+    insideWorker = wasInsideWorker;
+    kroneckerRejected = wasKroneckerRejected;
+}
+
+/**
+ * Pobiera i wykonuje bieżące zadania puli, dopóki jakieś zostały. Wywoływana
+ * z założoną blokadą puli i kończy się z założoną blokadą.
+ */
+void MulPoolDrain(void) {
+    while (mulPool.next < mulPool.count) {
+        MulTask *task = &mulPool.tasks[mulPool.next];
+        mulPool.next++;
+        pthread_mutex_unlock(&mulPool.lock);
+        MulTaskRun(task);
+        pthread_mutex_lock(&mulPool.lock);
+        mulPool.pending--;
+    }
+}
+
+/**
+ * Wykonuje pętlę wątku puli: czeka na zadania i wykonuje je, aż pula
+ * zostanie zatrzymana.
+ * @param[in] arg : nieużywany @f$arg@f$
+ * @return NULL
+ */
+void *MulPoolWorker(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&mulPool.lock);
+
+    while (!mulPool.stop) {
+        if (mulPool.next < mulPool.count) {
+            MulPoolDrain();
+            // arena wątku puli nie może zajmować pamięci między mnożeniami
+            pthread_mutex_unlock(&mulPool.lock);
+            ArenaReset();
+            pthread_mutex_lock(&mulPool.lock);
+
+            if (mulPool.pending == 0) {
+                pthread_cond_signal(&mulPool.done);
+            }
+        } else {
+            pthread_cond_wait(&mulPool.work, &mulPool.lock);
+        }
+    }
+
+    pthread_mutex_unlock(&mulPool.lock);
+
+    return NULL;
+}
+
+/**
+ * Wykonuje zadania w wątkach puli, brakujące wątki tworząc przy pierwszej
+ * potrzebie. Bieżący wątek również pobiera zadania. Jeśli pula jest zajęta
+ * przez inne mnożenie lub nie udało się utworzyć wątków, zadania wykonuje
+ * bieżący wątek.
+ * @param[in] tasks : tablica zadań @f$tasks@f$
+ * @param[in] count : liczba zadań @f$count@f$
+ */
+void RunMulTasks(MulTask *tasks, size_t count) {
+    if (pthread_mutex_trylock(&mulPoolOwner) != 0) {
+        for (size_t i = 0; i < count; i++) {
+            MulTaskRun(&tasks[i]);
+        }
+
+        return;
+    }
+
+    pthread_mutex_lock(&mulPool.lock);
+
+    while (mulPool.started + 1 < count && pthread_create(&mulPool.threads
+            [mulPool.started], NULL, MulPoolWorker, NULL) == 0) {
+        mulPool.started++;
+    }
+
+    mulPool.tasks = tasks;
+    mulPool.count = count;
+    mulPool.next = 0;
+    mulPool.pending = count;
+    pthread_cond_broadcast(&mulPool.work);
+    MulPoolDrain();
+
+    while (mulPool.pending > 0) {
+        pthread_cond_wait(&mulPool.done, &mulPool.lock);
+    }
+
+    mulPool.tasks = NULL;
+    mulPool.count = 0;
+    mulPool.next = 0;
+    pthread_mutex_unlock(&mulPool.lock);
+    pthread_mutex_unlock(&mulPoolOwner);
+}
+
+void PolyThreadsRelease(void) {
+    pthread_mutex_lock(&mulPoolOwner);
+    pthread_mutex_lock(&mulPool.lock);
+    mulPool.stop = true;
+    pthread_cond_broadcast(&mulPool.work);
+    pthread_mutex_unlock(&mulPool.lock);
+
+    for (size_t i = 0; i < mulPool.started; i++) {
+        pthread_join(mulPool.threads[i], NULL);
+    }
+
+    mulPool.started = 0;
+    mulPool.stop = false;
+    pthread_mutex_unlock(&mulPoolOwner);
+}
+
+/**
+ * Scala posortowane iloczyny częściowe w jednym przejściu. Kolejne wykładniki
+ * wybierane są za pomocą kopca, a współczynniki przy równych wykładnikach są
+ * od razu sumowane. Przejmuje na własność wyniki zadań. Tablica wyniku jest
+ * sprawdzana w limicie pamięci; jeśli się nie mieści, wynikiem jest zero.
+ * @param[in] tasks : wykonane zadania @f$tasks@f$
+ * @param[in] count : liczba zadań @f$count@f$
+ * @return suma wyników zadań
+ */
+Poly MulTasksMerge(MulTask *tasks, size_t count) {
+    Mono singles[MAX_THREADS];
+    const Mono *monos[MAX_THREADS];
+    size_t sizes[MAX_THREADS];
+    HeapEntry heap[MAX_THREADS];
+    size_t heapSize = 0;
+    size_t total = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const Poly *part = &tasks[i].result;
+
+        if (PolyIsCoeff(part)) {
+            singles[i] = MonoFromPoly(part, 0);
+            monos[i] = &singles[i];
+            sizes[i] = PolyIsZero(part) ? 0 : 1;
+        } else {
+            monos[i] = PolyMonos(part, &singles[i]);
+            sizes[i] = PolyMonoCount(part);
+        }
+
+        if (sizes[i] > 0) {
+            HeapPush(heap, &heapSize, (HeapEntry) {.exp = monos[i][0].exp,
+                    .i = i, .j = 0});
+        }
+
+        total += sizes[i];
+    }
+
+    if (total == 0 || !MonoArrayReserve(total)) {
+        for (size_t i = 0; i < count; i++) {
+            PolyDestroy(&tasks[i].result);
+        }
+
+        return PolyZero(); // wynik i tak zostanie odrzucony lub jest zerem
+    }
+
+    Mono *result = MonoArrayAlloc(total);
+    size_t resultSize = 0;
+
+    while (heapSize > 0) {
+        poly_exp_t exp = heap[0].exp;
+        Poly sum = PolyZero();
+
+        while (heapSize > 0 && heap[0].exp == exp) {
+            HeapEntry e = HeapPop(heap, &heapSize);
+            Poly coeff = monos[e.i][e.j].p; // jednomian jest przenoszony
+            sum = PolyAddOwn(&sum, &coeff);
+
+            if (e.j + 1 < sizes[e.i]) {
+                HeapPush(heap, &heapSize, (HeapEntry) {.exp = monos[e.i]
+                        [e.j + 1].exp, .i = e.i, .j = e.j + 1});
+            }
+        }
+
+        if (!PolyIsZero(&sum)) {
+            result[resultSize] = MonoFromPoly(&sum, exp);
+            resultSize++;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (PolyHasArray(&tasks[i].result)) {
+            MonoArrayFree(tasks[i].result.arr);
+        }
+    }
+
+    return PolyFromSortedMonos(result, resultSize);
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące współczynnikami przy użyciu wielu wątków.
+ * Jednomiany większego czynnika są dzielone na spójne fragmenty, a każdy
+ * wątek puli wylicza posortowany iloczyn swojego fragmentu z drugim
+ * czynnikiem. Iloczyny częściowe są następnie scalane w jednym przejściu.
+ * Wynik jest identyczny jak przy mnożeniu w jednym wątku.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] threads : liczba wątków @f$threads@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulParallel(const Poly *p, const Poly *q, size_t threads) {
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    Mono pSingle, qSingle;
+    Poly pView, qView;
+    p = PolyMonoView(p, &pView, &pSingle);
+    q = PolyMonoView(q, &qView, &qSingle);
+
+    if (p->size < q->size) { // dzielony jest większy czynnik
+        const Poly *tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    size_t count = threads < p->size ? threads : p->size;
+    MulTask tasks[MAX_THREADS];
+    size_t begin = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t end = p->size * (i + 1) / count;
+        // fragment jest tylko widokiem tablicy bez nagłówka - nie jest
+        // kopiowany ani usuwany
+        tasks[i] = (MulTask) {.part = {.size = end - begin, .arr = p->arr +
+                begin}, .q = q};
+        begin = end;
+    }
+
+    RunMulTasks(tasks, count);
+
+    return MulTasksMerge(tasks, count);
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące współczynnikami bez podstawienia Kroneckera.
+ * Bardzo duże czynniki mnoży w wielu wątkach, duże rzadkie czynniki za pomocą
+ * kopca, a pozostałe jednomian po jednomianie. Przy mnożeniu jednomian po
+ * jednomianie sprawdza przed alokacją, czy tablica na wszystkie iloczyny
+ * jednomianów zmieści się w limicie pamięci.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulMonoArrays(const Poly *p, const Poly *q) {
+    Mono pSingle, qSingle;
+    Poly pView, qView;
+    p = PolyMonoView(p, &pView, &pSingle);
+    q = PolyMonoView(q, &qView, &qSingle);
+    size_t threads = insideWorker ? 1 : ThreadCount();
+
+    if (threads > 1 && p->size * q->size >= PARALLEL_MUL_THRESHOLD) {
+
+        return PolyMulParallel(p, q, threads);
+    }
+
+    if (p->size * q->size >= HEAP_MUL_THRESHOLD && PolyMulIsSparse(p, q)) {
+
+        return PolyMulHeap(p, q);
+    } else if (!MonoArrayReserve(p->size * q->size)) {
+
+        return PolyZero(); // wynik i tak zostanie odrzucony
+    }
+
+    Mono *result = NULL;
+    Mono holder;
+    size_t resultI = 0;
+
+    for (size_t i = 0; i < p->size; i++) {
+        for (size_t j = 0; j < q->size; j++) {
+            holder = MonoMul(&p->arr[i], &q->arr[j]);
+
+            if (!MonoIsZero(&holder)) {
+
+                if (result == NULL) {
+                    result = MonoArrayAlloc(p->size * q->size);
+                }
+
+                result[resultI] = holder;
+                resultI++;
+            }
+        }
+    }
+
+    if (result != NULL) {
+
+        return PolyOwnMonoArray(resultI, result);
+    } else {
+
+        return PolyZero();
+    }
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące współczynnikami oraz przejmuje je na własność.
+ * Gęste czynniki o ograniczonych stopniach mnoży przez podstawienie
+ * Kroneckera, a pozostałe funkcją PolyMulMonoArrays. O podstawieniu
+ * Kroneckera decyduje tylko najbardziej zewnętrzne mnożenie, bo sprawdzenie
+ * przechodzi całe drzewa czynników. Każda metoda sprawdza w limicie pamięci
+ * to, co sama alokuje, i przerywa mnożenie, zwracając zero, jeśli się to nie
+ * mieści. Zero jest zwracane także wtedy, gdy suma największych wykładników
+ * przekracza INT_MAX.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulNonCoeffs(const Poly *p, const Poly *q) {
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+
+    size_t pCount = PolyMonoCount(p);
+    size_t qCount = PolyMonoCount(q);
+
+    Mono pLast, qLast;
+    poly_exp_t maxExp;
+
+    if (!ExpAdd(PolyMonos(p, &pLast)[pCount - 1].exp,
+                PolyMonos(q, &qLast)[qCount - 1].exp, &maxExp)) {
+
+        return PolyZero(); // wynik i tak zostanie odrzucony
+    }
+
+    if (kroneckerRejected) {
+
+        return PolyMulMonoArrays(p, q);
+    }
+
+    Poly result;
+
+    if (PolyMulKronecker(p, q, &result)) {
+
+        return result;
+    }
+
+    kroneckerRejected = true;
+    result = PolyMulMonoArrays(p, q);
+    kroneckerRejected = false;
+
+    return result;
+}
+
+void PolySetNttThreshold(size_t threshold) {
+    nttThreshold = threshold;
+}
+
+void PolySetThreads(size_t threads) {
+    pthread_once(&threadCountOnce, ReadThreadCountFromEnv);
+    assert(threads > 0);
+    threadCount = threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+Poly PolyMul(const Poly *p, const Poly *q) {
+    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+
+        return PolyMulCoeffs(p, q);
+    } else {
+        if (PolyIsCoeff(p)) {
+
+            return PolyMulCoeffAndNonCoeff(p, q);
+        } else if (PolyIsCoeff(q)) {
+
+            return PolyMulCoeffAndNonCoeff(q, p);
+        } else {
+
+            return PolyMulNonCoeffs(p, q);
+        }
+    }
+}
+
+void PolyScaleInPlace(Poly *p, poly_coeff_t c) {
+    if (PolyIsCoeff(p)) {
+        p->coeff = (poly_coeff_t) ((unsigned long) p->coeff * (unsigned long) c);
+
+        return;
+    } else if (c == 1) {
+
+        return;
+    } else if (c == 0) {
+        PolyDestroy(p);
+        *p = PolyZero();
+
+        return;
+    } else if (PolyIsInline(p)) {
+        p->coeff = (poly_coeff_t) ((unsigned long) p->coeff * (unsigned long) c);
+
+        if (p->coeff == 0) {
+            *p = PolyZero();
+        }
+
+        return;
+    }
+
+    size_t size = 0;
+    PolyUnshare(p);
+
+    for (size_t i = 0; i < p->size; i++) {
+        PolyScaleInPlace(&p->arr[i].p, c);
+
+        if (!PolyIsZero(&p->arr[i].p)) {
+            p->arr[size] = p->arr[i];
+            size++;
+        }
+    }
+
+    *p = PolyFromSortedMonos(p->arr, size);
+}
+
+Poly PolyMulOwn(Poly *p, Poly *q) {
+    if (PolyIsCoeff(p)) {
+        PolyScaleInPlace(q, p->coeff);
+
+        return *q;
+    } else if (PolyIsCoeff(q)) {
+        PolyScaleInPlace(p, q->coeff);
+
+        return *p;
+    }
+
+    Poly result = PolyMulNonCoeffs(p, q);
+    PolyDestroy(p);
+    PolyDestroy(q);
+
+    return result;
+}
+
+poly_coeff_t CoeffPow(poly_coeff_t x, poly_exp_t n) {
+    unsigned long base = (unsigned long) x;
+    unsigned long result = 1;
+
+    while (n > 0) {
+        if (n & 1) {
+            result *= base;
+        }
+
+        base *= base;
+        n >>= 1;
+    }
+
+    return (poly_coeff_t) result;
+}
+
+/**
+ * Wylicza odwrotność liczby nieparzystej modulo @f$2^{64}@f$ metodą Newtona.
+ * @param[in] x : liczba nieparzysta @f$x@f$
+ * @return @f$x^{-1} \bmod 2^{64}@f$
+ */
+unsigned long OddInverse(unsigned long x) {
+    assert(x & 1);
+    unsigned long inverse = x; // poprawne 3 najmłodsze bity
+
+    for (int i = 0; i < 5; i++) {
+        inverse *= 2 - x * inverse;
+    }
+
+    return inverse;
+}
+
+/**
+ * To jest struktura przechowująca stan wyliczania kolejnych współczynników
+ * dwumianowych @f$\binom{n}{k}@f$ modulo @f$2^{64}@f$. Dzielenie przez
+ * @f$k@f$ nie jest wykonalne modulo @f$2^{64}@f$, więc osobno śledzona jest
+ * nieparzysta część współczynnika i wykładnik dwójki w jego rozkładzie.
+ */
+typedef struct Binomial {
+    poly_exp_t n; ///< wykładnik dwumianu
+    poly_exp_t k; ///< indeks bieżącego współczynnika
+    unsigned long odd; ///< nieparzysta część współczynnika
+    int twos; ///< wykładnik dwójki w rozkładzie współczynnika
+} Binomial;
+
+/**
+ * Zwraca bieżący współczynnik dwumianowy @f$\binom{n}{k}@f$.
+ * @param[in] binomial : stan wyliczania @f$binomial@f$
+ * @return @f$\binom{n}{k} \bmod 2^{64}@f$
+ */
+unsigned long BinomialValue(const Binomial *binomial) {
+    return binomial->twos >= 64 ? 0 : binomial->odd << binomial->twos;
+}
+
+/**
+ * Przechodzi od współczynnika @f$\binom{n}{k}@f$ do
+ * @f$\binom{n}{k + 1} = \binom{n}{k} \frac{n - k}{k + 1}@f$.
+ * @param[in,out] binomial : stan wyliczania @f$binomial@f$
+ */
+void BinomialNext(Binomial *binomial) {
+    binomial->k++;
+    unsigned long numerator = (unsigned long) (binomial->n - binomial->k + 1);
+    unsigned long denominator = (unsigned long) binomial->k;
+    int numeratorTwos = __builtin_ctzl(numerator);
+    int denominatorTwos = __builtin_ctzl(denominator);
+
+    binomial->odd *= numerator >> numeratorTwos;
+    binomial->odd *= OddInverse(denominator >> denominatorTwos);
+    binomial->twos += numeratorTwos - denominatorTwos;
+}
+
+/**
+ * Podnosi do potęgi wielomian będący jednym jednomianem:
+ * @f$(a x^e)^n = a^n x^{en}@f$. Wykładnik @f$en@f$ został sprawdzony przez
+ * PolyPow.
+ * @param[in] p : wielomian o jednym jednomianie @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, dodatni
+ * @return @f$p^n@f$
+ */
+Poly PolyPowMono(const Poly *p, poly_exp_t n) {
+    assert(!PolyIsCoeff(p) && PolyMonoCount(p) == 1 && n > 0);
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+    Poly coeff = PolyPow(&p->arr[0].p, n);
+
+    if (PolyIsZero(&coeff)) {
+
+        return PolyZero();
+    }
+
+    Mono *arr = MonoArrayAlloc(1);
+    arr[0] = MonoFromPoly(&coeff, p->arr[0].exp * n);
+
+    return PolyFromSortedMonos(arr, 1);
+}
+
+/**
+ * Podnosi wielomian do potęgi metodą szybkiego potęgowania. Bity wykładnika
+ * przeglądane są od najstarszego, więc poza podnoszeniem do kwadratu wynik
+ * jest mnożony tylko przez wielomian @p p, a nie przez jego duże potęgi.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, dodatni
+ * @return @f$p^n@f$
+ */
+Poly PolyPowSquaring(const Poly *p, poly_exp_t n) {
+    assert(n > 0);
+    int bit = 0;
+
+    while ((n >> bit) > 1) {
+        bit++;
+    }
+
+    Poly result = PolyClone(p);
+
+    for (bit--; bit >= 0; bit--) {
+        Poly square = PolyMul(&result, &result);
+        PolyDestroy(&result);
+        result = square;
+
+        if ((n >> bit) & 1) {
+            Poly product = PolyMul(&result, p);
+            PolyDestroy(&result);
+            result = product;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Podnosi do potęgi wielomian będący sumą dwóch jednomianów ze wzoru
+ * dwumianowego Newtona:
+ * @f$(a x^{e_1} + b x^{e_2})^n = \sum_k \binom{n}{k} a^{n-k} b^k
+ * x^{e_1 (n-k) + e_2 k}@f$.
+ * Wykładniki kolejnych wyrazów rosną, więc wynik nie wymaga sortowania,
+ * a największy z nich, @f$e_2 n@f$, został sprawdzony przez PolyPow.
+ * Poza tablicą wyniku zajmuje stałą pamięć, jeśli @f$a@f$ i @f$b@f$ są
+ * liczbami: potęga @f$b@f$ jest mnożona w każdym kroku, a potęga
+ * nieparzystego @f$a@f$ dzielona przez @f$a@f$ (parzyste @f$a^{n-k}@f$ jest
+ * zerem modulo @f$2^{64}@f$ dla @f$n - k \geq 64@f$). W przeciwnym razie
+ * wszystkie potęgi @f$a@f$ są przechowywane, więc wzór jest używany tylko dla
+ * @f$n@f$ nie większego niż BINOMIAL_MAX_POLY_POWERS, a większe potęgi
+ * liczone są funkcją PolyPowSquaring. Jeśli tablice nie zmieszczą się w limicie pamięci, nie
+ * liczy potęgi i zapisuje zero do @p result.
+ * @param[in] p : wielomian o dwóch jednomianach @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, dodatni
+ * @param[out] result : @f$p^n@f$
+ * @return czy tablice zmieściły się w limicie pamięci
+ */
+bool PolyPowBinomial(const Poly *p, poly_exp_t n, Poly *result) {
+    assert(!PolyIsCoeff(p) && p->size == 2 && n > 0);
+    const Poly *a = &p->arr[0].p;
+    const Poly *b = &p->arr[1].p;
+    bool scalar = PolyIsCoeff(a) && PolyIsCoeff(b);
+    size_t count = (size_t) n + 1;
+
+    if (!scalar && n > BINOMIAL_MAX_POLY_POWERS) {
+        *result = PolyPowSquaring(p, n);
+
+        return true;
+    } else if (!MemoryReserve(MonoArrayBytes(count) +
+                              (scalar ? 0 : count * sizeof(Poly)))) {
+        *result = PolyZero();
+
+        return false;
+    }
+
+    Mono *arr = MonoArrayAlloc(count);
+    size_t size = 0;
+    Binomial binomial = {.n = n, .k = 0, .odd = 1, .twos = 0};
+
+    if (scalar) {
+        unsigned long aCoeff = (unsigned long) a->coeff;
+        bool aOdd = (aCoeff & 1) != 0;
+        unsigned long aInverse = aOdd ? OddInverse(aCoeff) : 0;
+        unsigned long aPower = (unsigned long) CoeffPow(a->coeff, n);
+        unsigned long bPower = 1;
+
+        for (poly_exp_t k = 0; k <= n; k++) {
+            if (k > 0) {
+                BinomialNext(&binomial);
+                bPower *= (unsigned long) b->coeff;
+                aPower = aOdd ? aPower * aInverse : n - k < 64 ?
+                        (unsigned long) CoeffPow(a->coeff, n - k) : 0;
+            }
+
+            unsigned long coeff = BinomialValue(&binomial) * aPower * bPower;
+
+            if (coeff != 0) {
+                Poly term = PolyFromCoeff((poly_coeff_t) coeff);
+                arr[size] = MonoFromPoly(&term, p->arr[0].exp * (n - k) +
+                        p->arr[1].exp * k);
+                size++;
+            }
+        }
+
+        *result = PolyFromSortedMonos(arr, size);
+
+        return true;
+    }
+
+    ArenaMark mark = ArenaGetMark();
+    Poly *aPowers = ArenaAlloc(count * sizeof(Poly));
+    aPowers[0] = PolyFromCoeff(1);
+
+    for (size_t k = 1; k < count; k++) {
+        aPowers[k] = PolyMul(&aPowers[k - 1], a);
+    }
+
+    Poly bPower = PolyFromCoeff(1);
+
+    for (size_t k = 0; k < count; k++) {
+        if (k > 0) {
+            BinomialNext(&binomial);
+            Poly holder = PolyMul(&bPower, b);
+            PolyDestroy(&bPower);
+            bPower = holder;
+        }
+
+        Poly coeff = PolyFromCoeff((poly_coeff_t) BinomialValue(&binomial));
+        Poly product = PolyMul(&aPowers[count - 1 - k], &bPower);
+        Poly term = PolyMul(&product, &coeff);
+        PolyDestroy(&product);
+
+        if (!PolyIsZero(&term)) {
+            arr[size] = MonoFromPoly(&term, p->arr[0].exp * (n - (poly_exp_t) k)
+                    + p->arr[1].exp * (poly_exp_t) k);
+            size++;
+        }
+    }
+
+    PolyDestroy(&bPower);
+
+    for (size_t k = 0; k < count; k++) {
+        PolyDestroy(&aPowers[k]);
+    }
+
+    ArenaRelease(mark);
+    *result = PolyFromSortedMonos(arr, size);
+
+    return true;
+}
+
+bool PolyPowWithinLimit(const Poly *p, poly_exp_t n, Poly *result) {
+    assert(n >= 0);
+    Mono single;
+    poly_exp_t maxExp;
+    bool exceeded = MemoryLimitExceeded();
+
+    if (n == 0) {
+        *result = PolyFromCoeff(1);
+    } else if (PolyIsCoeff(p)) {
+        *result = PolyFromCoeff(CoeffPow(p->coeff, n));
+    } else if (!ExpMul(PolyMonos(p, &single)[PolyMonoCount(p) - 1].exp, n,
+                       &maxExp)) {
+        // wykładniki wszystkich sposobów potęgowania są nie większe
+        *result = PolyZero(); // wynik i tak zostanie odrzucony
+    } else if (PolyMonoCount(p) == 1) {
+        *result = PolyPowMono(p, n);
+    } else if (PolyMonoCount(p) == 2) {
+        if (!PolyPowBinomial(p, n, result)) {
+
+            return false;
+        }
+    } else {
+        *result = PolyPowSquaring(p, n);
+    }
+
+    return exceeded || !MemoryLimitExceeded();
+}
+
+Poly PolyPow(const Poly *p, poly_exp_t n) {
+    Poly result;
+    PolyPowWithinLimit(p, n, &result);
+
+    return result;
+}
+
+/**
+ * Sprawdza, czy jednomiany mają te same wartości.
+ * @param[in] m : jednomian @f$m@f$
+ * @param[in] n : jednomian @f$n@f$
+ * @return @f$m == n@f$
+ */
+bool MonoIsEq(const Mono *m, const Mono *n) {
+    return PolyIsEq(&m->p, &n->p) && m->exp == n->exp;
+}
+
+/**
+ * Sprawdza czy dwa wielomiany będące współczynnikami są równe.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p == q@f$
+ */
+bool PolyIsEqCoeffs(const Poly *p, const Poly *q) {
+    assert(PolyIsCoeff(p) && PolyIsCoeff(q));
+
+    return p->coeff == q->coeff;
+}
+
+/**
+ * Sprawdza czy dwa wielomiany niebędące współczynnikami są równe.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p == q@f$
+ */
+bool PolyIsEqNonCoeffs(const Poly *p, const Poly *q) {
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    Mono pSingle, qSingle;
+    Poly pView, qView;
+    p = PolyMonoView(p, &pView, &pSingle);
+    q = PolyMonoView(q, &qView, &qSingle);
+
+    if (p->size == q->size) {
+
+        for (size_t i = 0; i < p->size; i++) {
+
+            if (!MonoIsEq(&p->arr[i], &q->arr[i])) {
+
+                return false;
+            }
+        }
+
+        return true;
+    } else {
+
+        return false;
+    }
+}
+
+bool PolyIsEq(const Poly *p, const Poly *q) {
+    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+
+        return PolyIsEqCoeffs(p, q);
+    } else if (p->arr == q->arr) {
+
+        return PolyIsInline(p) ? p->coeff == q->coeff : p->size == q->size;
+    } else if (!PolyIsCoeff(p) && !PolyIsCoeff(q)) {
+        if (PolyHasArray(p) && PolyHasArray(q) &&
+            atomic_load(&MonoArrayHeaderOf(p->arr)->interned) &&
+            atomic_load(&MonoArrayHeaderOf(q->arr)->interned)) {
+            // równe internowane wielomiany współdzielą tablicę jednomianów
+
+            return false;
+        }
+
+        return PolyIsEqNonCoeffs(p, q);
+    } else {
+
+        return false;
+    }
+}
+
+void PolyNegInPlace(Poly *p) {
+    if (PolyIsCoeff(p) || PolyIsInline(p)) {
+        p->coeff = (poly_coeff_t) (0UL - (unsigned long)p->coeff);
+    } else {
+        PolyUnshare(p);
+
+        for (size_t i = 0; i < p->size; i++) {
+            PolyNegInPlace(&p->arr[i].p);
+        }
+    }
+}
+
+Poly PolyNeg(const Poly *p) {
+    Poly pCopy = PolyClone(p);
+    PolyNegInPlace(&pCopy);
+
+    return pCopy;
+}
+
+void PolyShiftInPlace(Poly *p, poly_exp_t n) {
+    assert(n >= 0);
+    Mono single;
+    poly_exp_t maxExp;
+
+    if (n == 0 || PolyIsZero(p)) {
+
+        return;
+    } else if (PolyIsCoeff(p)) {
+        *p = PolyInlineMono(p->coeff, n);
+
+        return;
+    } else if (!ExpAdd(PolyMonos(p, &single)[PolyMonoCount(p) - 1].exp, n,
+                       &maxExp)) {
+
+        return; // wielomian pozostaje niezmieniony
+    } else if (PolyIsInline(p)) {
+        *p = PolyInlineMono(p->coeff, maxExp);
+
+        return;
+    }
+
+    PolyUnshare(p);
+
+    for (size_t i = 0; i < p->size; i++) {
+        p->arr[i].exp += n;
+    }
+}
+
+void PolyUnshiftInPlace(Poly *p, poly_exp_t n) {
+    assert(n >= 0);
+
+    if (n == 0 || PolyIsCoeff(p)) {
+
+        return;
+    } else if (PolyIsInline(p)) {
+        Mono single;
+        poly_exp_t exp = PolyMonos(p, &single)[0].exp - n;
+        *p = exp == 0 ? PolyFromCoeff(p->coeff) : PolyInlineMono(p->coeff, exp);
+
+        return;
+    }
+
+    assert(p->arr[0].exp >= n);
+    PolyUnshare(p);
+
+    for (size_t i = 0; i < p->size; i++) {
+        p->arr[i].exp -= n;
+    }
+}
+
+size_t PolyUnshareBytes(const Poly *p) {
+    if (!PolyHasArray(p)) {
+
+        return 0;
+    } else if (atomic_load_explicit(&MonoArrayHeaderOf(p->arr)->refs,
+                                    memory_order_acquire) != 1 ||
+               atomic_load(&MonoArrayHeaderOf(p->arr)->interned)) {
+        // kopia tablicy współdzieli współczynniki, które też zostaną
+        // skopiowane
+        size_t bytes = 0;
+        size_t arrays = 0;
+        size_t monos = 0;
+        PolyMemoryUsage(p, &bytes, &arrays, &monos);
+
+        return bytes;
+    }
+
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < p->size; i++) {
+        bytes += PolyUnshareBytes(&p->arr[i].p);
+    }
+
+    return bytes;
+}
+
+Poly PolySubOwn(Poly *p, Poly *q) {
+    PolyNegInPlace(q);
+
+    return PolyAddOwn(p, q);
+}
+
+Poly PolySub(const Poly *p, const Poly *q) {
+    Poly pCopy = PolyClone(p);
+    Poly qCopy = PolyClone(q);
+
+    return PolySubOwn(&pCopy, &qCopy);
+}
+
+/**
+ * Zwraca stopień wielomianu jednomianu ze względu na zadaną zmienną (-1 dla
+ * wielomianu
+ * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
+ * Zmienna o indeksie 0 oznacza zmienną główną tego wielomianu.
+ * Większe indeksy oznaczają zmienne wielomianów znajdujących się
+ * we współczynnikach.
+ * @param[in] m : jednomian
+ * @param[in] var_idx : indeks zmiennej
+ * @return stopień wielomianu jednomianu @p m z względu na zmienną o indeksie
+ * @p var_idx
+ */
+poly_exp_t MonoDegBy(const Mono *m, size_t var_idx) {
+    if (var_idx == 0) {
+        return m->exp;
+    } else {
+        return PolyDegBy(&m->p, var_idx - 1);
+    }
+}
+
+poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
+    if (PolyIsZero(p)) {
+
+        return -1;
+    }
+
+    if (PolyIsCoeff(p)) {
+
+        return 0;
+    } else {
+        Mono single;
+        Poly view;
+        p = PolyMonoView(p, &view, &single);
+        poly_exp_t result = 0;
+
+        for (size_t i = 0; i < p->size; i++) {
+            poly_exp_t holder = MonoDegBy(&p->arr[i], var_idx);
+
+            if ( holder > result) {
+                result = holder;
+            }
+        }
+
+        return result;
+    }
+}
+
+/**
+ * Zwraca stopień wielomianu jednomianu (-1 dla wielomianu tożsamościowo
+ * równego zeru).
+ * @param[in] m : jednomian
+ * @return stopień wielomianu jednomianu @p m
+ */
+poly_exp_t MonoDeg(const Mono *m) {
+    return PolyDeg(&m->p) + m->exp;
+}
+
+poly_exp_t PolyDeg(const Poly *p) {
+    if (PolyIsZero(p)) {
+
+        return -1;
+    }
+
+    if (PolyIsCoeff(p)) {
+
+        return 0;
+    } else {
+        Mono single;
+        Poly view;
+        p = PolyMonoView(p, &view, &single);
+        poly_exp_t result = 0;
+
+        for (size_t i = 0; i < p->size; i++) {
+            poly_exp_t holder = MonoDeg(&p->arr[i]);
+
+            if ( holder > result) {
+                result = holder;
+            }
+        }
+
+        return result;
+    }
 }
 
 Poly PolyAt(const Poly *p, poly_coeff_t x) {
-    if (PolyIsZero(p) || x == 0) {
+    if (PolyIsCoeff(p)) {
 
-        return PolyZero();
+        return PolyClone(p);
+    }
+
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+    size_t i = p->size - 1;
+    Poly result = PolyClone(&p->arr[i].p);
+
+    while (i > 0) {
+        i--;
+        PolyScaleInPlace(&result, CoeffPow(x, p->arr[i + 1].exp -
+                                            p->arr[i].exp));
+        Poly coeff = PolyClone(&p->arr[i].p);
+        result = PolyAddOwn(&result, &coeff);
+    }
+
+    PolyScaleInPlace(&result, CoeffPow(x, p->arr[0].exp));
+
+    return result;
+}
+
+/**
+ * Sprawdza, czy wszystkie współczynniki jednomianów wielomianu są liczbami.
+ * @param[in] p : wielomian niebędący współczynnikiem @f$p@f$
+ * @return czy wielomian @p p jest wielomianem jednej zmiennej
+ */
+bool PolyHasCoeffMonos(const Poly *p) {
+    for (size_t i = 0; i < p->size; i++) {
+        if (!PolyIsCoeff(&p->arr[i].p)) {
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** To jest makrodefinicja reprezentująca liczbę punktów w bloku, na którym
+ * PolyAtMany wykonuje jeden krok obliczeń. Pętla wewnętrzna po punktach
+ * bloku ma stałą długość i działa na tablicach z kwalifikatorem restrict,
+ * dzięki czemu kompilator może ją zwektoryzować (gcc robi to przy -O3). */
+#define AT_MANY_LANES 8
+
+/**
+ * Podnosi do kwadratu potęgi punktów jednego bloku i opcjonalnie mnoży je
+ * przez punkty.
+ * @param[in,out] powers : potęgi punktów bloku @f$powers@f$
+ * @param[in] xs : punkty bloku @f$xs@f$
+ * @param[in] multiply : czy pomnożyć potęgi przez punkty
+ */
+static inline void LanesSquare(unsigned long *restrict powers,
+                               const unsigned long *restrict xs,
+                               bool multiply) {
+    for (size_t l = 0; l < AT_MANY_LANES; l++) {
+        powers[l] *= multiply ? powers[l] * xs[l] : powers[l];
+    }
+}
+
+/**
+ * Wykonuje jeden krok schematu Hornera dla punktów jednego bloku.
+ * @param[in,out] values : wartości w punktach bloku @f$values@f$
+ * @param[in] powers : potęgi punktów bloku @f$powers@f$
+ * @param[in] coeff : dodawany współczynnik @f$coeff@f$
+ */
+static inline void LanesHorner(unsigned long *restrict values,
+                               const unsigned long *restrict powers,
+                               unsigned long coeff) {
+    for (size_t l = 0; l < AT_MANY_LANES; l++) {
+        values[l] = values[l] * powers[l] + coeff;
+    }
+}
+
+/**
+ * Wylicza potęgi punktów o zadanym wykładniku. Liczba punktów musi być
+ * wielokrotnością AT_MANY_LANES; punkty są przetwarzane blokami.
+ * @param[in] n : liczba punktów @f$n@f$
+ * @param[in] xs : tablica punktów @f$xs@f$
+ * @param[in] exp : wykładnik @f$exp@f$
+ * @param[in] powers : tablica na potęgi punktów @f$powers@f$
+ */
+static void PointsPow(size_t n, const unsigned long *restrict xs,
+                      poly_exp_t exp, unsigned long *restrict powers) {
+    int bit = 0;
+
+    while ((exp >> bit) > 1) {
+        bit++;
+    }
+
+    for (size_t j = 0; j < n; j++) {
+        powers[j] = exp == 0 ? 1 : xs[j];
+    }
+
+    for (bit--; bit >= 0; bit--) {
+        bool multiply = (exp >> bit) & 1;
+
+        for (size_t j = 0; j < n; j += AT_MANY_LANES) {
+            LanesSquare(powers + j, xs + j, multiply);
+        }
+    }
+}
+
+void PolyAtMany(const Poly *p, size_t n, const poly_coeff_t xs[], Poly out[]) {
+    if (n == 0) {
+
+        return;
+    } else if (PolyIsCoeff(p)) {
+        for (size_t j = 0; j < n; j++) {
+            out[j] = PolyClone(p);
+        }
+
+        return;
+    }
+
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+    ArenaMark mark = ArenaGetMark();
+    size_t lanes = (n + AT_MANY_LANES - 1) / AT_MANY_LANES * AT_MANY_LANES;
+    unsigned long *points = ArenaAlloc(lanes * sizeof(unsigned long));
+    unsigned long *powers = ArenaAlloc(lanes * sizeof(unsigned long));
+    poly_exp_t powersExp = -1;
+    size_t i = p->size - 1;
+
+    for (size_t j = 0; j < lanes; j++) {
+        points[j] = j < n ? (unsigned long) xs[j] : 0;
+    }
+
+    if (PolyHasCoeffMonos(p)) {
+        unsigned long *values = ArenaAlloc(lanes * sizeof(unsigned long));
+
+        for (size_t j = 0; j < lanes; j++) {
+            values[j] = (unsigned long) p->arr[i].p.coeff;
+        }
+
+        while (i > 0) {
+            i--;
+            poly_exp_t gap = p->arr[i + 1].exp - p->arr[i].exp;
+            unsigned long coeff = (unsigned long) p->arr[i].p.coeff;
+
+            if (gap != powersExp) {
+                PointsPow(lanes, points, gap, powers);
+                powersExp = gap;
+            }
+
+            for (size_t j = 0; j < lanes; j += AT_MANY_LANES) {
+                LanesHorner(values + j, powers + j, coeff);
+            }
+        }
+
+        PointsPow(lanes, points, p->arr[0].exp, powers);
+
+        for (size_t j = 0; j < n; j++) {
+            out[j] = PolyFromCoeff((poly_coeff_t) (values[j] * powers[j]));
+        }
     } else {
-        if (PolyIsCoeff(p)) {
+        for (size_t j = 0; j < n; j++) {
+            out[j] = PolyClone(&p->arr[i].p);
+        }
 
-            return PolyClone(p);
-        } else {
-        Poly result = PolyZero();
+        while (i > 0) {
+            i--;
+            poly_exp_t gap = p->arr[i + 1].exp - p->arr[i].exp;
 
-            for (size_t i = 0; i < p->size; i++) {
-                MonoAt(&p->arr[i], x, &result);
+            if (gap != powersExp) {
+                PointsPow(lanes, points, gap, powers);
+                powersExp = gap;
             }
 
-            return result;
+            for (size_t j = 0; j < n; j++) {
+                PolyScaleInPlace(&out[j], (poly_coeff_t) powers[j]);
+                Poly coeff = PolyClone(&p->arr[i].p);
+                out[j] = PolyAddOwn(&out[j], &coeff);
+            }
+        }
+
+        PointsPow(lanes, points, p->arr[0].exp, powers);
+
+        for (size_t j = 0; j < n; j++) {
+            PolyScaleInPlace(&out[j], (poly_coeff_t) powers[j]);
         }
     }
+
+    ArenaRelease(mark);
 }
 
+/** To jest makrodefinicja reprezentująca głębokość stosu wartości planu
+ * wartościowania, dla której nie jest potrzebna alokacja pamięci. */
+#define EVAL_STACK_SIZE 64
+
+/**
+ * To jest typ wyliczeniowy reprezentujący rodzaje instrukcji planu
+ * wartościowania. Instrukcje operują na stosie wartości.
+ */
+typedef enum EvalOp {
+    EVAL_PUSH, ///< wstawia współczynnik na stos
+    EVAL_HORNER, ///< mnoży wierzchołek przez potęgę zmiennej i dodaje współczynnik
+    EVAL_HORNER_POP, ///< zdejmuje wartość, mnoży wierzchołek przez potęgę zmiennej i dodaje zdjętą wartość
+    EVAL_SHIFT ///< mnoży wierzchołek przez potęgę zmiennej
+} EvalOp;
+
+/**
+ * To jest struktura przechowująca jedną instrukcję planu wartościowania.
+ */
+typedef struct EvalInstruction {
+    EvalOp op; ///< rodzaj instrukcji
+    poly_exp_t exp; ///< wykładnik potęgi zmiennej
+    size_t var; ///< indeks zmiennej
+    poly_coeff_t coeff; ///< współczynnik
+} EvalInstruction;
+
+/**
+ * To jest struktura przechowująca plan wartościowania wielomianu, czyli
+ * zagnieżdżony schemat Hornera spłaszczony do tablicy instrukcji.
+ */
+struct PolyEvalPlan {
+    EvalInstruction *code; ///< tablica instrukcji
+    size_t size; ///< liczba instrukcji
+    size_t depth; ///< maksymalna głębokość stosu wartości
+};
+
 /**
- * Podstawia wielomiany q1, q2, q3, ... qk pod kolejne zmienne w wielomianie
- * p, a także przejmuje je na własność. Jest funkcją pomocniczą funkcji
- * PolyCompose
+ * Wylicza liczbę instrukcji planu wartościowania wielomianu.
  * @param[in] p : wielomian @f$p@f$
- * @param[in] k : długość tablicy wielomianów @f$k@f$
- * @param[in] q : tablica wielomianów @f$q@f$
- * @return @f$p(q1, q2, q3 ... qk)@f$
+ * @return liczba instrukcji
  */
-Poly PolyComposeH(Poly *p, size_t k, const Poly *q);
+size_t EvalPlanSize(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+
+        return 1;
+    }
+
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+    size_t size = EvalPlanSize(&p->arr[p->size - 1].p) + 1;
+
+    for (size_t i = 0; i + 1 < p->size; i++) {
+        size += PolyIsCoeff(&p->arr[i].p) ? 1 : EvalPlanSize(&p->arr[i].p) + 1;
+    }
+
+    return size;
+}
 
 /**
- * Podstawia wielomian qk pod zmienną w jednomianie @p m.
- * @param[in] m : jednomian @f$m@f$
- * @param[in] k : długość tablicy wielomianów @f$k@f$
- * @param[in] q : tablica wielomianów @f$q@f$
- * @return @f$p * qk^exp@f$
+ * Zapisuje instrukcje wartościowania wielomianu @p p schematem Hornera
+ * względem zmiennej o indeksie @p var. Po ich wykonaniu wartość wielomianu
+ * znajduje się na wierzchołku stosu.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] var : indeks głównej zmiennej wielomianu @f$var@f$
+ * @param[in] plan : uzupełniany plan @f$plan@f$
+ * @param[in] depth : liczba wartości na stosie przed wykonaniem instrukcji
+ * @f$depth@f$
  */
-Poly MonoCompose(Mono *m, size_t k, const Poly *q) {
-    if (k == 0) {
+void EvalPlanEmit(const Poly *p, size_t var, PolyEvalPlan *plan,
+                  size_t depth) {
+    if (depth + 1 > plan->depth) {
+        plan->depth = depth + 1;
+    }
 
-        return PolyZero();
+    if (PolyIsCoeff(p)) {
+        plan->code[plan->size++] = (EvalInstruction) {.op = EVAL_PUSH,
+                .coeff = p->coeff};
+
+        return;
     }
 
-    Poly deeperPoly = PolyComposeH(&m->p, k - 1, q);
-    Poly toMul = PolyFromCoeff(1);
-    Poly toMulStartingCopy = PolyClone(&(q[k - 1]));
-    Poly holder;
-    bool toMulInitialized = false;
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+    size_t i = p->size - 1;
+    EvalPlanEmit(&p->arr[i].p, var + 1, plan, depth);
+
+    while (i > 0) {
+        i--;
+        poly_exp_t gap = p->arr[i + 1].exp - p->arr[i].exp;
 
-    for (size_t i = 0; i < (size_t)(m->exp); i++) {
-        if (!toMulInitialized) {
-            toMul = PolyClone(&(q[k - 1]));
-            toMulInitialized = true;
+        if (PolyIsCoeff(&p->arr[i].p)) {
+            plan->code[plan->size++] = (EvalInstruction) {.op = EVAL_HORNER,
+                    .exp = gap, .var = var, .coeff = p->arr[i].p.coeff};
         } else {
-            holder = PolyMul(&toMul, &toMulStartingCopy);
-            PolyDestroy(&toMul);
-            toMul = holder;
+            EvalPlanEmit(&p->arr[i].p, var + 1, plan, depth + 1);
+            plan->code[plan->size++] = (EvalInstruction) {.op =
+                    EVAL_HORNER_POP, .exp = gap, .var = var};
         }
     }
 
-    PolyDestroy(&toMulStartingCopy);
+    if (p->arr[0].exp > 0) {
+        plan->code[plan->size++] = (EvalInstruction) {.op = EVAL_SHIFT,
+                .exp = p->arr[0].exp, .var = var};
+    }
+}
+
+PolyEvalPlan *PolyEvalPlanCreate(const Poly *p) {
+    PolyEvalPlan *plan = secureMalloc(sizeof(PolyEvalPlan));
+    plan->code = secureMalloc(EvalPlanSize(p) * sizeof(EvalInstruction));
+    plan->size = 0;
+    plan->depth = 0;
+    EvalPlanEmit(p, 0, plan, 0);
+
+    return plan;
+}
+
+void PolyEvalPlanDestroy(PolyEvalPlan *plan) {
+    if (plan != NULL) {
+        free(plan->code);
+        free(plan);
+    }
+}
+
+/**
+ * Podnosi wartość zmiennej do potęgi. Zmienne o indeksach spoza tablicy
+ * @p x mają wartość zero.
+ * @param[in] nvars : długość tablicy wartości zmiennych @f$nvars@f$
+ * @param[in] x : tablica wartości zmiennych @f$x@f$
+ * @param[in] var : indeks zmiennej @f$var@f$
+ * @param[in] exp : wykładnik @f$exp@f$
+ * @return @f$x_{var}^{exp}@f$ modulo @f$2^{64}@f$
+ */
+unsigned long EvalVarPow(size_t nvars, const poly_coeff_t x[], size_t var,
+                         poly_exp_t exp) {
+    unsigned long base = var < nvars ? (unsigned long) x[var] : 0;
+
+    if (exp == 0) {
+
+        return 1;
+    } else if (exp == 1) {
+
+        return base;
+    }
 
-    Poly result = PolyMul(&deeperPoly, &toMul);
-    PolyDestroy(&deeperPoly);
-    PolyDestroy(&toMul);
+    return (unsigned long) CoeffPow((poly_coeff_t) base, exp);
+}
+
+poly_coeff_t PolyEvalPlanRun(const PolyEvalPlan *plan, size_t nvars,
+                             const poly_coeff_t x[]) {
+    unsigned long localStack[EVAL_STACK_SIZE];
+    ArenaMark mark = ArenaGetMark();
+    unsigned long *stack = plan->depth <= EVAL_STACK_SIZE ? localStack :
+            ArenaAlloc(plan->depth * sizeof(unsigned long));
+    size_t top = 0;
+
+    for (size_t i = 0; i < plan->size; i++) {
+        const EvalInstruction *instruction = &plan->code[i];
+
+        switch (instruction->op) {
+            case EVAL_PUSH:
+                stack[top++] = (unsigned long) instruction->coeff;
+                break;
+            case EVAL_HORNER:
+                stack[top - 1] = stack[top - 1] * EvalVarPow(nvars, x,
+                        instruction->var, instruction->exp) +
+                        (unsigned long) instruction->coeff;
+                break;
+            case EVAL_HORNER_POP:
+                top--;
+                stack[top - 1] = stack[top - 1] * EvalVarPow(nvars, x,
+                        instruction->var, instruction->exp) + stack[top];
+                break;
+            case EVAL_SHIFT:
+                stack[top - 1] *= EvalVarPow(nvars, x, instruction->var,
+                                             instruction->exp);
+                break;
+        }
+    }
+
+    assert(top == 1);
+    poly_coeff_t result = (poly_coeff_t) stack[0];
+    ArenaRelease(mark);
 
     return result;
 }
 
 /**
- * Sumuje listę wielomianów i tworzy z nich wielomian.
- * Przejmuje na własność zawartość tablicy @p polyArr.
- * @param[in] polyArr : tablica wielomianów
- * @param[in] size : długość tablicy wielomianów
- * @return wielomian będący sumą wielomianów
+ * Wylicza wartość wielomianu schematem Hornera względem zmiennej o indeksie
+ * @p var, bez alokowania pamięci.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] var : indeks głównej zmiennej wielomianu @f$var@f$
+ * @param[in] nvars : długość tablicy wartości zmiennych @f$nvars@f$
+ * @param[in] x : tablica wartości zmiennych @f$x@f$
+ * @return wartość wielomianu modulo @f$2^{64}@f$
+ */
+unsigned long PolyEvalH(const Poly *p, size_t var, size_t nvars,
+                        const poly_coeff_t x[]) {
+    if (PolyIsCoeff(p)) {
+
+        return (unsigned long) p->coeff;
+    }
+
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+    size_t i = p->size - 1;
+    unsigned long result = PolyEvalH(&p->arr[i].p, var + 1, nvars, x);
+
+    while (i > 0) {
+        i--;
+        result = result * EvalVarPow(nvars, x, var, p->arr[i + 1].exp -
+                                                    p->arr[i].exp) +
+                 PolyEvalH(&p->arr[i].p, var + 1, nvars, x);
+    }
+
+    return result * EvalVarPow(nvars, x, var, p->arr[0].exp);
+}
+
+poly_coeff_t PolyEval(const Poly *p, size_t nvars, const poly_coeff_t x[]) {
+
+    return (poly_coeff_t) PolyEvalH(p, 0, nvars, x);
+}
+
+/**
+ * To jest struktura przechowująca potęgi wielomianu podstawianego pod jedną
+ * zmienną. Przechowywane są tylko potęgi o wykładnikach równych najmniejszym
+ * wykładnikom przy tej zmiennej oraz różnicom kolejnych wykładników przy niej
+ * w składanym wielomianie, bo tylko takich potrzebuje schemat Hornera.
+ */
+typedef struct PowerCache {
+    poly_exp_t *exps; ///< rosnąca tablica różnych wykładników
+    Poly *powers; ///< potęgi podstawianego wielomianu o wykładnikach @p exps
+    size_t size; ///< liczba wykładników
+    size_t allocatedSize; ///< rozmiar zaalokowanej tablicy wykładników
+} PowerCache;
+
+/**
+ * Wylicza głębokość wielomianu, czyli liczbę zmiennych, od których zależy
+ * jego postać.
+ * @param[in] p : wielomian @f$p@f$
+ * @return głębokość wielomianu @p p
+ */
+size_t PolyDepth(const Poly *p) {
+    size_t depth = 0;
+
+    if (!PolyIsCoeff(p)) {
+        Mono single;
+        Poly view;
+        p = PolyMonoView(p, &view, &single);
+
+        for (size_t i = 0; i < p->size; i++) {
+            size_t monoDepth = PolyDepth(&p->arr[i].p) + 1;
+
+            if (monoDepth > depth) {
+                depth = monoDepth;
+            }
+        }
+    }
+
+    return depth;
+}
+
+/**
+ * Wyznacza stopnie wielomianu ze względu na kolejne zmienne, zaczynając od
+ * zmiennej o indeksie @p level.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] level : indeks zmiennej wielomianu @p p @f$level@f$
+ * @param[in] degs : tablica stopni, wypełniona początkowo zerami
+ * @f$degs@f$
+ */
+void PolyVarDegs(const Poly *p, size_t level, poly_exp_t *degs) {
+    if (PolyIsCoeff(p)) {
+
+        return;
+    }
+
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+
+    if (p->arr[p->size - 1].exp > degs[level]) {
+        degs[level] = p->arr[p->size - 1].exp;
+    }
+
+    for (size_t i = 0; i < p->size; i++) {
+        PolyVarDegs(&p->arr[i].p, level + 1, degs);
+    }
+}
+
+/**
+ * Wyznacza w arenie tablicę stopni wielomianu ze względu na kolejne zmienne.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] length : długość tablicy, nie mniejsza niż głębokość
+ * wielomianu @f$length@f$
+ * @return tablica stopni
+ */
+poly_exp_t *PolyVarDegsAlloc(const Poly *p, size_t length) {
+    poly_exp_t *degs = ArenaAlloc(length * sizeof(poly_exp_t));
+
+    for (size_t i = 0; i < length; i++) {
+        degs[i] = 0;
+    }
+
+    PolyVarDegs(p, 0, degs);
+
+    return degs;
+}
+
+bool PolyPowFits(const Poly *p, poly_exp_t n) {
+    assert(n >= 0);
+    size_t depth = PolyDepth(p);
+    ArenaMark mark = ArenaGetMark();
+    poly_exp_t *degs = PolyVarDegsAlloc(p, depth);
+    bool fits = true;
+
+    for (size_t i = 0; i < depth && fits; i++) {
+        fits = n == 0 || degs[i] <= INT_MAX / n;
+    }
+
+    ArenaRelease(mark);
+
+    return fits;
+}
+
+bool PolyMulFits(const Poly *p, const Poly *q) {
+    size_t pDepth = PolyDepth(p);
+    size_t qDepth = PolyDepth(q);
+    size_t depth = pDepth > qDepth ? pDepth : qDepth;
+    ArenaMark mark = ArenaGetMark();
+    poly_exp_t *pDegs = PolyVarDegsAlloc(p, depth);
+    poly_exp_t *qDegs = PolyVarDegsAlloc(q, depth);
+    bool fits = true;
+
+    for (size_t i = 0; i < depth && fits; i++) {
+        fits = pDegs[i] <= INT_MAX - qDegs[i];
+    }
+
+    ArenaRelease(mark);
+
+    return fits;
+}
+
+/**
+ * Dopisuje do pamięci potęg wykładniki potrzebne schematowi Hornera przy
+ * zmiennych o indeksach od @p level do @p levels - 1 w wielomianie @p p:
+ * najmniejszy wykładnik i różnice kolejnych wykładników, o ile są dodatnie.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] level : indeks zmiennej wielomianu @p p @f$level@f$
+ * @param[in] levels : liczba podstawianych zmiennych @f$levels@f$
+ * @param[in] caches : tablica pamięci potęg @f$caches@f$
+ */
+void PowerCacheCollect(const Poly *p, size_t level, size_t levels,
+                       PowerCache *caches) {
+    if (PolyIsCoeff(p) || level >= levels) {
+
+        return;
+    }
+
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+    PowerCache *cache = &caches[level];
+
+    for (size_t i = 0; i < p->size; i++) {
+        poly_exp_t gap = i == 0 ? p->arr[0].exp : p->arr[i].exp -
+                p->arr[i - 1].exp;
+
+        PowerCacheCollect(&p->arr[i].p, level + 1, levels, caches);
+
+        if (gap == 0) {
+            continue;
+        }
+
+        if (cache->size == cache->allocatedSize) {
+            cache->allocatedSize = cache->allocatedSize == 0 ?
+                    STARTING_ARRAY_SIZE : 2 * cache->allocatedSize;
+            poly_exp_t *exps = ArenaAlloc(cache->allocatedSize *
+                    sizeof(poly_exp_t));
+
+            for (size_t j = 0; j < cache->size; j++) {
+                exps[j] = cache->exps[j];
+            }
+
+            cache->exps = exps;
+        }
+
+        cache->exps[cache->size] = gap;
+        cache->size++;
+    }
+}
+
+/**
+ * Porównuje dwa wykładniki.
+ * @param[in] a : wskaźnik na wykładnik @f$a@f$
+ * @param[in] b : wskaźnik na wykładnik @f$b@f$
+ * @return -1, 0 lub 1 w zależności od tego, czy @p a jest mniejszy, równy,
+ * czy większy od @p b
+ */
+int CompareExps(const void *a, const void *b) {
+    poly_exp_t x = *(const poly_exp_t *) a;
+    poly_exp_t y = *(const poly_exp_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Wylicza potęgi wielomianu @p q o zebranych wykładnikach. Wykładniki są
+ * sortowane i pozbawiane powtórzeń, a każda kolejna potęga powstaje
+ * z poprzedniej przez domnożenie potęgi o wykładniku równym różnicy
+ * kolejnych wykładników.
+ * @param[in] cache : pamięć potęg z zebranymi wykładnikami @f$cache@f$
+ * @param[in] q : podstawiany wielomian @f$q@f$
  */
-Poly PolyAddPolys(Poly *polyArr, size_t size) {
-    Poly result = PolyZero();
+void PowerCacheBuild(PowerCache *cache, const Poly *q) {
+    size_t size = 0;
+
+    qsort(cache->exps, cache->size, sizeof(poly_exp_t), CompareExps);
+
+    for (size_t i = 0; i < cache->size; i++) {
+        if (size == 0 || cache->exps[size - 1] != cache->exps[i]) {
+            cache->exps[size] = cache->exps[i];
+            size++;
+        }
+    }
+
+    cache->size = size;
+
+    if (size == 0) {
+
+        return;
+    }
+
+    cache->powers = ArenaAlloc(size * sizeof(Poly));
 
     for (size_t i = 0; i < size; i++) {
-        result = PolyAddH(&result, &polyArr[i]);
+        if (i == 0) {
+            cache->powers[i] = PolyPow(q, cache->exps[i]);
+        } else {
+            Poly gapPower = PolyPow(q, cache->exps[i] - cache->exps[i - 1]);
+            cache->powers[i] = PolyMul(&cache->powers[i - 1], &gapPower);
+            PolyDestroy(&gapPower);
+        }
     }
+}
+
+/**
+ * Zwraca z pamięci potęgę o zadanym wykładniku.
+ * @param[in] cache : pamięć potęg @f$cache@f$
+ * @param[in] exp : wykładnik obecny w pamięci @f$exp@f$
+ * @return wskaźnik na potęgę o wykładniku @p exp
+ */
+const Poly *PowerCacheFind(const PowerCache *cache, poly_exp_t exp) {
+    size_t left = 0;
+    size_t right = cache->size;
 
-    free(polyArr);
+    while (right - left > 1) {
+        size_t middle = left + (right - left) / 2;
 
-    return result;
+        if (cache->exps[middle] <= exp) {
+            left = middle;
+        } else {
+            right = middle;
+        }
+    }
+
+    assert(cache->exps[left] == exp);
+
+    return &cache->powers[left];
+}
+
+/**
+ * Usuwa z pamięci potęgi przechowywane w pamięci potęg. Tablice pamięci
+ * potęg leżą w arenie i są odzyskiwane razem z nią.
+ * @param[in] cache : pamięć potęg @f$cache@f$
+ */
+void PowerCacheDestroy(PowerCache *cache) {
+    for (size_t i = 0; i < cache->size; i++) {
+        PolyDestroy(&cache->powers[i]);
+    }
 }
 
-Poly PolyComposeH(Poly *p, size_t k, const Poly *q) {
+/**
+ * Podstawia wielomiany pod zmienne wielomianu @p p o indeksach od @p level,
+ * korzystając z wyliczonych wcześniej potęg. Pod zmienne o indeksach
+ * większych lub równych @p k podstawiane jest zero. Złożenie względem
+ * głównej zmiennej wyliczane jest schematem Hornera
+ * @f$(\ldots(c_{n} q^{e_{n} - e_{n-1}} + c_{n-1}) \ldots) q^{e_0}@f$,
+ * więc iloczyny poszczególnych jednomianów nigdy nie istnieją jednocześnie.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] level : indeks zmiennej wielomianu @p p @f$level@f$
+ * @param[in] k : liczba podstawianych wielomianów @f$k@f$
+ * @param[in] caches : tablica pamięci potęg kolejnych zmiennych @f$caches@f$
+ * @return wynik złożenia
+ */
+Poly PolyComposeCached(const Poly *p, size_t level, size_t k,
+                       const PowerCache *caches) {
     if (PolyIsCoeff(p)) {
 
         return *p;
-    } else {
-        Poly *polyArr = secureMalloc(p->size * sizeof(Poly));
+    }
 
-        for (size_t i = 0; i < p->size; i++) {
-            polyArr[i] = MonoCompose(&(p->arr[i]), k, q);
+    Mono single;
+    Poly view;
+    p = PolyMonoView(p, &view, &single);
+
+    if (level >= k) {
+        if (p->arr[0].exp == 0) {
+
+            return PolyComposeCached(&p->arr[0].p, level + 1, k, caches);
         }
 
-        return PolyAddPolys(polyArr, p->size);
+        return PolyZero();
+    }
+
+    size_t i = p->size - 1;
+    Poly result = PolyComposeCached(&p->arr[i].p, level + 1, k, caches);
+
+    while (i > 0) {
+        i--;
+        Poly shifted = PolyMul(&result, PowerCacheFind(&caches[level],
+                p->arr[i + 1].exp - p->arr[i].exp));
+        PolyDestroy(&result);
+        Poly inner = PolyComposeCached(&p->arr[i].p, level + 1, k, caches);
+        result = PolyAddOwn(&shifted, &inner);
     }
+
+    if (p->arr[0].exp > 0) {
+        Poly shifted = PolyMul(&result, PowerCacheFind(&caches[level],
+                p->arr[0].exp));
+        PolyDestroy(&result);
+        result = shifted;
+    }
+
+    return result;
 }
 
 Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
-    Poly pCopy = PolyClone(p);
+    size_t depth = PolyDepth(p);
+    size_t levels = depth < k ? depth : k;
+    ArenaMark mark = ArenaGetMark();
+    PowerCache *caches = ArenaAlloc(levels * sizeof(PowerCache));
+
+    for (size_t i = 0; i < levels; i++) {
+        caches[i] = (PowerCache) {.exps = NULL, .powers = NULL, .size = 0,
+                .allocatedSize = 0};
+    }
+
+    PowerCacheCollect(p, 0, levels, caches);
+
+    for (size_t i = 0; i < levels; i++) {
+        PowerCacheBuild(&caches[i], &q[k - 1 - i]);
+    }
+
+    Poly result = PolyComposeCached(p, 0, k, caches);
 
-    Poly result = PolyComposeH(&pCopy, k, q);
+    for (size_t i = 0; i < levels; i++) {
+        PowerCacheDestroy(&caches[i]);
+    }
 
-    PolyDestroy(&pCopy);
+    ArenaRelease(mark);
 
     return result;
-}
\ No newline at end of file
+}
@@ -14,6 +14,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /** To jest typ reprezentujący współczynniki. */
 typedef long poly_coeff_t;
@@ -27,6 +28,14 @@ struct Mono;
  * To jest struktura przechowująca wielomian.
  * Wielomian jest albo liczbą całkowitą, czyli wielomianem stałym
  * (wtedy `arr == NULL`), albo niepustą listą jednomianów (wtedy `arr != NULL`).
+ * Jednomian @f$cx_i^n@f$ o liczbie @f$c \neq 0@f$ i wykładniku @f$n > 0@f$
+ * jest zapisywany bezpośrednio w strukturze: `coeff` przechowuje wtedy
+ * @f$c@f$, a `arr` zamiast adresu przechowuje liczbę nieparzystą @f$2n + 1@f$.
+ *
+ * Pola struktury są prywatne dla modułu wielomianów. Poza poly.c wolno
+ * z nich korzystać wyłącznie za pomocą funkcji PolyFromCoeff, PolyIsCoeff,
+ * PolyGetCoeff, PolyIsInline, PolyMonoCount i PolyMonos, bo `arr` nie musi
+ * być adresem tablicy jednomianów.
  */
 typedef struct Poly {
     /**
@@ -103,6 +112,16 @@ static inline bool PolyIsCoeff(const Poly *p) {
     return p->arr == NULL;
 }
 
+/**
+ * Daje wartość wielomianu, który jest współczynnikiem.
+ * @param[in] p : wielomian stały
+ * @return wartość współczynnika
+ */
+static inline poly_coeff_t PolyGetCoeff(const Poly *p) {
+    assert(PolyIsCoeff(p));
+    return p->coeff;
+}
+
 /**
  * Sprawdza, czy wielomian jest tożsamościowo równy zeru.
  * @param[in] p : wielomian
@@ -112,6 +131,47 @@ static inline bool PolyIsZero(const Poly *p) {
     return PolyIsCoeff(p) && p->coeff == 0;
 }
 
+/**
+ * Sprawdza, czy wielomian jest jednomianem o współczynniku będącym liczbą,
+ * zapisanym bezpośrednio w strukturze, bez tablicy jednomianów.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest zapisany bezpośrednio w strukturze?
+ */
+static inline bool PolyIsInline(const Poly *p) {
+    return ((uintptr_t) p->arr & 1) != 0;
+}
+
+/**
+ * Daje liczbę jednomianów wielomianu, który nie jest współczynnikiem.
+ * @param[in] p : wielomian
+ * @return liczba jednomianów
+ */
+static inline size_t PolyMonoCount(const Poly *p) {
+    assert(!PolyIsCoeff(p));
+    return PolyIsInline(p) ? 1 : p->size;
+}
+
+/**
+ * Daje tablicę jednomianów wielomianu, który nie jest współczynnikiem.
+ * Jednomian wielomianu zapisanego bezpośrednio w strukturze jest odtwarzany
+ * w @p single, a jego współczynnik jest liczbą, więc go nie trzeba usuwać.
+ * @param[in] p : wielomian
+ * @param[in] single : miejsce na odtworzony jednomian
+ * @return tablica jednomianów ważna, dopóki istnieją @p p i @p single
+ */
+static inline const Mono *PolyMonos(const Poly *p, Mono *single) {
+    assert(!PolyIsCoeff(p));
+
+    if (PolyIsInline(p)) {
+        *single = (Mono) {.p = PolyFromCoeff(p->coeff),
+                .exp = (poly_exp_t) ((uintptr_t) p->arr >> 1)};
+
+        return single;
+    }
+
+    return p->arr;
+}
+
 /**
  * Usuwa wielomian z pamięci.
  * @param[in] p : wielomian
@@ -127,14 +187,27 @@ static inline void MonoDestroy(Mono *m) {
 }
 
 /**
- * Robi pełną, głęboką kopię wielomianu.
+ * Dolicza pamięć zajmowaną przez tablice jednomianów wielomianu do podanych
+ * liczników. Tablice współdzielone są liczone przy każdym odwołaniu.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in,out] bytes : liczba bajtów tablic wraz z nagłówkami
+ * @param[in,out] arrays : liczba tablic
+ * @param[in,out] monos : łączna pojemność tablic
+ */
+void PolyMemoryUsage(const Poly *p, size_t *bytes, size_t *arrays,
+                     size_t *monos);
+
+/**
+ * Robi kopię wielomianu w czasie stałym. Kopia współdzieli tablicę jednomianów
+ * z oryginałem, a tablica jest kopiowana dopiero wtedy, gdy jeden
+ * z wielomianów przejętych na własność ma zostać zmodyfikowany.
  * @param[in] p : wielomian
  * @return skopiowany wielomian
  */
 Poly PolyClone(const Poly *p);
 
 /**
- * Robi pełną, głęboką kopię jednomianu.
+ * Robi kopię jednomianu w czasie stałym.
  * @param[in] m : jednomian
  * @return skopiowany jednomian
  */
@@ -142,6 +215,17 @@ static inline Mono MonoClone(const Mono *m) {
     return (Mono) {.p = PolyClone(&m->p), .exp = m->exp};
 }
 
+/**
+ * Internuje wielomian, przejmując go na własność. Równe internowane wielomiany
+ * współdzielą jedną tablicę jednomianów, podobnie jak ich równe
+ * podwielomiany, więc PolyIsEq porównuje je w czasie stałym, a powtarzające
+ * się fragmenty zajmują pamięć tylko raz. Internowany wielomian można dalej
+ * dowolnie używać, a modyfikacja tworzy jego kopię.
+ * @param[in] p : wielomian @f$p@f$
+ * @return internowany wielomian równy @p p
+ */
+Poly PolyIntern(Poly *p);
+
 /**
  * Dodaje dwa wielomiany.
  * @param[in] p : wielomian @f$p@f$
@@ -150,6 +234,16 @@ static inline Mono MonoClone(const Mono *m) {
  */
 Poly PolyAdd(const Poly *p, const Poly *q);
 
+/**
+ * Dodaje dwa wielomiany, przejmując je na własność. Nie kopiuje
+ * wielomianów, a w miarę możliwości wykorzystuje ich pamięć na wynik.
+ * Po wywołaniu wielomiany @p p i @p q nie mogą być już używane ani usuwane.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAddOwn(Poly *p, Poly *q);
+
 /**
  * Sumuje listę jednomianów i tworzy z nich wielomian.
  * Przejmuje na własność zawartość tablicy @p monos.
@@ -183,13 +277,117 @@ Poly PolyOwnMonos(size_t count, Mono *monos);
 Poly PolyCloneMonos(size_t count, const Mono monos[]);
 
 /**
- * Mnoży dwa wielomiany.
+ * Mnoży dwa wielomiany. Jeśli któryś wykładnik iloczynu przekracza INT_MAX,
+ * oznacza przekroczenie zakresu wykładników i zwraca niepoprawny wynik.
  * @param[in] p : wielomian @f$p@f$
  * @param[in] q : wielomian @f$q@f$
  * @return @f$p * q@f$
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/**
+ * Sprawdza, czy wszystkie wykładniki iloczynu wielomianów mieszczą się
+ * w zakresie, czyli czy dla każdej zmiennej suma stopni obu wielomianów ze
+ * względu na nią nie przekracza INT_MAX.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return czy wykładniki @f$p * q@f$ mieszczą się w zakresie
+ */
+bool PolyMulFits(const Poly *p, const Poly *q);
+
+/**
+ * Mnoży dwa wielomiany, przejmując je na własność. Mnożenie przez
+ * współczynnik odbywa się w miejscu, bez kopiowania drugiego czynnika.
+ * Po wywołaniu wielomiany @p p i @p q nie mogą być już używane ani usuwane.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulOwn(Poly *p, Poly *q);
+
+/**
+ * Podnosi wielomian do potęgi.
+ * Dla @f$n = 0@f$ wynikiem jest wielomian stały równy 1. Jeśli któryś
+ * wykładnik potęgi przekracza INT_MAX, oznacza przekroczenie zakresu
+ * wykładników i zwraca niepoprawny wynik.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, nieujemny
+ * @return @f$p^n@f$
+ */
+Poly PolyPow(const Poly *p, poly_exp_t n);
+
+/**
+ * Podnosi wielomian do potęgi tak jak PolyPow, ale zgłasza przerwanie
+ * obliczeń z powodu limitu pamięci. Jeśli pamięć potrzebna do wyliczenia
+ * potęgi nie mieści się w limicie, zwraca fałsz, a zapisany w @p result
+ * wielomian jest niepoprawny i trzeba go usunąć.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, nieujemny
+ * @param[out] result : @f$p^n@f$
+ * @return czy potęga zmieściła się w limicie pamięci
+ */
+bool PolyPowWithinLimit(const Poly *p, poly_exp_t n, Poly *result);
+
+/**
+ * Sprawdza, czy wszystkie wykładniki potęgi wielomianu mieszczą się
+ * w zakresie, czyli czy dla każdej zmiennej stopień wielomianu ze względu na
+ * nią pomnożony przez @p n nie przekracza INT_MAX.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, nieujemny
+ * @return czy wykładniki @f$p^n@f$ mieszczą się w zakresie
+ */
+bool PolyPowFits(const Poly *p, poly_exp_t n);
+
+/**
+ * Podnosi współczynnik do potęgi metodą szybkiego potęgowania.
+ * Arytmetyka jest wykonywana modulo @f$2^{64}@f$.
+ * @param[in] x : podstawa @f$x@f$
+ * @param[in] n : wykładnik @f$n@f$
+ * @return @f$x^n@f$
+ */
+poly_coeff_t CoeffPow(poly_coeff_t x, poly_exp_t n);
+
+/**
+ * Sprawdza, czy od ostatniego wywołania PolyExpOverflowClear któraś operacja
+ * dała wykładnik większy niż INT_MAX. Taka operacja nie kończy programu,
+ * lecz zwraca niepoprawny wynik, który należy usunąć.
+ * @return czy wykładnik przekroczył zakres
+ */
+bool PolyExpOverflowed(void);
+
+/**
+ * Zapomina o przekroczeniu zakresu wykładników. Wywoływana przed
+ * rozpoczęciem operacji, której wynik może zostać odrzucony.
+ */
+void PolyExpOverflowClear(void);
+
+/**
+ * Ustawia próg mnożenia za pomocą liczbowej transformaty Fouriera (NTT).
+ * Transformata jest używana, gdy na jeden wyraz dłuższego z wektorów
+ * współczynników z podstawienia Kroneckera przypada co najmniej @p threshold
+ * iloczynów współczynników; dla gęstych wielomianów oznacza to, że mniejszy
+ * czynnik ma co najmniej @p threshold współczynników liczbowych. Wynik
+ * mnożenia nie zależy od progu.
+ * @param[in] threshold : nowy próg @f$threshold@f$
+ */
+void PolySetNttThreshold(size_t threshold);
+
+/**
+ * Ustawia liczbę wątków, między które rozdzielane jest mnożenie dużych
+ * rzadkich wielomianów. Domyślną wartość można podać w zmiennej środowiskowej
+ * POLY_THREADS. Wynik mnożenia nie zależy od liczby wątków.
+ * @param[in] threads : liczba wątków @f$threads@f$, dodatnia
+ */
+void PolySetThreads(size_t threads);
+
+/**
+ * Kończy wątki puli używanej przy równoległym mnożeniu. Wątki puli są
+ * tworzone przy pierwszym mnożeniu, które ich potrzebuje, i używane przez
+ * kolejne mnożenia; po wywołaniu tej funkcji następne mnożenie utworzy je
+ * ponownie.
+ */
+void PolyThreadsRelease(void);
+
 /**
  * Zwraca przeciwny wielomian.
  * @param[in] p : wielomian @f$p@f$
@@ -197,6 +395,49 @@ Poly PolyMul(const Poly *p, const Poly *q);
  */
 Poly PolyNeg(const Poly *p);
 
+/**
+ * Neguje wielomian w miejscu. Kopiowane są tylko tablice jednomianów
+ * współdzielone z innymi wielomianami.
+ * @param[in,out] p : wielomian @f$p@f$
+ */
+void PolyNegInPlace(Poly *p);
+
+/**
+ * Mnoży wielomian w miejscu przez współczynnik @p c. Jednomiany, których
+ * współczynniki się wyzerują, są usuwane, a wynik pozostaje w postaci
+ * kanonicznej.
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in] c : współczynnik @f$c@f$
+ */
+void PolyScaleInPlace(Poly *p, poly_coeff_t c);
+
+/**
+ * Mnoży wielomian w miejscu przez @f$x_0^n@f$, czyli zwiększa o @p n
+ * wykładniki wszystkich jego jednomianów. Jeśli największy wykładnik
+ * przekroczyłby INT_MAX, oznacza przekroczenie zakresu wykładników
+ * i pozostawia wielomian niezmieniony.
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, nieujemny
+ */
+void PolyShiftInPlace(Poly *p, poly_exp_t n);
+
+/**
+ * Cofa w miejscu wywołanie PolyShiftInPlace(p, n), czyli zmniejsza o @p n
+ * wykładniki wszystkich jednomianów wielomianu. Wielomian musi być wynikiem
+ * takiego wywołania, które go zmieniło. Nie alokuje pamięci.
+ * @param[in,out] p : wielomian @f$p@f$
+ * @param[in] n : wykładnik @f$n@f$, nieujemny
+ */
+void PolyUnshiftInPlace(Poly *p, poly_exp_t n);
+
+/**
+ * Wylicza, ile pamięci mogą zaalokować PolyNegInPlace, PolyScaleInPlace
+ * i PolyShiftInPlace, kopiując współdzielone tablice jednomianów wielomianu.
+ * @param[in] p : wielomian @f$p@f$
+ * @return górne ograniczenie wielkości kopii w bajtach
+ */
+size_t PolyUnshareBytes(const Poly *p);
+
 /**
  * Odejmuje wielomian od wielomianu.
  * @param[in] p : wielomian @f$p@f$
@@ -205,6 +446,16 @@ Poly PolyNeg(const Poly *p);
  */
 Poly PolySub(const Poly *p, const Poly *q);
 
+/**
+ * Odejmuje wielomian od wielomianu, przejmując oba na własność.
+ * Wielomian @p q jest negowany w miejscu i dodawany do @p p bez kopiowania.
+ * Po wywołaniu wielomiany @p p i @p q nie mogą być już używane ani usuwane.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p - q@f$
+ */
+Poly PolySubOwn(Poly *p, Poly *q);
+
 /**
  * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
  * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
@@ -245,6 +496,62 @@ bool PolyIsEq(const Poly *p, const Poly *q);
  */
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
+/**
+ * Wylicza wartości wielomianu w wielu punktach naraz. Dla każdego punktu
+ * @f$x_j@f$ zapisuje do @p out[j] wynik wywołania PolyAt(p, xs[j]).
+ * Drzewo wielomianu @p p jest przeglądane tylko raz dla wszystkich punktów.
+ * Jeśli współczynniki @p p są stałymi, wartości w punktach są liczone
+ * blokami punktów o stałej szerokości. W przeciwnym razie wynik dla każdego
+ * punktu jest osobnym wielomianem budowanym schematem Hornera.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] n : liczba punktów @f$n@f$
+ * @param[in] xs : tablica punktów @f$xs@f$
+ * @param[out] out : tablica na @p n wyników @f$out@f$
+ */
+void PolyAtMany(const Poly *p, size_t n, const poly_coeff_t xs[], Poly out[]);
+
+/**
+ * Wylicza wartość liczbową wielomianu po podstawieniu liczb pod wszystkie
+ * zmienne: @f$x[i]@f$ pod zmienną @f$x_i@f$ dla @f$i < nvars@f$ oraz zera
+ * pod pozostałe zmienne. Nie alokuje pamięci.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] nvars : długość tablicy wartości zmiennych @f$nvars@f$
+ * @param[in] x : tablica wartości zmiennych @f$x@f$
+ * @return @f$p(x_0, x_1, \ldots)@f$
+ */
+poly_coeff_t PolyEval(const Poly *p, size_t nvars, const poly_coeff_t x[]);
+
+/**
+ * To jest struktura przechowująca skompilowany plan wartościowania
+ * wielomianu, czyli zagnieżdżony schemat Hornera zapisany w płaskiej
+ * tablicy instrukcji. Plan nie zależy od wielomianu, z którego powstał.
+ */
+typedef struct PolyEvalPlan PolyEvalPlan;
+
+/**
+ * Tworzy plan wartościowania wielomianu.
+ * @param[in] p : wielomian @f$p@f$
+ * @return plan wartościowania wielomianu @p p
+ */
+PolyEvalPlan *PolyEvalPlanCreate(const Poly *p);
+
+/**
+ * Wylicza wartość liczbową wielomianu według planu, tak jak PolyEval.
+ * Nie alokuje pamięci, o ile wielomian nie jest bardzo głęboko zagnieżdżony.
+ * @param[in] plan : plan wartościowania @f$plan@f$
+ * @param[in] nvars : długość tablicy wartości zmiennych @f$nvars@f$
+ * @param[in] x : tablica wartości zmiennych @f$x@f$
+ * @return wartość wielomianu
+ */
+poly_coeff_t PolyEvalPlanRun(const PolyEvalPlan *plan, size_t nvars,
+                             const poly_coeff_t x[]);
+
+/**
+ * Usuwa plan wartościowania z pamięci. Dopuszcza wartość NULL.
+ * @param[in] plan : plan wartościowania @f$plan@f$
+ */
+void PolyEvalPlanDestroy(PolyEvalPlan *plan);
+
 /**
  * Sprawdza, czy wielomian jednomianu jest tożsamościowo równy zeru.
  * @param[in] m : jednomian
@@ -0,0 +1,512 @@
+/** @file
+  Pomiary wydajności biblioteki wielomianów rzadkich wielu zmiennych
+
+  @authors Jakub Krakowiak <jk429351@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+#define _POSIX_C_SOURCE 200809L
+
+#include "poly.h"
+#include "data_structures.h"
+#include "packed_poly.h"
+#include "input-output.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** To jest makrodefinicja reprezentująca liczbę jednomianów wielomianu
+ * wartościowanego w pomiarze AtBench. */
+#define AT_BENCH_SIZE 1000000
+
+/** To jest makrodefinicja reprezentująca liczbę jednomianów wielomianu
+ * wartościowanego w pomiarze AtManyBench. */
+#define AT_MANY_BENCH_SIZE 100000
+
+/** To jest makrodefinicja reprezentująca liczbę punktów w pomiarze
+ * AtManyBench. */
+#define AT_MANY_BENCH_POINTS 1000
+
+/** To jest makrodefinicja reprezentująca liczbę wartościowań w pomiarach
+ * EvalBench i EvalPlanBench. */
+#define EVAL_BENCH_RUNS 1000
+
+/** To jest makrodefinicja reprezentująca liczbę bajtów danych czytanych
+ * w pomiarach LineReadBench i MappedLineReadBench. */
+#define LINE_READ_BENCH_BYTES (256 << 20)
+
+/** To jest makrodefinicja reprezentująca długość jednoliniowego wielomianu
+ * wczytywanego w pomiarze PolyParseBench. */
+#define PARSE_BENCH_BYTES (100 << 20)
+
+/** To jest makrodefinicja reprezentująca długość jednoliniowego wielomianu
+ * wczytywanego w pomiarze PolyParseSmallBench. */
+#define PARSE_SMALL_BENCH_BYTES (10 << 20)
+
+/** To jest makrodefinicja reprezentująca liczbę jednomianów wielomianu
+ * wypisywanego w pomiarze PrintBench. */
+#define PRINT_BENCH_SIZE 1000000
+
+/** To jest makrodefinicja reprezentująca liczbę wypisań wielomianu
+ * w pomiarze PrintBench. */
+#define PRINT_BENCH_RUNS 10
+
+/** To jest makrodefinicja reprezentująca liczbę bajtów wypisywanych
+ * w pomiarze PrintBench: każdy jednomian zajmuje 19 znaków i jest
+ * zakończony znakiem '+' lub końca linii. */
+#define PRINT_BENCH_BYTES (20 * PRINT_BENCH_SIZE * PRINT_BENCH_RUNS)
+
+/** To jest zmienna, do której trafiają wyniki pomiarów, by kompilator nie
+ * pominął obliczeń. */
+static volatile poly_coeff_t benchSink;
+
+/**
+ * Zwraca bieżący czas zegara monotonicznego.
+ * @return czas w sekundach
+ */
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/**
+ * Tworzy wielomian jednej zmiennej o @p size jednomianach z pseudolosowymi
+ * współczynnikami i wykładnikami @f$0, 2, 4, \ldots@f$.
+ * @param[in] size : liczba jednomianów @f$size@f$
+ * @return utworzony wielomian
+ */
+static Poly MakeUnivariate(size_t size) {
+    Mono *monos = malloc(size * sizeof(Mono));
+    unsigned long seed = 1;
+
+    if (monos == NULL) {
+        exit(1);
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        Poly coeff = PolyFromCoeff((poly_coeff_t) (seed >> 33) | 1);
+        monos[i] = MonoFromPoly(&coeff, (poly_exp_t) (2 * i));
+    }
+
+    return PolyOwnMonos(size, monos);
+}
+
+/**
+ * Mierzy czas wartościowania wielomianu jednej zmiennej o AT_BENCH_SIZE
+ * jednomianach.
+ * @return czas w sekundach
+ */
+static double AtBench(void) {
+    Poly p = MakeUnivariate(AT_BENCH_SIZE);
+
+    double start = Now();
+    Poly result = PolyAt(&p, 3);
+    double time = Now() - start;
+
+    PolyDestroy(&result);
+    PolyDestroy(&p);
+
+    return time;
+}
+
+/**
+ * Mierzy czas wartościowania wielomianu jednej zmiennej o AT_MANY_BENCH_SIZE
+ * jednomianach w AT_MANY_BENCH_POINTS punktach naraz.
+ * @return czas w sekundach
+ */
+static double AtManyBench(void) {
+    Poly p = MakeUnivariate(AT_MANY_BENCH_SIZE);
+    poly_coeff_t xs[AT_MANY_BENCH_POINTS];
+    Poly results[AT_MANY_BENCH_POINTS];
+
+    for (size_t j = 0; j < AT_MANY_BENCH_POINTS; j++) {
+        xs[j] = (poly_coeff_t) j - AT_MANY_BENCH_POINTS / 2;
+    }
+
+    double start = Now();
+    PolyAtMany(&p, AT_MANY_BENCH_POINTS, xs, results);
+    double time = Now() - start;
+
+    for (size_t j = 0; j < AT_MANY_BENCH_POINTS; j++) {
+        PolyDestroy(&results[j]);
+    }
+
+    PolyDestroy(&p);
+
+    return time;
+}
+
+/**
+ * Tworzy wielomian trzech zmiennych o około 27 tysiącach jednomianów.
+ * @return utworzony wielomian
+ */
+static Poly MakeTrivariate(void) {
+    Mono *outer = malloc(30 * sizeof(Mono));
+
+    if (outer == NULL) {
+        exit(1);
+    }
+
+    for (poly_exp_t i = 0; i < 30; i++) {
+        Mono *middle = malloc(30 * sizeof(Mono));
+
+        if (middle == NULL) {
+            exit(1);
+        }
+
+        for (poly_exp_t j = 0; j < 30; j++) {
+            Poly inner = MakeUnivariate(30);
+            middle[j] = MonoFromPoly(&inner, j);
+        }
+
+        Poly middlePoly = PolyOwnMonos(30, middle);
+        outer[i] = MonoFromPoly(&middlePoly, i);
+    }
+
+    return PolyOwnMonos(30, outer);
+}
+
+/**
+ * Mierzy czas EVAL_BENCH_RUNS wartościowań wielomianu trzech zmiennych
+ * funkcją PolyEval.
+ * @return czas w sekundach
+ */
+static double EvalBench(void) {
+    Poly p = MakeTrivariate();
+    poly_coeff_t x[] = {3, 5, 7};
+
+    double start = Now();
+    for (int i = 0; i < EVAL_BENCH_RUNS; i++) {
+        x[0] = i;
+        benchSink += PolyEval(&p, 3, x);
+    }
+    double time = Now() - start;
+
+    PolyDestroy(&p);
+
+    return time;
+}
+
+/**
+ * Mierzy czas EVAL_BENCH_RUNS wartościowań wielomianu trzech zmiennych
+ * według skompilowanego planu.
+ * @return czas w sekundach
+ */
+static double EvalPlanBench(void) {
+    Poly p = MakeTrivariate();
+    PolyEvalPlan *plan = PolyEvalPlanCreate(&p);
+    poly_coeff_t x[] = {3, 5, 7};
+
+    double start = Now();
+    for (int i = 0; i < EVAL_BENCH_RUNS; i++) {
+        x[0] = i;
+        benchSink += PolyEvalPlanRun(plan, 3, x);
+    }
+    double time = Now() - start;
+
+    PolyEvalPlanDestroy(plan);
+    PolyDestroy(&p);
+
+    return time;
+}
+
+/**
+ * Mierzy czas EVAL_BENCH_RUNS porównań dwóch równych, osobno utworzonych
+ * wielomianów trzech zmiennych po ich internowaniu.
+ * @return czas w sekundach
+ */
+static double InternIsEqBench(void) {
+    Poly p = MakeTrivariate();
+    Poly q = MakeTrivariate();
+
+    double start = Now();
+    p = PolyIntern(&p);
+    q = PolyIntern(&q);
+    for (int i = 0; i < EVAL_BENCH_RUNS; i++) {
+        benchSink += PolyIsEq(&p, &q);
+    }
+    double time = Now() - start;
+
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+
+    return time;
+}
+
+/**
+ * Mierzy czas EVAL_BENCH_RUNS porównań dwóch równych, osobno utworzonych
+ * wielomianów trzech zmiennych bez internowania.
+ * @return czas w sekundach
+ */
+static double IsEqBench(void) {
+    Poly p = MakeTrivariate();
+    Poly q = MakeTrivariate();
+
+    double start = Now();
+    for (int i = 0; i < EVAL_BENCH_RUNS; i++) {
+        benchSink += PolyIsEq(&p, &q);
+    }
+    double time = Now() - start;
+
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+
+    return time;
+}
+
+/**
+ * Mierzy czas EVAL_BENCH_RUNS porównań dwóch równych, osobno utworzonych
+ * wielomianów trzech zmiennych po ich spakowaniu.
+ * @return czas w sekundach
+ */
+static double PackedIsEqBench(void) {
+    Poly p = MakeTrivariate();
+    Poly q = MakeTrivariate();
+
+    double start = Now();
+    PackedPoly *packedP = PolyPack(&p);
+    PackedPoly *packedQ = PolyPack(&q);
+    for (int i = 0; i < EVAL_BENCH_RUNS; i++) {
+        benchSink += PackedPolyIsEq(packedP, packedQ);
+    }
+    double time = Now() - start;
+
+    PackedPolyDestroy(packedP);
+    PackedPolyDestroy(packedQ);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+
+    return time;
+}
+
+/**
+ * Tworzy plik tymczasowy o wielkości LINE_READ_BENCH_BYTES złożony z krótkich
+ * komend i wielomianów.
+ * @return plik ustawiony na początek
+ */
+static FILE *MakeLineReadFile(void) {
+    static const char pattern[] = "(1,2)+(3,4)\nPRINT\n(-5,0)\nADD\n"
+                                  "DEG_BY 1\n# komentarz\n";
+    size_t patternLength = strlen(pattern);
+    size_t blockLength = 1 << 16;
+    char *block = malloc(blockLength);
+    FILE *file = tmpfile();
+
+    if (block == NULL || file == NULL) {
+        exit(1);
+    }
+
+    blockLength -= blockLength % patternLength;
+
+    for (size_t i = 0; i < blockLength; i += patternLength) {
+        memcpy(block + i, pattern, patternLength);
+    }
+
+    for (size_t written = 0; written < LINE_READ_BENCH_BYTES;
+         written += blockLength) {
+        fwrite(block, 1, blockLength, file);
+    }
+
+    fflush(file);
+    free(block);
+    rewind(file);
+
+    return file;
+}
+
+/**
+ * Mierzy czas wczytania wszystkich linii pliku czytnikiem.
+ * @param[in] file : plik @f$file@f$
+ * @param[in] mapped : czy plik ma zostać odwzorowany w pamięci
+ * @return czas w sekundach
+ */
+static double LineReadTime(FILE *file, bool mapped) {
+    double start = Now();
+    LineReader reader = mapped ? LineReaderMap(fileno(file)) :
+            LineReaderInit(fileno(file));
+    while (LineReaderHasNext(&reader)) {
+        benchSink += (poly_coeff_t) LineReaderRead(&reader).lineLength;
+    }
+    double time = Now() - start;
+
+    LineReaderDestroy(&reader);
+    fclose(file);
+
+    return time;
+}
+
+/**
+ * Mierzy czas wczytania funkcją read pliku o wielkości LINE_READ_BENCH_BYTES
+ * złożonego z krótkich komend i wielomianów.
+ * @return czas w sekundach
+ */
+static double LineReadBench(void) {
+    return LineReadTime(MakeLineReadFile(), false);
+}
+
+/**
+ * Mierzy czas wczytania odwzorowanego w pamięci pliku o wielkości
+ * LINE_READ_BENCH_BYTES złożonego z krótkich komend i wielomianów.
+ * @return czas w sekundach
+ */
+static double MappedLineReadBench(void) {
+    return LineReadTime(MakeLineReadFile(), true);
+}
+
+/**
+ * Mierzy czas wczytania wielomianu zapisanego w jednej linii jako suma
+ * @f$(1,0)+(2,1)+(3,2)+\ldots@f$ o długości co najmniej @p bytes znaków.
+ * @param[in] bytes : długość linii @f$bytes@f$
+ * @return czas w sekundach
+ */
+static double PolyParseTime(size_t bytes) {
+    char *string = malloc(bytes + 32);
+    size_t length = 0;
+
+    if (string == NULL) {
+        exit(1);
+    }
+
+    for (poly_exp_t exp = 0; length < bytes; exp++) {
+        if (exp > 0) {
+            string[length++] = '+';
+        }
+
+        length += (size_t) sprintf(string + length, "(%d,%d)", exp % 9 + 1,
+                                   exp);
+    }
+
+    Poly p;
+    double start = Now();
+    bool correct = PolyParse((Line) {.string = string, .lineLength = length},
+                             &p);
+    double time = Now() - start;
+
+    if (!correct) {
+        exit(1);
+    }
+
+    PolyDestroy(&p);
+    free(string);
+
+    return time;
+}
+
+/**
+ * Mierzy czas wczytania wielomianu w linii o długości PARSE_BENCH_BYTES.
+ * @return czas w sekundach
+ */
+static double PolyParseBench(void) {
+    return PolyParseTime(PARSE_BENCH_BYTES);
+}
+
+/**
+ * Mierzy czas wczytania wielomianu w linii o długości
+ * PARSE_SMALL_BENCH_BYTES, by porównać przepustowość z PolyParseBench.
+ * @return czas w sekundach
+ */
+static double PolyParseSmallBench(void) {
+    return PolyParseTime(PARSE_SMALL_BENCH_BYTES);
+}
+
+/**
+ * Mierzy czas PRINT_BENCH_RUNS wypisań do /dev/null wielomianu jednej
+ * zmiennej o PRINT_BENCH_SIZE jednomianach z dziewięciocyfrowymi
+ * współczynnikami i siedmiocyfrowymi wykładnikami.
+ * @return czas w sekundach
+ */
+static double PrintBench(void) {
+    Mono *monos = malloc(PRINT_BENCH_SIZE * sizeof(Mono));
+    OutputSink *sink = malloc(sizeof(OutputSink));
+    int fd = open("/dev/null", O_WRONLY);
+    unsigned long seed = 1;
+
+    if (monos == NULL || sink == NULL || fd < 0) {
+        exit(1);
+    }
+
+    for (size_t i = 0; i < PRINT_BENCH_SIZE; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        Poly coeff = PolyFromCoeff((poly_coeff_t) (100000000 +
+                (seed >> 33) % 900000000));
+        monos[i] = MonoFromPoly(&coeff, (poly_exp_t) (1000000 + i));
+    }
+
+    Poly p = PolyOwnMonos(PRINT_BENCH_SIZE, monos);
+    OutputSinkInitFd(sink, fd);
+
+    double start = Now();
+    for (int i = 0; i < PRINT_BENCH_RUNS; i++) {
+        PolyWrite(sink, &p);
+    }
+    OutputSinkFlush(sink);
+    double time = Now() - start;
+
+    close(fd);
+    free(sink);
+    PolyDestroy(&p);
+
+    return time;
+}
+
+/**
+ * To jest struktura opisująca pomiar.
+ */
+typedef struct {
+    char const *name; ///< nazwa pomiaru
+    double (*function)(void); ///< funkcja wykonująca pomiar
+    size_t bytes; ///< liczba przetwarzanych bajtów lub zero
+} bench_list_t;
+
+/** To jest makrodefinicja tworząca opis pomiaru z nazwy funkcji. */
+#define BENCH(b) {#b, b, 0}
+
+/** To jest makrodefinicja tworząca opis pomiaru przepustowości z nazwy
+ * funkcji i liczby przetwarzanych bajtów. */
+#define BENCH_BYTES(b, n) {#b, b, n}
+
+/** To jest lista pomiarów. */
+static const bench_list_t bench_list[] = {
+        BENCH(AtBench),
+        BENCH(AtManyBench),
+        BENCH(EvalBench),
+        BENCH(EvalPlanBench),
+        BENCH(IsEqBench),
+        BENCH(InternIsEqBench),
+        BENCH(PackedIsEqBench),
+        BENCH_BYTES(LineReadBench, LINE_READ_BENCH_BYTES),
+        BENCH_BYTES(MappedLineReadBench, LINE_READ_BENCH_BYTES),
+        BENCH_BYTES(PolyParseSmallBench, PARSE_SMALL_BENCH_BYTES),
+        BENCH_BYTES(PolyParseBench, PARSE_BENCH_BYTES),
+        BENCH_BYTES(PrintBench, PRINT_BENCH_BYTES),
+};
+
+/**
+ * Wykonuje wszystkie pomiary i wypisuje ich czasy.
+ * @return 0
+ */
+int main() {
+    for (size_t i = 0; i < sizeof(bench_list) / sizeof(bench_list[0]); i++) {
+        double time = bench_list[i].function();
+        printf("%s: %.3f s", bench_list[i].name, time);
+
+        if (bench_list[i].bytes > 0) {
+            printf(" (%.0f MB/s)", (double) bench_list[i].bytes / time / 1e6);
+        }
+
+        printf("\n");
+    }
+
+    PoolStats stats = PoolStatsGet();
+    printf("pool: %zu allocations, %zu cache hits, %zu frees\n",
+           stats.allocations, stats.cacheHits, stats.frees);
+    PoolRelease();
+
+    return 0;
+}
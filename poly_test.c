@@ -2,15 +2,21 @@
 #undef NDEBUG
 #endif
 
+#define _DEFAULT_SOURCE
+
 #include "poly.h"
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include "input-output.h"
+#include "data_structures.h"
+#include "lexer.h"
 
 /** DANE DO TESTÓW **/
 
@@ -2912,6 +2918,15 @@ static bool TestSub(Poly a, Poly b, Poly res) {
     return TestOpCopy(a, b, res, PolySub);
 }
 
+static bool TestPow(Poly a, poly_exp_t n, Poly res) {
+    Poly b = PolyPow(&a, n);
+    bool is_eq = PolyIsEq(&b, &res);
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    PolyDestroy(&res);
+    return is_eq;
+}
+
 static bool TestDegBy(Poly a, size_t var_idx, poly_exp_t res) {
     bool is_eq = PolyDegBy(&a, var_idx) == res;
     PolyDestroy(&a);
@@ -3085,6 +3100,890 @@ static bool SimpleSubTest(void) {
                    P(P(C(1), 0, C(4), 1, C(1), 2), 1));
 }
 
+static bool SimplePowTest(void) {
+    bool res = true;
+    res &= TestPow(C(3), 4, C(81));
+    res &= TestPow(C(0), 0, C(1));
+    res &= TestPow(P(C(2), 1, C(1), 2), 0, C(1));
+    res &= TestPow(P(C(2), 3), 5, P(C(32), 15));
+    res &= TestPow(P(C(1), 0, C(1), 1), 4,
+                   P(C(1), 0, C(4), 1, C(6), 2, C(4), 3, C(1), 4));
+    res &= TestPow(P(C(1L << 32), 1, C(1), 2), 2, P(C(1L << 33), 3, C(1), 4));
+    res &= TestPow(P(C(LONG_MIN), 1), 2, C(0));
+    res &= TestPow(P(C(1), 0, C(1), 1), 64,
+                   P(C(1), 0, C(64), 1, C(2016), 2, C(41664), 3, C(635376), 4,
+                     C(7624512), 5, C(74974368), 6, C(621216192), 7,
+                     C(4426165368), 8, C(27540584512), 9, C(151473214816), 10,
+                     C(743595781824), 11, C(3284214703056), 12,
+                     C(13136858812224), 13, C(47855699958816), 14,
+                     C(159518999862720), 15, C(488526937079580), 16,
+                     C(1379370175283520), 17, C(3601688791018080), 18,
+                     C(8719878125622720), 19, C(19619725782651120), 20,
+                     C(41107996877935680), 21, C(80347448443237920), 22,
+                     C(146721427591999680), 23, C(250649105469666120), 24,
+                     C(401038568751465792), 25, C(601557853127198688), 26,
+                     C(846636978475316672), 27, C(1118770292985239888), 28,
+                     C(1388818294740297792), 29, C(1620288010530347424), 30,
+                     C(1777090076065542336), 31, C(1832624140942590534), 32,
+                     C(1777090076065542336), 33, C(1620288010530347424), 34,
+                     C(1388818294740297792), 35, C(1118770292985239888), 36,
+                     C(846636978475316672), 37, C(601557853127198688), 38,
+                     C(401038568751465792), 39, C(250649105469666120), 40,
+                     C(146721427591999680), 41, C(80347448443237920), 42,
+                     C(41107996877935680), 43, C(19619725782651120), 44,
+                     C(8719878125622720), 45, C(3601688791018080), 46,
+                     C(1379370175283520), 47, C(488526937079580), 48,
+                     C(159518999862720), 49, C(47855699958816), 50,
+                     C(13136858812224), 51, C(3284214703056), 52,
+                     C(743595781824), 53, C(151473214816), 54,
+                     C(27540584512), 55, C(4426165368), 56, C(621216192), 57,
+                     C(74974368), 58, C(7624512), 59, C(635376), 60,
+                     C(41664), 61, C(2016), 62, C(64), 63, C(1), 64));
+
+    Poly a = P(P(C(1), 1), 0, C(2), 1, P(C(1), 0, C(-1), 2), 3);
+    Poly b = PolyClone(&a);
+
+    for (int i = 1; i < 7; i++) {
+        Poly holder = PolyMul(&b, &a);
+        PolyDestroy(&b);
+        b = holder;
+    }
+
+    res &= TestPow(a, 7, b);
+    return res;
+}
+
+static bool BinomialPowTest(void) {
+    bool res = true;
+    Poly binomials[] = {P(C(3), 1, C(-2), 2), P(C(2), 0, C(5), 1),
+                        P(P(C(1), 1), 1, C(1), 2),
+                        P(C(-7), 2, P(C(1), 0, C(3), 1), 5)};
+    poly_exp_t exps[] = {100, 70, 70, 65};
+
+    for (size_t i = 0; i < sizeof(exps) / sizeof(exps[0]); i++) {
+        Poly expected = PolyClone(&binomials[i]);
+
+        for (poly_exp_t k = 1; k < exps[i]; k++) {
+            Poly holder = PolyMul(&expected, &binomials[i]);
+            PolyDestroy(&expected);
+            expected = holder;
+        }
+
+        res &= TestPow(binomials[i], exps[i], expected);
+    }
+
+    return res;
+}
+
+static bool SimpleComposeTest(void) {
+    bool res = true;
+    Poly p = P(P(C(1), 0, C(2), 1), 0, C(3), 1, P(C(1), 1), 2);
+    Poly q[] = {P(C(1), 1), C(5)};
+
+    Poly a = PolyCompose(&p, 0, q);
+    Poly b = PolyCompose(&p, 1, q + 1);
+    Poly c = PolyCompose(&p, 2, q);
+    Poly expectedA = C(1);
+    Poly expectedB = C(16);
+    Poly expectedC = P(C(16), 0, C(27), 1);
+    res &= PolyIsEq(&a, &expectedA);
+    res &= PolyIsEq(&b, &expectedB);
+    res &= PolyIsEq(&c, &expectedC);
+
+    PolyDestroy(&p);
+    PolyDestroy(&q[0]);
+    PolyDestroy(&q[1]);
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    PolyDestroy(&c);
+    PolyDestroy(&expectedA);
+    PolyDestroy(&expectedB);
+    PolyDestroy(&expectedC);
+    return res;
+}
+
+static bool TestCompose(Poly p, size_t k, Poly q[], Poly res) {
+    Poly b = PolyCompose(&p, k, q);
+    bool is_eq = PolyIsEq(&b, &res);
+    PolyDestroy(&p);
+    for (size_t i = 0; i < k; ++i)
+        PolyDestroy(&q[i]);
+    PolyDestroy(&b);
+    PolyDestroy(&res);
+    return is_eq;
+}
+
+static bool SparseComposeTest(void) {
+    bool res = true;
+    // Duże luki między wykładnikami
+    res &= TestCompose(P(C(3), 0, C(2), 5, C(1), 100, C(-1), 1000), 1,
+                       (Poly[]){P(C(1), 3)},
+                       P(C(3), 0, C(2), 15, C(1), 300, C(-1), 3000));
+    res &= TestCompose(P(C(1), 1, C(1), 4, C(1), 35), 1,
+                       (Poly[]){P(C(-1), 2)},
+                       P(C(-1), 2, C(1), 8, C(-1), 70));
+    res &= TestCompose(P(C(1), 1, C(2), 11, C(3), 21, C(4), 31), 1,
+                       (Poly[]){P(C(-1), 1)},
+                       P(C(-1), 1, C(-2), 11, C(-3), 21, C(-4), 31));
+    res &= TestCompose(P(C(1), 0, C(1), 3, C(1), 7), 1,
+                       (Poly[]){P(C(1), 0, C(1), 1)},
+                       P(C(3), 0, C(10), 1, C(24), 2, C(36), 3, C(35), 4,
+                         C(21), 5, C(7), 6, C(1), 7));
+    res &= TestCompose(P(P(C(1), 0, C(1), 4), 2, C(3), 9), 2,
+                       (Poly[]){C(2), P(C(1), 1)},
+                       P(C(17), 2, C(3), 9));
+    res &= TestCompose(P(P(C(1), 6), 3, P(C(-2), 2), 50), 2,
+                       (Poly[]){P(C(1), 1), P(C(1), 2)},
+                       P(C(1), 12, C(-2), 102));
+    // Więcej podstawianych wielomianów niż zmiennych - pod x_0 podstawiany
+    // jest q[k - 1], a nadmiarowe q[0], ... są pomijane
+    res &= TestCompose(P(C(1), 1, C(1), 3), 3,
+                       (Poly[]){C(7), P(C(1), 1), C(2)},
+                       C(10));
+    res &= TestCompose(P(C(1), 1, C(1), 3), 3,
+                       (Poly[]){P(C(1), 1), C(5), P(C(1), 2)},
+                       P(C(1), 2, C(1), 6));
+    res &= TestCompose(C(4), 2,
+                       (Poly[]){P(C(1), 1), C(5)},
+                       C(4));
+    // Mniej podstawianych wielomianów niż zmiennych - pod resztę zera
+    res &= TestCompose(P(P(C(1), 2), 0, C(1), 4), 1,
+                       (Poly[]){P(C(1), 1)},
+                       P(C(1), 4));
+    res &= TestCompose(P(P(C(1), 0, C(1), 2), 0, P(C(3), 7), 40), 1,
+                       (Poly[]){C(-1)},
+                       C(1));
+    res &= TestCompose(P(C(5), 0, C(1), 3), 0, NULL, C(5));
+    res &= TestCompose(P(C(1), 3, C(1), 1000), 0, NULL, C(0));
+    return res;
+}
+
+static bool SimpleOwnTest(void) {
+    bool res = true;
+    Poly a = P(P(C(1), 0, C(2), 1), 0, C(3), 1);
+    Poly b = P(P(C(-1), 0), 0, C(1), 2);
+    Poly sum = PolyAdd(&a, &b);
+    Poly difference = PolySub(&a, &b);
+    Poly product = PolyMul(&a, &b);
+    Poly minCoeff = C(LONG_MIN);
+    Poly scaled = PolyMul(&a, &minCoeff);
+
+    Poly a1 = PolyClone(&a);
+    Poly b1 = PolyClone(&b);
+    Poly own = PolyAddOwn(&a1, &b1);
+    res &= PolyIsEq(&own, &sum);
+    PolyDestroy(&own);
+
+    a1 = PolyClone(&a);
+    b1 = PolyClone(&b);
+    own = PolySubOwn(&a1, &b1);
+    res &= PolyIsEq(&own, &difference);
+    PolyDestroy(&own);
+
+    a1 = PolyClone(&a);
+    b1 = PolyClone(&b);
+    own = PolyMulOwn(&a1, &b1);
+    res &= PolyIsEq(&own, &product);
+    PolyDestroy(&own);
+
+    a1 = PolyClone(&a);
+    own = PolyMulOwn(&minCoeff, &a1);
+    res &= PolyIsEq(&own, &scaled);
+    PolyDestroy(&own);
+
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    PolyDestroy(&sum);
+    PolyDestroy(&difference);
+    PolyDestroy(&product);
+    PolyDestroy(&scaled);
+    return res;
+}
+
+static bool SimpleInPlaceTest(void) {
+    bool res = true;
+    Poly p = P(P(C(1), 0, C(2), 1), 0, C(LONG_MIN), 1);
+    Poly a = PolyClone(&p);
+    Poly expected = P(P(C(-1), 0, C(-2), 1), 0, C(LONG_MIN), 1);
+    PolyNegInPlace(&a);
+    res &= PolyIsEq(&a, &expected);
+    PolyDestroy(&expected);
+
+    PolyScaleInPlace(&a, 3);
+    expected = P(P(C(-3), 0, C(-6), 1), 0, C(LONG_MIN), 1);
+    res &= PolyIsEq(&a, &expected);
+    PolyDestroy(&expected);
+
+    PolyScaleInPlace(&a, 0);
+    res &= PolyIsZero(&a);
+
+    PolyShiftInPlace(&a, 2);
+    res &= PolyIsZero(&a);
+
+    a = PolyClone(&p);
+    res &= PolyUnshareBytes(&a) > 0;
+    PolyShiftInPlace(&a, 2);
+    expected = P(P(C(1), 0, C(2), 1), 2, C(LONG_MIN), 3);
+    res &= PolyIsEq(&a, &expected);
+    res &= PolyUnshareBytes(&a) > 0 && PolyUnshareBytes(&expected) == 0;
+    PolyDestroy(&expected);
+    PolyUnshiftInPlace(&a, 2);
+    res &= PolyIsEq(&a, &p);
+    PolyDestroy(&a);
+
+    a = C(5);
+    PolyShiftInPlace(&a, 3);
+    expected = P(C(5), 3);
+    res &= PolyIsEq(&a, &expected);
+    PolyDestroy(&expected);
+    PolyUnshiftInPlace(&a, 3);
+    res &= PolyIsCoeff(&a) && PolyGetCoeff(&a) == 5;
+    PolyDestroy(&a);
+    PolyDestroy(&p);
+
+    return res;
+}
+
+static bool SimpleCloneTest(void) {
+    bool res = true;
+    Poly p = P(P(C(1), 0, C(2), 1), 0, C(3), 2);
+    Poly expected = P(P(C(1), 0, C(2), 1), 0, C(3), 2);
+    Poly a = PolyClone(&p);
+    Poly b = PolyClone(&a);
+
+    PolyNegInPlace(&a);
+    PolyShiftInPlace(&b, 1);
+    res &= PolyIsEq(&p, &expected);
+
+    Poly c = PolyClone(&p);
+    Poly d = PolyClone(&p);
+    Poly sum = PolyAddOwn(&c, &d);
+    Poly doubled = P(P(C(2), 0, C(4), 1), 0, C(6), 2);
+    res &= PolyIsEq(&sum, &doubled);
+    res &= PolyIsEq(&p, &expected);
+
+    Poly neg = PolyNeg(&expected);
+    res &= PolyIsEq(&a, &neg);
+
+    PolyDestroy(&p);
+    Poly shifted = P(P(C(1), 0, C(2), 1), 1, C(3), 3);
+    res &= PolyIsEq(&b, &shifted);
+    PolyDestroy(&shifted);
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    PolyDestroy(&sum);
+    PolyDestroy(&doubled);
+    PolyDestroy(&neg);
+    PolyDestroy(&expected);
+
+    return res;
+}
+
+static bool SimpleInternTest(void) {
+    bool res = true;
+    Poly a = P(C(-7), 8, P(C(1), 2), 15);
+    Poly b = P(C(-7), 8, P(C(1), 2), 15);
+    Poly c = P(C(-7), 9, P(C(1), 2), 15);
+    a = PolyIntern(&a);
+    b = PolyIntern(&b);
+    c = PolyIntern(&c);
+
+    res &= PolyIsEq(&a, &b);
+    res &= !PolyIsEq(&a, &c);
+    Mono single;
+    res &= PolyMonos(&a, &single) == PolyMonos(&b, &single);
+    res &= PolyMonos(&PolyMonos(&a, &single)[1].p, &single) ==
+           PolyMonos(&PolyMonos(&c, &single)[1].p, &single);
+
+    Poly d = PolyClone(&a);
+    PolyNegInPlace(&d);
+    res &= !PolyIsEq(&a, &d);
+    res &= PolyIsEq(&a, &b);
+
+    PolyDestroy(&a);
+    PolyDestroy(&d);
+    Poly e = P(C(-7), 8, P(C(1), 2), 15);
+    res &= PolyIsEq(&b, &e);
+    e = PolyIntern(&e);
+    res &= PolyMonos(&b, &single) == PolyMonos(&e, &single);
+
+    PolyDestroy(&b);
+    PolyDestroy(&c);
+    PolyDestroy(&e);
+
+    return res;
+}
+
+static bool SimplePoolTest(void) {
+    bool res = true;
+    PoolRelease();
+    PoolStats before = PoolStatsGet();
+    void *small = securePoolMalloc(40);
+    void *large = securePoolMalloc(1 << 20);
+    securePoolFree(small, 40);
+    securePoolFree(large, 1 << 20);
+    void *again = securePoolMalloc(48);
+    res &= again == small;
+    securePoolFree(again, 48);
+    securePoolFree(NULL, 48);
+
+    PoolStats after = PoolStatsGet();
+    res &= after.allocations - before.allocations == 3;
+    res &= after.cacheHits - before.cacheHits == 1;
+    res &= after.frees - before.frees == 3;
+    PoolRelease();
+
+    return res;
+}
+
+static bool SimpleInlineTest(void) {
+    bool res = true;
+    Poly a = P(C(5), 3);
+    Poly b = P(C(-5), 3);
+    Poly c = P(C(2), 1);
+    res &= PolyIsInline(&a) && !PolyIsCoeff(&a) && !PolyIsZero(&a);
+    res &= PolyMonoCount(&a) == 1;
+
+    Poly sum = PolyAdd(&a, &b);
+    res &= PolyIsZero(&sum);
+    sum = PolyAdd(&a, &a);
+    Poly expected = P(C(10), 3);
+    res &= PolyIsInline(&sum) && PolyIsEq(&sum, &expected);
+    PolyDestroy(&sum);
+    sum = PolyAdd(&a, &c);
+    res &= !PolyIsInline(&sum) && PolyMonoCount(&sum) == 2;
+    PolyDestroy(&sum);
+
+    Poly product = PolyMul(&a, &c);
+    expected = P(C(10), 4);
+    res &= PolyIsInline(&product) && PolyIsEq(&product, &expected);
+    PolyShiftInPlace(&product, 2);
+    PolyNegInPlace(&product);
+    expected = P(C(-10), 6);
+    res &= PolyIsEq(&product, &expected);
+    PolyScaleInPlace(&product, 0);
+    res &= PolyIsZero(&product);
+
+    Poly nested = P(P(C(5), 3), 1);
+    Mono single;
+    res &= !PolyIsInline(&nested) &&
+           PolyIsInline(&PolyMonos(&nested, &single)[0].p);
+    PolyDestroy(&nested);
+
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    PolyDestroy(&c);
+
+    return res;
+}
+
+static bool SimpleArenaTest(void) {
+    bool res = true;
+    ArenaMark mark = ArenaGetMark();
+    char *first = ArenaAlloc(3);
+    ArenaMark inner = ArenaGetMark();
+    char *second = ArenaAlloc(sizeof(long));
+    res &= second - first == sizeof(max_align_t);
+
+    ArenaRelease(inner);
+    res &= ArenaAlloc(sizeof(long)) == second;
+
+    char *large = ArenaAlloc(1 << 20);
+    large[(1 << 20) - 1] = 1;
+    ArenaRelease(inner);
+    res &= ArenaAlloc(1) == second;
+
+    ArenaRelease(mark);
+    ArenaReset();
+
+    return res;
+}
+
+static bool SimplePackedTest(void) {
+    bool res = true;
+    Poly polys[] = {C(0), C(-7), P(C(5), 3),
+                    P(P(C(1), 3), 0, P(C(1), 2), 2, C(1), 3),
+                    P(P(P(C(2), 1, C(3), 4), 0, C(-1), 1), 1, C(4), 5),
+                    P(P(P(C(1), 1), 0, C(2), 1), 0,
+                      P(P(C(-1), 1), 0, C(-2), 1, C(7), 2), 1,
+                      P(C(-5), 0, C(1), 3), 2)};
+    size_t count = sizeof(polys) / sizeof(polys[0]);
+    PackedPoly *packed[sizeof(polys) / sizeof(polys[0])];
+
+    for (size_t i = 0; i < count; i++) {
+        packed[i] = PolyPack(&polys[i]);
+        Poly unpacked = PolyUnpack(packed[i]);
+        res &= PolyIsEq(&unpacked, &polys[i]);
+        PolyDestroy(&unpacked);
+        res &= PackedPolyDeg(packed[i]) == PolyDeg(&polys[i]);
+
+        for (size_t var = 0; var < 4; var++) {
+            res &= PackedPolyDegBy(packed[i], var) ==
+                   PolyDegBy(&polys[i], var);
+        }
+
+        for (poly_coeff_t x = -2; x <= 2; x++) {
+            Poly expected = PolyAt(&polys[i], x);
+            Poly result = PackedPolyAt(packed[i], x);
+            res &= PolyIsEq(&result, &expected);
+            PolyDestroy(&expected);
+            PolyDestroy(&result);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < count; j++) {
+            res &= PackedPolyIsEq(packed[i], packed[j]) == (i == j);
+        }
+    }
+
+    PackedPoly *copy = PolyPack(&polys[count - 1]);
+    res &= PackedPolyIsEq(copy, packed[count - 1]);
+    PackedPolyDestroy(copy);
+
+    for (size_t i = 0; i < count; i++) {
+        PackedPolyDestroy(packed[i]);
+        PolyDestroy(&polys[i]);
+    }
+
+    return res;
+}
+
+static bool SimpleMemoryTest(void) {
+    bool res = true;
+    MemoryStats before = MemoryStatsGet();
+    Poly p = P(P(C(1), 1, C(2), 2), 0, C(3), 2);
+    MemoryStats during = MemoryStatsGet();
+    res &= during.monos - before.monos == 4;
+    res &= during.liveBytes > before.liveBytes;
+    res &= during.peakBytes >= during.liveBytes;
+    res &= during.allocations - before.allocations >= 2;
+
+    size_t bytes = 0;
+    size_t arrays = 0;
+    size_t monos = 0;
+    PolyMemoryUsage(&p, &bytes, &arrays, &monos);
+    res &= bytes == during.liveBytes - before.liveBytes;
+    res &= arrays == 2 && monos == 4;
+
+    PolyStack s = PolyStackInit();
+    PolyStackPush(&s, PolyClone(&p));
+    PolyStackPackTop(&s);
+    MemoryStats entry = PolyStackEntryMemory(&s, 0);
+    res &= entry.liveBytes > bytes && entry.allocations == 3;
+    res &= entry.monos == 4;
+    PolyStackDestroy(&s);
+
+    MemoryWindowReset();
+    PolyDestroy(&p);
+    MemoryStats after = MemoryStatsGet();
+    res &= after.liveBytes == before.liveBytes;
+    res &= after.monos == before.monos;
+    res &= after.windowPeakBytes == during.liveBytes;
+
+    return res;
+}
+
+static bool SimpleMemoryLimitTest(void) {
+    bool res = true;
+    Mono *monos = malloc(200 * sizeof(Mono));
+    assert(monos);
+
+    for (size_t i = 0; i < 200; i++) {
+        monos[i] = M(C(1), (poly_exp_t) i);
+    }
+
+    Poly p = PolyOwnMonos(200, monos);
+    MemoryStats before = MemoryStatsGet();
+    MemorySetLimit(before.liveBytes + 1000);
+    MemoryLimitClear();
+    res &= MemoryReserve(1000) && !MemoryReserve(1001);
+    res &= MemoryLimitExceeded();
+
+    MemoryLimitClear();
+    Poly q = PolyMul(&p, &p);
+    res &= MemoryLimitExceeded();
+    PolyDestroy(&q);
+
+    PolyStack s = PolyStackInit();
+    PolyStackPush(&s, PolyClone(&p));
+    MemoryLimitClear();
+    size_t allocations = MemoryStatsGet().allocations;
+    res &= !PolyStackPackTop(&s) && PolyStackPeekPacked(&s, 0) == NULL;
+    res &= MemoryStatsGet().allocations == allocations;
+    PolyStackDestroy(&s);
+
+    MemorySetLimit(0);
+    MemoryLimitClear();
+    q = PolyMul(&p, &p);
+    res &= !MemoryLimitExceeded() && PolyDeg(&q) == 398;
+    res &= MemoryReserve(SIZE_MAX);
+    PolyDestroy(&q);
+    PolyDestroy(&p);
+
+    return res;
+}
+
+static bool PowMemoryLimitTest(void) {
+    bool res = true;
+    Poly p = P(C(1), 0, C(1), 1);
+    Poly q = P(C(1), 0, C(1), 1, C(1), 2);
+    MemoryStats before = MemoryStatsGet();
+    MemorySetLimit(before.liveBytes + 1000000);
+
+    MemoryLimitClear();
+    Poly r = PolyPow(&p, 100000000);
+    res &= MemoryLimitExceeded();
+    PolyDestroy(&r);
+
+    MemoryLimitClear();
+    res &= !PolyPowWithinLimit(&p, 100000000, &r);
+    PolyDestroy(&r);
+
+    MemoryLimitClear();
+    r = PolyPow(&q, 100000);
+    res &= MemoryLimitExceeded();
+    PolyDestroy(&r);
+
+    MemoryLimitClear();
+    Poly s = PolyCompose(&p, 1, &q);
+    Poly expected = P(C(2), 0, C(1), 1, C(1), 2);
+    res &= !MemoryLimitExceeded() && PolyIsEq(&s, &expected);
+    PolyDestroy(&s);
+    PolyDestroy(&expected);
+
+    ArenaMark mark = ArenaGetMark();
+    MemoryLimitClear();
+    ArenaAlloc(2000000);
+    res &= MemoryLimitExceeded();
+    ArenaRelease(mark);
+    ArenaReset();
+
+    MemorySetLimit(0);
+    MemoryLimitClear();
+    r = PolyPow(&p, 3);
+    expected = P(C(1), 0, C(3), 1, C(3), 2, C(1), 3);
+    res &= !MemoryLimitExceeded() && PolyIsEq(&r, &expected);
+    PolyDestroy(&r);
+    PolyDestroy(&expected);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+
+    return res;
+}
+
+static bool TestLexNumber(const char *string) {
+    size_t length = strlen(string);
+    LexedNumber number = LexNumber(string, length);
+    bool overflow;
+    char *end;
+    errno = 0;
+    long value = strtol(string, &end, 10);
+    bool res = LexedToLong(number, &overflow) == value &&
+               overflow == (errno == ERANGE) &&
+               number.length == (size_t) (end - string);
+
+    errno = 0;
+    unsigned long unsignedValue = strtoul(string, &end, 10);
+    res &= LexedToUnsignedLong(number, &overflow) == unsignedValue &&
+           overflow == (errno == ERANGE);
+
+    return res;
+}
+
+static bool SimpleLexerTest(void) {
+    static const char *strings[] = {
+            "", "0", "-0", "+0", "7", "-7", "+7", " 12", "\t-34x", "-", "+",
+            "- 5", "--5", "x5", "0012345678901234", "123456789,5",
+            "9223372036854775807", "9223372036854775808",
+            "-9223372036854775808", "-9223372036854775809",
+            "18446744073709551615", "18446744073709551616",
+            "-18446744073709551615", "99999999999999999999999999999999",
+            "1234567:", "12345678:", "123456789012345678)", "00000000000000000"
+    };
+    bool res = true;
+
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        res &= TestLexNumber(strings[i]);
+    }
+
+    LexedNumber number = LexNumber("123456789", 4);
+    res &= number.length == 4 && number.magnitude == 1234;
+    number = LexNumber(" -", 2);
+    res &= number.length == 0 && number.prefix == 0;
+
+    return res;
+}
+
+/**
+ * Funkcja pomocnicza tworząca usunięty już z katalogu plik tymczasowy
+ * o zadanej zawartości.
+ * @param data zawartość pliku
+ * @param length długość zawartości
+ * @return deskryptor pliku ustawiony na jego początek
+ */
+static int TempFileWith(const char *data, size_t length) {
+    char path[] = "/tmp/poly_test_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        exit(1);
+    unlink(path);
+    size_t written = 0;
+    while (written < length) {
+        ssize_t count = write(fd, data + written, length - written);
+        if (count <= 0)
+            exit(1);
+        written += (size_t)count;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+/**
+ * Funkcja pomocnicza sprawdzająca, czy czytnik zwraca dokładnie zadane
+ * linie. Linie w @p data są rozdzielone znakami końca linii, a ostatnia może
+ * się nie kończyć takim znakiem.
+ * @param reader czytnik linii
+ * @param data oczekiwana zawartość
+ * @param length długość oczekiwanej zawartości
+ */
+static bool TestLineReader(LineReader *reader, const char *data,
+                           size_t length) {
+    bool res = true;
+    size_t begin = 0;
+    while (begin < length && res) {
+        const char *newline = memchr(data + begin, '\n', length - begin);
+        size_t line_length = newline == NULL ? length - begin :
+                             (size_t)(newline - data) - begin;
+        res &= LineReaderHasNext(reader);
+        Line line = LineReaderRead(reader);
+        res &= line.lineLength == line_length &&
+               memcmp(line.string, data + begin, line_length) == 0;
+        begin += line_length + 1;
+    }
+    res &= !LineReaderHasNext(reader);
+    LineReaderDestroy(reader);
+    return res;
+}
+
+static bool LineReaderTest(void) {
+    bool res = true;
+    // Linie przechodzące przez granice bloków odczytu (1 MiB), linia
+    // dłuższa niż dwa bloki, linia z bajtami zerowymi i ostatnia linia bez
+    // znaku końca linii
+    const size_t block = 1 << 20;
+    const size_t length = 4 * block + 100;
+    char *data = malloc(length);
+    CHECK_PTR(data);
+    for (size_t i = 0; i < length; ++i)
+        data[i] = (char)('a' + i % 26);
+    data[block - 10] = '\n';
+    data[block + 5] = '\n';
+    data[3 * block + 7] = '\n';
+    data[3 * block + 20] = '\0';
+    data[3 * block + 21] = '\0';
+    data[3 * block + 30] = '\n';
+    data[4 * block] = '\0';
+    data[4 * block + 40] = '\n';
+    data[4 * block + 41] = '\n';
+
+    int fd = TempFileWith(data, length);
+    LineReader reader = LineReaderInit(fd);
+    res &= TestLineReader(&reader, data, length);
+    lseek(fd, 0, SEEK_SET);
+    reader = LineReaderMap(fd);
+    res &= reader.mapped && TestLineReader(&reader, data, length);
+    close(fd);
+    free(data);
+
+    // Plik, którego nie da się odwzorować w pamięci
+    static const char piped[] = "(1,2)\n\0\0x\n\nPRINT";
+    int pipefd[2];
+    if (pipe(pipefd) != 0)
+        exit(1);
+    res &= write(pipefd[1], piped, sizeof(piped) - 1) ==
+           (ssize_t)sizeof(piped) - 1;
+    close(pipefd[1]);
+    reader = LineReaderMap(pipefd[0]);
+    res &= !reader.mapped && TestLineReader(&reader, piped,
+                                            sizeof(piped) - 1);
+    close(pipefd[0]);
+
+    // Znaki spoza zakresu typu char są zastępowane
+    static const char wide[] = "(1,\xc3\xb3)";
+    fd = TempFileWith(wide, sizeof(wide) - 1);
+    reader = LineReaderInit(fd);
+    Line line = LineReaderRead(&reader);
+    res &= line.lineLength == 6 && memcmp(line.string, "(1,", 3) == 0 &&
+           line.string[3] != '\xc3' && line.string[4] != '\xb3' &&
+           line.string[5] == ')';
+    LineReaderDestroy(&reader);
+    close(fd);
+    return res;
+}
+
+static bool TestParse(const char *string, Poly res) {
+    Line line = {.string = (char *)string, .lineLength = strlen(string)};
+    Poly p;
+    bool is_eq = PolyParse(line, &p) && PolyIsEq(&p, &res);
+    if (is_eq)
+        PolyDestroy(&p);
+    PolyDestroy(&res);
+    return is_eq;
+}
+
+static bool TestParseError(const char *string) {
+    Line line = {.string = (char *)string, .lineLength = strlen(string)};
+    Poly p = C(42);
+    return !PolyParse(line, &p) && PolyIsCoeff(&p) && PolyGetCoeff(&p) == 42;
+}
+
+static bool ParserTest(void) {
+    static const char *wrong[] = {
+            "", "(1,2", "((1,2),3)+", "(1,-1)", "(1,2))", "()", "(,1)",
+            "(1 ,2)", "(1,+2)", "(1,2)(3,4)", "1 ", "-", "--1", "+1",
+            "9223372036854775808", "-9223372036854775809",
+            "(9223372036854775808,1)", "((1,2)+(-9223372036854775809,0),1)",
+            "(1,2147483648)", "(1,4294967297)", "(1,99999999999999999999)",
+            "+", "(1,2)+", "+(1,2)", "(1,2)++(3,4)", "((1,2)+,3)",
+            "(1,2)\n", "(1,\x01)"
+    };
+    bool res = true;
+
+    for (size_t i = 0; i < sizeof(wrong) / sizeof(wrong[0]); i++) {
+        res &= TestParseError(wrong[i]);
+    }
+
+    res &= TestParse("-9223372036854775808", C(LONG_MIN));
+    res &= TestParse("(-9223372036854775808,1)", P(C(LONG_MIN), 1));
+    res &= TestParse("(1,2147483647)", P(C(1), INT_MAX));
+    res &= TestParse("007", C(7));
+    res &= TestParse("-0", C(0));
+    res &= TestParse("(1,02)", P(C(1), 2));
+    res &= TestParse("(1,2)+(1,2)", P(C(2), 2));
+    res &= TestParse("(0,5)", C(0));
+    res &= TestParse("((0,1),2)", C(0));
+    res &= TestParse("(1,0)+(2,0)", C(3));
+    res &= TestParse("((1,2)+(3,4),5)", P(P(C(1), 2, C(3), 4), 5));
+
+    // Zagnieżdżenie na granicy dopuszczalnej głębokości, tuż za nią i tak
+    // głębokie, że rekurencyjne wczytywanie wyczerpałoby stos
+    const size_t depths[] = {1000, 1001, 1000000};
+    for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        char *nested = malloc(4 * depths[i] + 2);
+        CHECK_PTR(nested);
+        memset(nested, '(', depths[i]);
+        nested[depths[i]] = '1';
+        for (size_t j = 0; j < depths[i]; j++)
+            memcpy(nested + depths[i] + 1 + 3 * j, ",0)", 3);
+        nested[4 * depths[i] + 1] = '\0';
+        if (depths[i] <= 1000) {
+            Poly expected_nested = C(1);
+            for (size_t j = 0; j < depths[i]; j++)
+                expected_nested = P(expected_nested, 0);
+            res &= TestParse(nested, expected_nested);
+        } else {
+            res &= TestParseError(nested);
+            nested[depths[i]] = '\0';
+            res &= TestParseError(nested);
+        }
+        free(nested);
+    }
+
+    // Linia z wczytanego pliku może mieć dalsze znaki za swoją długością
+    Line line = {.string = "(1,2)+(3,4)", .lineLength = 5};
+    Poly p;
+    Poly expected = P(C(1), 2);
+    res &= PolyParse(line, &p) && PolyIsEq(&p, &expected);
+    PolyDestroy(&p);
+    PolyDestroy(&expected);
+    return res;
+}
+
+/** To jest zmienna przechowująca ujście używane w testach wypisywania. */
+static OutputSink test_sink;
+
+static bool TestWrite(Poly p, const char *expected) {
+    char *output = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&output, &length);
+    CHECK_PTR(stream);
+    OutputSinkInitStream(&test_sink, stream);
+    PolyWrite(&test_sink, &p);
+    OutputSinkFlush(&test_sink);
+    fclose(stream);
+    bool is_eq = strcmp(output, expected) == 0;
+    free(output);
+    PolyDestroy(&p);
+    return is_eq;
+}
+
+static bool PrinterTest(void) {
+    bool res = true;
+    res &= TestWrite(C(0), "0\n");
+    res &= TestWrite(C(LONG_MIN), "-9223372036854775808\n");
+    res &= TestWrite(C(LONG_MAX), "9223372036854775807\n");
+    res &= TestWrite(C(-10), "-10\n");
+    res &= TestWrite(P(C(-1), 0, C(LONG_MIN), 1, C(-99), INT_MAX),
+                     "(-1,0)+(-9223372036854775808,1)+(-99,2147483647)\n");
+    res &= TestWrite(P(P(C(1), 0, P(C(-3), 4), 2), 0, C(5), 1,
+                       P(P(C(-7), 0, C(100), 1), 3), 10),
+                     "((1,0)+((-3,4),2),0)+(5,1)+(((-7,0)+(100,1),3),10)\n");
+
+    // Wynik wielokrotnie dłuższy niż bufor ujścia, zapisywany bez
+    // opróżniania między wielomianami
+    const size_t count = 6000;
+    const size_t copies = 3;
+    size_t capacity = count * 48 + 2;
+    char *expected = malloc(capacity);
+    CHECK_PTR(expected);
+    Mono *monos = calloc(count, sizeof (Mono));
+    CHECK_PTR(monos);
+    size_t length = 0;
+    for (size_t i = 0; i < count; ++i) {
+        poly_coeff_t coeff = -(poly_coeff_t)(i + 1) * 1000000007L;
+        poly_exp_t exp = (poly_exp_t)i * 3;
+        monos[i] = M(P(C(coeff), 1), exp);
+        length += (size_t)snprintf(expected + length, capacity - length,
+                                   "%s((%ld,1),%d)", i == 0 ? "" : "+",
+                                   coeff, exp);
+    }
+    expected[length++] = '\n';
+    Poly p = PolyAddMonos(count, monos);
+    free(monos);
+    PackedPoly *packed = PolyPack(&p);
+
+    int fd = TempFileWith("", 0);
+    OutputSinkInitFd(&test_sink, fd);
+    for (size_t i = 0; i < copies; ++i)
+        PolyWrite(&test_sink, &p);
+    PackedPolyWrite(&test_sink, packed);
+    OutputSinkFlush(&test_sink);
+    res &= length > OUTPUT_SINK_BUFFER;
+
+    char *output = malloc(length);
+    CHECK_PTR(output);
+    lseek(fd, 0, SEEK_SET);
+    for (size_t i = 0; i <= copies; ++i) {
+        size_t read_length = 0;
+        while (read_length < length) {
+            ssize_t n = read(fd, output + read_length, length - read_length);
+            if (n <= 0)
+                break;
+            read_length += (size_t)n;
+        }
+        res &= read_length == length && memcmp(output, expected, length) == 0;
+    }
+    res &= read(fd, output, 1) == 0;
+
+    close(fd);
+    free(output);
+    free(expected);
+    PackedPolyDestroy(packed);
+    PolyDestroy(&p);
+    return res;
+}
+
 #define POLY_P P(P(C(1), 3), 0, P(C(1), 2), 2, C(1), 3)
 
 static bool SimpleDegByTest(void) {
@@ -3126,6 +4025,51 @@ static bool SimpleIsEqTest(void) {
     return res;
 }
 
+static bool SimpleAtManyTest(void) {
+    bool res = true;
+    poly_coeff_t xs[] = {0, 1, -1, 2, 1L << 32, LONG_MIN};
+    Poly polys[] = {C(7),
+                    P(C(1), 0, C(-2), 1, C(3), 5),
+                    P(C(5), 2, C(1), 70),
+                    P(P(C(1), 0, C(2), 1), 0, C(3), 1, P(C(1), 1), 2)};
+
+    for (size_t i = 0; i < sizeof(polys) / sizeof(polys[0]); i++) {
+        Poly values[sizeof(xs) / sizeof(xs[0])];
+        PolyAtMany(&polys[i], sizeof(xs) / sizeof(xs[0]), xs, values);
+
+        for (size_t j = 0; j < sizeof(xs) / sizeof(xs[0]); j++) {
+            Poly expected = PolyAt(&polys[i], xs[j]);
+            res &= PolyIsEq(&values[j], &expected);
+            PolyDestroy(&expected);
+            PolyDestroy(&values[j]);
+        }
+
+        PolyDestroy(&polys[i]);
+    }
+
+    return res;
+}
+
+static bool SimpleEvalTest(void) {
+    bool res = true;
+    poly_coeff_t x[] = {5, 7, -3};
+    Poly p = P(P(C(1), 0, C(2), 1), 0, C(3), 1, P(P(C(1), 4), 1), 2);
+    PolyEvalPlan *plan = PolyEvalPlanCreate(&p);
+
+    res &= PolyEval(&p, 0, x) == 1;
+    res &= PolyEval(&p, 1, x) == 16;
+    res &= PolyEval(&p, 2, x) == 30;
+    res &= PolyEval(&p, 3, x) == 30 + 25 * 7 * 81;
+    res &= PolyEvalPlanRun(plan, 0, x) == 1;
+    res &= PolyEvalPlanRun(plan, 1, x) == 16;
+    res &= PolyEvalPlanRun(plan, 2, x) == 30;
+    res &= PolyEvalPlanRun(plan, 3, x) == 30 + 25 * 7 * 81;
+
+    PolyEvalPlanDestroy(plan);
+    PolyDestroy(&p);
+    return res;
+}
+
 static bool SimpleAtTest(void) {
     bool res = true;
     res &= TestAt(C(2), 1, C(2));
@@ -3145,6 +4089,107 @@ static bool OverflowTest(void) {
     return res;
 }
 
+static bool ExpOverflowTest(void) {
+    bool res = true;
+    Poly a = P(C(1), INT_MAX);
+    Poly b = P(C(1), 1);
+    Poly c = P(C(1), INT_MAX - 1);
+    Poly d = P(P(C(1), INT_MAX), 0, C(1), 1);
+    Poly e = P(P(C(1), 1), 2);
+
+    res &= !PolyMulFits(&a, &b) && PolyMulFits(&b, &c);
+    res &= !PolyMulFits(&d, &e) && PolyMulFits(&d, &b);
+    PolyExpOverflowClear();
+    res &= TestMul(PolyClone(&b), PolyClone(&c), P(C(1), INT_MAX));
+    res &= !PolyExpOverflowed();
+
+    Poly f = PolyMul(&a, &b);
+    res &= PolyExpOverflowed();
+    PolyDestroy(&f);
+    PolyExpOverflowClear();
+    f = PolyMul(&d, &e);
+    res &= PolyExpOverflowed();
+    PolyDestroy(&f);
+    PolyExpOverflowClear();
+
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    PolyDestroy(&c);
+    PolyDestroy(&d);
+    PolyDestroy(&e);
+    return res;
+}
+
+static bool PowOverflowTest(void) {
+    bool res = true;
+    Poly polys[] = {P(C(-1), 2),
+                    P(C(1), 0, C(1), 1000000000),
+                    P(P(C(1), 1000000000), 1),
+                    P(C(1), 1, C(1), 2, C(1), 1000000000)};
+
+    PolyExpOverflowClear();
+    res &= PolyPowFits(&polys[0], INT_MAX / 2);
+    res &= TestPow(PolyClone(&polys[0]), INT_MAX / 2,
+                   P(C(-1), INT_MAX - 1));
+    res &= PolyPowFits(&polys[1], 2) && PolyPowFits(&polys[2], 2);
+    res &= TestPow(PolyClone(&polys[1]), 2,
+                   P(C(1), 0, C(2), 1000000000, C(1), 2000000000));
+    res &= !PolyExpOverflowed();
+
+    for (size_t i = 0; i < sizeof(polys) / sizeof(polys[0]); i++) {
+        poly_exp_t n = i == 0 ? INT_MAX / 2 + 1 : 3;
+        res &= !PolyPowFits(&polys[i], n) && PolyPowFits(&polys[i], 0);
+        Poly p = PolyPow(&polys[i], n);
+        res &= PolyExpOverflowed();
+        PolyExpOverflowClear();
+        PolyDestroy(&p);
+    }
+
+    Poly q = P(C(1), 3);
+    Poly p = PolyCompose(&polys[1], 1, &q);
+    res &= PolyExpOverflowed();
+    PolyExpOverflowClear();
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+
+    for (size_t i = 0; i < sizeof(polys) / sizeof(polys[0]); i++) {
+        PolyDestroy(&polys[i]);
+    }
+
+    return res;
+}
+
+static bool ShiftOverflowTest(void) {
+    bool res = true;
+    Poly polys[] = {P(C(3), 2), P(C(1), 0, C(2), 2), C(4)};
+    Poly expected[] = {P(C(3), INT_MAX), P(C(1), INT_MAX - 2, C(2), INT_MAX),
+                       P(C(4), INT_MAX)};
+
+    PolyExpOverflowClear();
+
+    for (size_t i = 0; i < sizeof(polys) / sizeof(polys[0]); i++) {
+        Poly p = PolyClone(&polys[i]);
+        PolyShiftInPlace(&p, INT_MAX - PolyDegBy(&polys[i], 0));
+        res &= PolyIsEq(&p, &expected[i]) && !PolyExpOverflowed();
+
+        PolyShiftInPlace(&p, 1);
+        res &= PolyIsEq(&p, &expected[i]) && PolyExpOverflowed();
+        PolyExpOverflowClear();
+        PolyDestroy(&p);
+
+        p = PolyClone(&polys[i]);
+        PolyShiftInPlace(&p, INT_MAX);
+        res &= PolyIsEq(&p, i == 2 ? &expected[i] : &polys[i]);
+        res &= PolyExpOverflowed() == (i != 2);
+        PolyExpOverflowClear();
+        PolyDestroy(&p);
+        PolyDestroy(&polys[i]);
+        PolyDestroy(&expected[i]);
+    }
+
+    return res;
+}
+
 /** WŁAŚCIWE TESTY NIEUDOSTĘPNIONE W PRZYKŁADZIE **/
 
 /**
@@ -3485,6 +4530,46 @@ static Poly RecursiveBuild2(int depth, int *exp_shift, int *coef_shift,
     }
 }
 
+/**
+ * Test wyliczania wartości wielomianu przy różnych i powtarzających się
+ * lukach między wykładnikami oraz w zerze.
+ */
+static bool AtGapTest(void) {
+    bool res = true;
+    poly_coeff_t xs[] = {-3, -1, 0, 1, 2, 7, 1L << 21};
+    poly_coeff_t coeffs[48];
+    poly_exp_t exps[48];
+    // Luki między wykładnikami są różne, powtarzają się i bywają duże
+    for (size_t i = 0; i < 48; ++i) {
+        coeffs[i] = i % 2 == 0 ? (poly_coeff_t)i + 1 : -(poly_coeff_t)i;
+        exps[i] = i < 32 ? (poly_exp_t)(i * (i + 1) / 2)
+                         : 496 + (poly_exp_t)(i - 31) * 97;
+    }
+    exps[47] = 100000;
+    Poly p = MakePoly(48, coeffs, exps);
+
+    for (size_t j = 0; j < sizeof(xs) / sizeof(xs[0]); ++j) {
+        unsigned long expected = 0;
+        for (size_t i = 0; i < 48; ++i) {
+            unsigned long power = 1;
+            for (poly_exp_t e = 0; e < exps[i]; ++e)
+                power *= (unsigned long)xs[j];
+            expected += (unsigned long)coeffs[i] * power;
+        }
+        res &= TestAt(PolyClone(&p), xs[j], C((poly_coeff_t)expected));
+    }
+    PolyDestroy(&p);
+
+    // Zero w miejscu zmiennej przy niezerowym najmniejszym wykładniku
+    res &= TestAt(P(C(5), 3, C(7), 10), 0, C(0));
+    res &= TestAt(P(C(-1), 1), 0, C(0));
+    res &= TestAt(P(P(C(1), 0, C(1), 2), 2, C(3), 5), 0, C(0));
+    res &= TestAt(P(P(C(1), 0, C(1), 2), 0, C(3), 5), 0,
+                  P(C(1), 0, C(1), 2));
+    res &= TestAt(P(C(4), 0, C(1), 1000000), 0, C(4));
+    return res;
+}
+
 /**
  * Sprawdza, czy PolyDegBy i PolyDeg przeglądają wszystkie wymagane
  * elementy struktury.
@@ -3829,6 +4914,327 @@ static bool MulTest2(void) {
     return good;
 }
 
+/**
+ * Funkcja pomocnicza tworząca rzadki wielomian o wykładnikach będących
+ * kolejnymi wielokrotnościami kroku.
+ * @param count liczba jednomianów
+ * @param step odstęp między kolejnymi wykładnikami
+ * @param seed ziarno pseudolosowych współczynników
+ * @param nested czy współczynniki mają być wielomianami zmiennej x_1
+ */
+static Poly SparsePoly(size_t count, poly_exp_t step, poly_coeff_t seed,
+                       bool nested) {
+    Mono *monos = calloc(count, sizeof (Mono));
+    CHECK_PTR(monos);
+    for (size_t i = 0; i < count; ++i) {
+        seed = (seed * 1103515245 + 12345) % 2000003;
+        poly_coeff_t c = seed % 1999 - 999 == 0 ? 1 : seed % 1999 - 999;
+        Poly coeff = nested ? P(C(c), 0, C(-c), (poly_exp_t)(i % 7) + 1)
+                            : C(c);
+        monos[i] = M(coeff, (poly_exp_t)i * step);
+    }
+    Poly res = PolyAddMonos(count, monos);
+    free(monos);
+    return res;
+}
+
+/**
+ * Funkcja pomocnicza mnożąca wielomiany jednomian po jednomianie, tak aby
+ * żadne z mnożeń nie było dość duże dla mnożenia za pomocą kopca.
+ * @param p pierwszy czynnik
+ * @param q drugi czynnik
+ */
+static Poly MulByMonos(const Poly *p, const Poly *q) {
+    Poly res = PolyZero();
+    Mono single;
+    const Mono *monos = PolyMonos(p, &single);
+    for (size_t i = 0; i < PolyMonoCount(p); ++i) {
+        Poly mono = P(PolyClone(&monos[i].p), monos[i].exp);
+        Poly product = PolyMul(&mono, q);
+        Poly sum = PolyAdd(&res, &product);
+        PolyDestroy(&mono);
+        PolyDestroy(&product);
+        PolyDestroy(&res);
+        res = sum;
+    }
+    return res;
+}
+
+/**
+ * Test mnożenia dużych rzadkich wielomianów za pomocą kopca oraz dużych
+ * gęstych wielomianów, których nie da się pomnożyć przez podstawienie
+ * Kroneckera.
+ */
+static bool SparseMulTest(void) {
+    bool res = true;
+    Poly p = SparsePoly(120, 1009, 1, false);
+    Poly q = SparsePoly(100, 997, 2, true);
+    Poly expected = MulByMonos(&p, &q);
+    res &= TestOpPtr(&p, &q, PolyClone(&expected), PolyMul);
+    res &= TestOpPtr(&q, &p, expected, PolyMul);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+
+    // Współczynniki zależą od dziewięciu zmiennych, więc podstawienie
+    // Kroneckera odpada, a czynniki są za gęste na kopiec.
+    Poly deep = P(C(1), 0, C(-1), 1);
+    for (int i = 0; i < 8; ++i)
+        deep = P(deep, 1);
+    p = SparsePoly(40, 1, 3, false);
+    q = SparsePoly(40, 1, 4, false);
+    Poly r = PolyMul(&p, &deep);
+    expected = MulByMonos(&r, &q);
+    res &= TestOpPtr(&r, &q, expected, PolyMul);
+    PolyDestroy(&deep);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+    return res;
+}
+
+/**
+ * Test mnożenia wielomianów w wielu wątkach. Porównuje iloczyn dużych
+ * rzadkich wielomianów o zagnieżdżonych współczynnikach z iloczynem
+ * obliczonym w jednym wątku, a także iloczyn, którego iloczyny częściowe
+ * niemal całkowicie się znoszą:
+ * @f$(1 - x^{50})\sum_{k<n} x^{50k} = 1 - x^{50n}@f$.
+ */
+static bool ParallelMulTest(void) {
+    Poly p = SparsePoly(200, 1009, 5, true);
+    Poly q = SparsePoly(200, 997, 6, true);
+    PolySetThreads(1);
+    Poly expected = PolyMul(&p, &q);
+    PolySetThreads(4);
+    bool res = TestOpPtr(&p, &q, PolyClone(&expected), PolyMul);
+    res &= TestOpPtr(&q, &p, PolyClone(&expected), PolyMul);
+    PolyThreadsRelease();
+    res &= TestOpPtr(&p, &q, expected, PolyMul);
+
+    const size_t n = 40000;
+    Mono *monos = calloc(n, sizeof (Mono));
+    CHECK_PTR(monos);
+    for (size_t i = 0; i < n; ++i)
+        monos[i] = M(C(1), (poly_exp_t)(50 * i));
+    Poly geometric = PolyAddMonos(n, monos);
+    free(monos);
+    Poly factor = P(C(1), 0, C(-1), 50);
+    res &= TestOpPtr(&factor, &geometric,
+                     P(C(1), 0, C(-1), (poly_exp_t)(50 * n)), PolyMul);
+    PolyThreadsRelease();
+
+    PolySetThreads(1);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&geometric);
+    PolyDestroy(&factor);
+    return res;
+}
+
+/**
+ * Test mnożenia gęstych wielomianów za pomocą transformaty NTT dla
+ * współczynników bliskich granicom zakresu. Wynik porównywany jest ze splotem
+ * liczonym modulo 2^64, tak jak w zwykłym mnożeniu.
+ */
+static bool NttMulTest(void) {
+    const poly_coeff_t extremes[] = {LONG_MAX, -LONG_MAX, LONG_MIN, -1, 1, 7};
+    const size_t p_len = 40;
+    const size_t q_len = 30;
+    poly_coeff_t p_coef[40];
+    poly_coeff_t q_coef[30];
+    poly_coeff_t expected_coef[69];
+    poly_exp_t exp_list[69];
+    for (size_t i = 0; i < p_len + q_len - 1; ++i) {
+        exp_list[i] = (poly_exp_t)i;
+        expected_coef[i] = 0;
+    }
+    for (size_t i = 0; i < p_len; ++i)
+        p_coef[i] = extremes[i % 6];
+    for (size_t j = 0; j < q_len; ++j)
+        q_coef[j] = extremes[(j * 5 + 2) % 6];
+    for (size_t i = 0; i < p_len; ++i)
+        for (size_t j = 0; j < q_len; ++j)
+            expected_coef[i + j] = (poly_coeff_t)
+                    ((unsigned long)expected_coef[i + j] +
+                     (unsigned long)p_coef[i] * (unsigned long)q_coef[j]);
+
+    Poly p = MakePoly(p_len, p_coef, exp_list);
+    Poly q = MakePoly(q_len, q_coef, exp_list);
+    Poly expected = MakePoly(p_len + q_len - 1, expected_coef, exp_list);
+    Poly nested_p = P(PolyClone(&p), 0, PolyClone(&q), 3);
+    Poly nested_q = P(PolyClone(&q), 1, C(LONG_MIN), 2);
+    Poly nested_expected = PolyMul(&nested_p, &nested_q);
+
+    PolySetNttThreshold(1);
+    bool res = TestOpPtr(&p, &q, PolyClone(&expected), PolyMul);
+    res &= TestOpPtr(&q, &p, expected, PolyMul);
+    res &= TestOpPtr(&nested_p, &nested_q, nested_expected, PolyMul);
+    PolySetNttThreshold(2048);
+
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&nested_p);
+    PolyDestroy(&nested_q);
+    return res;
+}
+
+/**
+ * Funkcja pomocnicza mnożąca wielomiany jednomian po jednomianie na każdym
+ * poziomie zagnieżdżenia, bez żadnej z szybkich metod mnożenia.
+ * @param p pierwszy czynnik
+ * @param q drugi czynnik
+ */
+static Poly MulNaive(const Poly *p, const Poly *q) {
+    if (PolyIsCoeff(p) || PolyIsCoeff(q))
+        return PolyMul(p, q);
+    Mono p_single, q_single;
+    const Mono *p_monos = PolyMonos(p, &p_single);
+    const Mono *q_monos = PolyMonos(q, &q_single);
+    Poly res = PolyZero();
+    for (size_t i = 0; i < PolyMonoCount(p); ++i) {
+        for (size_t j = 0; j < PolyMonoCount(q); ++j) {
+            Poly coeff = MulNaive(&p_monos[i].p, &q_monos[j].p);
+            if (PolyIsZero(&coeff))
+                continue;
+            Poly term = P(coeff, p_monos[i].exp + q_monos[j].exp);
+            Poly sum = PolyAdd(&res, &term);
+            PolyDestroy(&term);
+            PolyDestroy(&res);
+            res = sum;
+        }
+    }
+    return res;
+}
+
+/**
+ * Funkcja pomocnicza tworząca wielomian @f$c_0 + c_1 x_v@f$.
+ * @param var indeks zmiennej
+ * @param c0 wyraz wolny
+ * @param c1 współczynnik przy zmiennej
+ */
+static Poly VarPoly(int var, poly_coeff_t c0, poly_coeff_t c1) {
+    Poly res = P(C(c0), 0, C(c1), 1);
+    for (int i = 0; i < var; ++i)
+        res = P(res, 0);
+    return res;
+}
+
+/**
+ * Funkcja pomocnicza mnożąca wielomian przez @f$c_0 + c_1 x_v@f$.
+ * @param p mnożony wielomian, przejmowany na własność
+ * @param var indeks zmiennej
+ * @param c0 wyraz wolny
+ * @param c1 współczynnik przy zmiennej
+ */
+static Poly MulByVar(Poly p, int var, poly_coeff_t c0, poly_coeff_t c1) {
+    Poly factor = VarPoly(var, c0, c1);
+    Poly res = PolyMul(&p, &factor);
+    PolyDestroy(&p);
+    PolyDestroy(&factor);
+    return res;
+}
+
+/**
+ * Test mnożenia przez podstawienie Kroneckera wielomianów zależnych od
+ * różnych zbiorów zmiennych, na granicy liczby zmiennych, które da się
+ * upakować w jednym wektorze, i tuż za nią.
+ */
+static bool KroneckerMulTest(void) {
+    bool res = true;
+    Poly p = C(1);
+    for (int v = 0; v < 8; ++v)
+        p = MulByVar(p, v, 1, v + 2);
+    Poly q = C(1);
+    q = MulByVar(q, 0, 2, -1);
+    q = MulByVar(q, 2, 1, 3);
+    q = MulByVar(q, 5, -4, 1);
+    q = MulByVar(q, 7, 1, 1);
+    q = MulByVar(q, 0, -1, 5);
+
+    for (int round = 0; round < 2; ++round) {
+        Poly expected = MulNaive(&p, &q);
+        res &= TestOpPtr(&p, &q, PolyClone(&expected), PolyMul);
+        res &= TestOpPtr(&q, &p, expected, PolyMul);
+        // dziewiąta zmienna wykracza poza podstawienie Kroneckera
+        p = MulByVar(p, 8, 3, -1);
+    }
+
+    Poly r = P(PolyClone(&q), 0, PolyClone(&q), 1 << 22);
+    Poly expected = MulNaive(&r, &q);
+    res &= TestOpPtr(&r, &q, expected, PolyMul);
+
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+    return res;
+}
+
+/**
+ * Funkcja pomocnicza tworząca wielomian zależny od @p vars zmiennych, który
+ * ma wszystkie jednomiany stopnia łącznego co najwyżej @p deg.
+ * @param vars liczba zmiennych
+ * @param deg stopień łączny
+ * @param seed ziarno współczynników, zmieniane przy każdym współczynniku
+ */
+static Poly TotalDegreePoly(int vars, int deg, poly_coeff_t *seed) {
+    if (vars == 0) {
+        *seed = (*seed * 1103515245 + 12345) % 2000003;
+        poly_coeff_t c = *seed % 1999 - 999;
+        return C(c == 0 ? LONG_MAX : c);
+    }
+    Mono *monos = calloc((size_t)deg + 1, sizeof (Mono));
+    CHECK_PTR(monos);
+    for (int e = 0; e <= deg; ++e)
+        monos[e] = M(TotalDegreePoly(vars - 1, deg - e, seed), e);
+    Poly res = PolyAddMonos((size_t)deg + 1, monos);
+    free(monos);
+    return res;
+}
+
+/**
+ * Test mnożenia przez podstawienie Kroneckera wielomianów o ograniczonym
+ * stopniu łącznym, których wektory współczynników są rzadkie, oraz długich
+ * gęstych wielomianów, także podnoszonych do kwadratu, których transformata
+ * NTT dzieli się na bloki.
+ * Wyniki porównywane są z mnożeniem bez NTT.
+ */
+static bool KroneckerSparseMulTest(void) {
+    poly_coeff_t seed = 7;
+    Poly p = TotalDegreePoly(4, 6, &seed);
+    Poly q = TotalDegreePoly(4, 5, &seed);
+    Poly expected = MulNaive(&p, &q);
+    bool res = TestOpPtr(&p, &q, PolyClone(&expected), PolyMul);
+    PolySetNttThreshold(1);
+    res &= TestOpPtr(&q, &p, expected, PolyMul);
+    PolySetNttThreshold(2048);
+
+    const size_t n = 20000;
+    poly_coeff_t *coef = calloc(n, sizeof (poly_coeff_t));
+    poly_exp_t *exps = calloc(n, sizeof (poly_exp_t));
+    CHECK_PTR(coef);
+    CHECK_PTR(exps);
+    for (size_t i = 0; i < n; ++i) {
+        seed = (seed * 1103515245 + 12345) % 2000003;
+        coef[i] = i % 5 == 0 ? LONG_MIN + seed : seed - 1000001;
+        exps[i] = (poly_exp_t)i;
+    }
+    Poly long_p = MakePoly(n, coef, exps);
+    Poly long_q = MakePoly(n / 2, coef + n / 2, exps);
+    PolySetNttThreshold(SIZE_MAX);
+    Poly long_expected = PolyMul(&long_p, &long_q);
+    Poly square_expected = PolyMul(&long_q, &long_q);
+    PolySetNttThreshold(2048);
+    res &= TestOpPtr(&long_p, &long_q, long_expected, PolyMul);
+    res &= TestOpPtr(&long_q, &long_q, square_expected, PolyMul);
+
+    free(coef);
+    free(exps);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&long_p);
+    PolyDestroy(&long_q);
+    return res;
+}
+
 /**
  * Sprawdza poprawność działania funkcji PolyIsEq na dłuższych przykładach.
  */
@@ -4020,13 +5426,38 @@ static const test_list_t test_list[] = {
         TEST(SimpleMulTest),
         TEST(SimpleNegTest),
         TEST(SimpleSubTest),
+        TEST(SimplePowTest),
+        TEST(BinomialPowTest),
+        TEST(SimpleComposeTest),
+        TEST(SparseComposeTest),
+        TEST(SimpleOwnTest),
+        TEST(SimpleInPlaceTest),
+        TEST(SimpleCloneTest),
+        TEST(SimpleInternTest),
+        TEST(SimplePoolTest),
+        TEST(SimpleArenaTest),
+        TEST(SimpleInlineTest),
+        TEST(SimplePackedTest),
+        TEST(SimpleMemoryTest),
+        TEST(SimpleMemoryLimitTest),
+        TEST(PowMemoryLimitTest),
+        TEST(SimpleLexerTest),
+        TEST(LineReaderTest),
+        TEST(ParserTest),
+        TEST(PrinterTest),
         TEST(SimpleNegGroup),
         TEST(SimpleDegByTest),
         TEST(SimpleDegTest),
         TEST(SimpleDegGroup),
         TEST(SimpleIsEqTest),
         TEST(SimpleAtTest),
+        TEST(AtGapTest),
+        TEST(SimpleAtManyTest),
+        TEST(SimpleEvalTest),
         TEST(OverflowTest),
+        TEST(ExpOverflowTest),
+        TEST(PowOverflowTest),
+        TEST(ShiftOverflowTest),
         TEST(SimpleArithmeticTest),
         TEST(LongPolynomialTest),
         TEST(AtTest1),
@@ -4038,6 +5469,11 @@ static const test_list_t test_list[] = {
         TEST(DegGroup),
         TEST(MulTest1),
         TEST(MulTest2),
+        TEST(SparseMulTest),
+        TEST(ParallelMulTest),
+        TEST(NttMulTest),
+        TEST(KroneckerMulTest),
+        TEST(KroneckerSparseMulTest),
         TEST(AddTest1),
         TEST(AddTest2),
         TEST(SubTest1),
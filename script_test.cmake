@@ -0,0 +1,50 @@
+# Test opcji --script kalkulatora, uruchamiany przez ctest poleceniem
+#   cmake -DCALC=<kalkulator> -DSCRIPT=<skrypt> -P script_test.cmake
+# Wyjście kalkulatora czytającego skrypt z pliku odwzorowanego w pamięci
+# oraz z potoku musi być takie samo jak przy czytaniu standardowego wejścia.
+# Ostatnia linia skryptu celowo nie kończy się znakiem końca linii.
+
+execute_process(COMMAND ${CALC}
+        INPUT_FILE ${SCRIPT}
+        OUTPUT_VARIABLE stdinOutput
+        ERROR_VARIABLE stdinErrors
+        RESULT_VARIABLE stdinResult)
+
+if (NOT stdinResult EQUAL 0 OR NOT stdinOutput MATCHES "\\(5,0\\)\\+\\(-5,7\\)\n$")
+    message(FATAL_ERROR "standardowe wejście: kod ${stdinResult}\n${stdinOutput}")
+endif ()
+
+execute_process(COMMAND ${CALC} --script ${SCRIPT}
+        OUTPUT_VARIABLE scriptOutput
+        ERROR_VARIABLE scriptErrors
+        RESULT_VARIABLE scriptResult)
+
+if (NOT scriptResult EQUAL 0 OR NOT scriptOutput STREQUAL stdinOutput OR
+        NOT scriptErrors STREQUAL stdinErrors)
+    message(FATAL_ERROR "--script ${SCRIPT}: kod ${scriptResult}\n"
+            "${scriptOutput}${scriptErrors}")
+endif ()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E cat ${SCRIPT}
+        COMMAND ${CALC} --script /dev/stdin
+        OUTPUT_VARIABLE pipeOutput
+        ERROR_VARIABLE pipeErrors
+        RESULT_VARIABLE pipeResult)
+
+if (NOT pipeResult EQUAL 0 OR NOT pipeOutput STREQUAL stdinOutput OR
+        NOT pipeErrors STREQUAL stdinErrors)
+    message(FATAL_ERROR "--script /dev/stdin: kod ${pipeResult}\n"
+            "${pipeOutput}${pipeErrors}")
+endif ()
+
+execute_process(COMMAND ${CALC} --script ${SCRIPT}.missing
+        INPUT_FILE ${SCRIPT}
+        OUTPUT_VARIABLE missingOutput
+        ERROR_VARIABLE missingErrors
+        RESULT_VARIABLE missingResult)
+
+if (NOT missingResult EQUAL 1 OR NOT missingOutput STREQUAL "" OR
+        NOT missingErrors STREQUAL "ERROR WRONG OPTION --script\n")
+    message(FATAL_ERROR "brakujący plik: kod ${missingResult}\n"
+            "${missingOutput}${missingErrors}")
+endif ()